@@ -0,0 +1,212 @@
+/*
+   RPL Simulator.
+
+   Copyright (c) Calin Crisan 2010
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#include <ctype.h>
+#include <glib.h>   /* for GStaticMutex */
+
+#include "addr.h"
+
+
+    /**** global variables ****/
+
+    /* canonical strings, indexed by id; never freed, so they can safely travel as event args */
+static char **              addr_list = NULL;
+static uint32               addr_count = 0;
+
+    /* the same addresses as left aligned bit strings, for prefix matching */
+static uint64 *             addr_bits_list = NULL;
+static uint8 *              addr_bit_len_list = NULL;
+
+    /* open addressing on the string hash, slots hold id + 1 (0 means empty) */
+static uint32 *             hash_table = NULL;
+static uint32               hash_size = 0;
+
+static GStaticMutex         addr_mutex = G_STATIC_MUTEX_INIT;
+
+
+    /**** local function prototypes ****/
+
+static uint32               string_hash(const char *str);
+static uint32               hash_find_slot(const char *str);
+static void                 hash_grow();
+static void                 table_init();
+
+
+    /**** exported functions ****/
+
+address_t addr_intern(const char *str)
+{
+    rs_assert(str != NULL);
+
+    g_static_mutex_lock(&addr_mutex);
+
+    if (hash_table == NULL) {
+        table_init();
+    }
+
+    uint32 slot = hash_find_slot(str);
+    if (hash_table[slot] == 0) {
+        addr_list = realloc(addr_list, (addr_count + 1) * sizeof(char *));
+        addr_bits_list = realloc(addr_bits_list, (addr_count + 1) * sizeof(uint64));
+        addr_bit_len_list = realloc(addr_bit_len_list, (addr_count + 1) * sizeof(uint8));
+
+        addr_list[addr_count] = strdup(str);
+        addr_bits_list[addr_count] = addr_string_to_bits(str, &addr_bit_len_list[addr_count]);
+        hash_table[slot] = ++addr_count;
+
+        if (addr_count * 2 > hash_size) {
+            hash_grow();
+        }
+    }
+
+    address_t addr = hash_table[hash_find_slot(str)] - 1;
+
+    g_static_mutex_unlock(&addr_mutex);
+
+    return addr;
+}
+
+address_t addr_find(const char *str)
+{
+    rs_assert(str != NULL);
+
+    g_static_mutex_lock(&addr_mutex);
+
+    if (hash_table == NULL) {
+        table_init();
+    }
+
+    uint32 slot = hash_find_slot(str);
+    address_t addr = hash_table[slot] != 0 ? hash_table[slot] - 1 : ADDR_UNKNOWN;
+
+    g_static_mutex_unlock(&addr_mutex);
+
+    return addr;
+}
+
+char *addr_to_string(address_t addr)
+{
+    g_static_mutex_lock(&addr_mutex);
+
+    /* ADDR_UNKNOWN is a legitimate value for ids that were never set */
+    char *str = (addr < addr_count) ? addr_list[addr] : "<<unknown>>";
+
+    g_static_mutex_unlock(&addr_mutex);
+
+    return str;
+}
+
+uint64 addr_to_bits(address_t addr, uint8 *bit_len)
+{
+    g_static_mutex_lock(&addr_mutex);
+
+    uint64 bits = 0;
+    *bit_len = 0;
+
+    if (addr < addr_count) {
+        bits = addr_bits_list[addr];
+        *bit_len = addr_bit_len_list[addr];
+    }
+
+    g_static_mutex_unlock(&addr_mutex);
+
+    return bits;
+}
+
+uint64 addr_string_to_bits(const char *str, uint8 *bit_len)
+{
+    rs_assert(str != NULL);
+
+    uint64 bits = 0;
+    uint8 len = 0;
+    const char *c = str;
+
+    while (*c && len < ADDR_MAX_BITS) {
+        uint64 digit = (isdigit(*c) ? *c - '0' : *c - 'A' + 10) & 0xF;
+        c++;
+
+        bits |= digit << (ADDR_MAX_BITS - 4 - len);
+        len += 4;
+    }
+
+    if (*c) {
+        rs_warn("address '%s' is longer than %d bits, truncated", str, ADDR_MAX_BITS);
+    }
+
+    *bit_len = len;
+
+    return bits;
+}
+
+
+    /**** local functions ****/
+
+static uint32 string_hash(const char *str)
+{
+    uint32 hash = 2166136261u; /* FNV-1a */
+
+    while (*str) {
+        hash ^= (uint8) *str++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32 hash_find_slot(const char *str)
+{
+    uint32 slot = string_hash(str) & (hash_size - 1);
+
+    while (hash_table[slot] != 0 && strcmp(addr_list[hash_table[slot] - 1], str) != 0) {
+        slot = (slot + 1) & (hash_size - 1);
+    }
+
+    return slot;
+}
+
+static void hash_grow()
+{
+    free(hash_table);
+
+    hash_size *= 2;
+    hash_table = calloc(hash_size, sizeof(uint32));
+
+    uint32 i;
+    for (i = 0; i < addr_count; i++) {
+        hash_table[hash_find_slot(addr_list[i])] = i + 1;
+    }
+}
+
+static void table_init()
+{
+    hash_size = ADDR_HASH_INITIAL_SIZE;
+    hash_table = calloc(hash_size, sizeof(uint32));
+
+    /* the empty address always gets id 0, i.e. ADDR_BROADCAST */
+    addr_list = malloc(sizeof(char *));
+    addr_bits_list = malloc(sizeof(uint64));
+    addr_bit_len_list = malloc(sizeof(uint8));
+
+    addr_list[0] = strdup("");
+    addr_bits_list[0] = 0;
+    addr_bit_len_list[0] = 0;
+    hash_table[hash_find_slot("")] = ++addr_count;
+}
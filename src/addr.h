@@ -0,0 +1,44 @@
+/*
+   RPL Simulator.
+
+   Copyright (c) Calin Crisan 2010
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#ifndef ADDR_H_
+#define ADDR_H_
+
+#include "base.h"
+
+#define ADDR_BROADCAST              0   /* the empty address */
+#define ADDR_UNKNOWN                ((address_t) -1)
+
+#define ADDR_HASH_INITIAL_SIZE      256
+#define ADDR_MAX_BITS               64  /* addresses are hex strings of at most 16 digits */
+
+
+    /* an address string interned into a compact integer id, once per distinct string */
+address_t                           addr_intern(const char *str);
+address_t                           addr_find(const char *str);
+char *                              addr_to_string(address_t addr);
+uint64                              addr_to_bits(address_t addr, uint8 *bit_len);
+
+    /* hex digits packed most significant first, left aligned on 64 bits */
+uint64                              addr_string_to_bits(const char *str, uint8 *bit_len);
+
+
+#endif /* ADDR_H_ */
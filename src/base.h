@@ -64,6 +64,7 @@
 #define coord_t                     float
 #define percent_t                   float
 #define sim_time_t                  int32
+#define address_t                   uint32
 
 
     /**** others ****/
@@ -90,10 +91,11 @@
 #define DEBUG_NODES_MUTEX           (0 << 12)
 #define DEBUG_MEASURES_MUTEX        (0 << 13)
 #define DEBUG_SCENARIO              (0 << 14)
+#define DEBUG_TRAFFIC               (0 << 15)
 
 #define DEBUG_NONE                  0
 #define DEBUG_MINIMAL               (DEBUG_MAIN | DEBUG_SYSTEM | DEBUG_EVENT)
-#define DEBUG_PROTO                 (DEBUG_PHY | DEBUG_MAC | DEBUG_IP | DEBUG_ICMP | DEBUG_RPL)
+#define DEBUG_PROTO                 (DEBUG_PHY | DEBUG_MAC | DEBUG_IP | DEBUG_ICMP | DEBUG_RPL | DEBUG_TRAFFIC)
 #define DEBUG_MUTEX                 (DEBUG_EVENTS_MUTEX | DEBUG_SCHEDULES_MUTEX | DEBUG_NODES_MUTEX | DEBUG_MEASURES_MUTEX)
 #define DEBUG_ALL                   (DEBUG_MINIMAL | DEBUG_PROTO | DEBUG_GUI | DEBUG_MUTEX)
 
@@ -211,7 +211,7 @@ void event_log(uint16 event_id, node_t *node, void *data1, void *data2)
                 rpl_node_is_joined(node) ? node->rpl_info->joined_dodag->sibling_count : 0
                 );
 
-        snprintf(stats, 4 * 256, "stats = {%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d}",
+        snprintf(stats, 4 * 256, "stats = {%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d}",
                 node->measure_info->forward_inconsistency_count,
                 node->measure_info->forward_failure_count,
                 node->measure_info->rpl_r_dis_message_count,
@@ -226,7 +226,17 @@ void event_log(uint16 event_id, node_t *node, void *data1, void *data2)
                 node->measure_info->fwd_ip_packet_count,
                 measure_converg_get()->stable_node_count,
                 measure_converg_get()->floating_node_count,
-                measure_converg_get()->total_node_count
+                measure_converg_get()->total_node_count,
+                node->measure_info->collision_count,
+                node->measure_info->ip_dequeued_count > 0 ? node->measure_info->ip_queue_delay_total / node->measure_info->ip_dequeued_count : 0,
+                node->measure_info->traffic_sent_count,
+                node->measure_info->traffic_received_count,
+                node->measure_info->traffic_received_count > 0 ? node->measure_info->traffic_delay_total / node->measure_info->traffic_received_count : 0,
+                node->measure_info->rpl_dio_suppressed_count,
+                rpl_node_get_route_state_size(node),
+                node->measure_info->rpl_sr_computed_count,
+                node->measure_info->rpl_sr_cached_count,
+                node->measure_info->rpl_sr_step_total
                 );
     }
 
@@ -56,6 +56,8 @@ static void                     draw_legend9(GdkWindow *window, GdkGC *gc);
 static void                     draw_legend10(GdkWindow *window, GdkGC *gc);
 static void                     draw_legend11(GdkWindow *window, GdkGC *gc);
 
+static void                     legend_init_dodag(node_t *node, uint16 rank);
+
 
     /**** exported functions ****/
 
@@ -141,13 +143,7 @@ static void draw_legend1(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node);
     rpl_node_init(node);
     node->phy_info->tx_power = 0.5;
-    node->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node->rpl_info->joined_dodag->dodag_id = NULL;
-    node->rpl_info->joined_dodag->parent_list = NULL;
-    node->rpl_info->joined_dodag->sibling_list = NULL;
-    node->rpl_info->joined_dodag->pref_parent = NULL;
-    node->rpl_info->joined_dodag->seq_num = 0;
-    node->rpl_info->joined_dodag->rank = 3;
+    legend_init_dodag(node, 3);
 
     sim_field_draw_node(node, cr, pixel_width / 2, pixel_height / 2);
 
@@ -189,13 +185,7 @@ static void draw_legend2(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node);
     rpl_node_init(node);
     node->phy_info->tx_power = 0.5;
-    node->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node->rpl_info->joined_dodag->dodag_id = NULL;
-    node->rpl_info->joined_dodag->parent_list = NULL;
-    node->rpl_info->joined_dodag->sibling_list = NULL;
-    node->rpl_info->joined_dodag->pref_parent = NULL;
-    node->rpl_info->joined_dodag->rank = 3;
-    node->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node, 3);
     node->alive = TRUE;
 
     sim_field_draw_node(node, cr, pixel_width / 2, pixel_height / 2);
@@ -240,13 +230,7 @@ static void draw_legend3(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node);
     rpl_node_init(node);
     node->phy_info->tx_power = 0.5;
-    node->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node->rpl_info->joined_dodag->dodag_id = NULL;
-    node->rpl_info->joined_dodag->parent_list = NULL;
-    node->rpl_info->joined_dodag->sibling_list = NULL;
-    node->rpl_info->joined_dodag->pref_parent = NULL;
-    node->rpl_info->joined_dodag->rank = 3;
-    node->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node, 3);
     node->alive = TRUE;
 
     sim_field_draw_node(node, cr, pixel_x, pixel_y);
@@ -304,13 +288,7 @@ static void draw_legend4(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node);
     rpl_node_init(node);
     node->phy_info->tx_power = 0.5;
-    node->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node->rpl_info->joined_dodag->dodag_id = NULL;
-    node->rpl_info->joined_dodag->parent_list = NULL;
-    node->rpl_info->joined_dodag->sibling_list = NULL;
-    node->rpl_info->joined_dodag->pref_parent = NULL;
-    node->rpl_info->joined_dodag->rank = 3;
-    node->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node, 3);
     node->alive = TRUE;
 
     sim_field_draw_node(node, cr, pixel_x, pixel_y);
@@ -368,13 +346,7 @@ static void draw_legend5(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node);
     rpl_node_init(node);
     node->phy_info->tx_power = 0.5;
-    node->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node->rpl_info->joined_dodag->dodag_id = NULL;
-    node->rpl_info->joined_dodag->parent_list = NULL;
-    node->rpl_info->joined_dodag->sibling_list = NULL;
-    node->rpl_info->joined_dodag->pref_parent = NULL;
-    node->rpl_info->joined_dodag->rank = 1;
-    node->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node, 1);
     node->alive = TRUE;
 
     sim_field_draw_node(node, cr, pixel_x, pixel_y);
@@ -418,13 +390,7 @@ static void draw_legend6(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node);
     rpl_node_init(node);
     node->phy_info->tx_power = 0;
-    node->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node->rpl_info->joined_dodag->dodag_id = NULL;
-    node->rpl_info->joined_dodag->parent_list = NULL;
-    node->rpl_info->joined_dodag->sibling_list = NULL;
-    node->rpl_info->joined_dodag->pref_parent = NULL;
-    node->rpl_info->joined_dodag->rank = 0;
-    node->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node, 0);
     node->alive = TRUE;
 
     uint8 seq_num;
@@ -476,13 +442,7 @@ static void draw_legend7(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node1);
     rpl_node_init(node1);
     node1->phy_info->tx_power = 0.5;
-    node1->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node1->rpl_info->joined_dodag->dodag_id = NULL;
-    node1->rpl_info->joined_dodag->parent_list = NULL;
-    node1->rpl_info->joined_dodag->sibling_list = NULL;
-    node1->rpl_info->joined_dodag->pref_parent = NULL;
-    node1->rpl_info->joined_dodag->rank = 3;
-    node1->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node1, 3);
     node1->alive = TRUE;
 
     node_t *node2 = node_create();
@@ -493,13 +453,7 @@ static void draw_legend7(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node2);
     rpl_node_init(node2);
     node2->phy_info->tx_power = 0.5;
-    node2->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node2->rpl_info->joined_dodag->dodag_id = NULL;
-    node2->rpl_info->joined_dodag->parent_list = NULL;
-    node2->rpl_info->joined_dodag->sibling_list = NULL;
-    node2->rpl_info->joined_dodag->pref_parent = NULL;
-    node2->rpl_info->joined_dodag->rank = 2;
-    node2->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node2, 2);
     node2->alive = TRUE;
 
     sim_field_draw_node(node1, cr, pixel_x1, pixel_y);
@@ -550,13 +504,7 @@ static void draw_legend8(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node1);
     rpl_node_init(node1);
     node1->phy_info->tx_power = 0.5;
-    node1->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node1->rpl_info->joined_dodag->dodag_id = NULL;
-    node1->rpl_info->joined_dodag->parent_list = NULL;
-    node1->rpl_info->joined_dodag->sibling_list = NULL;
-    node1->rpl_info->joined_dodag->pref_parent = NULL;
-    node1->rpl_info->joined_dodag->rank = 3;
-    node1->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node1, 3);
     node1->alive = TRUE;
 
     node_t *node2 = node_create();
@@ -567,13 +515,7 @@ static void draw_legend8(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node2);
     rpl_node_init(node2);
     node2->phy_info->tx_power = 0.5;
-    node2->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node2->rpl_info->joined_dodag->dodag_id = NULL;
-    node2->rpl_info->joined_dodag->parent_list = NULL;
-    node2->rpl_info->joined_dodag->sibling_list = NULL;
-    node2->rpl_info->joined_dodag->pref_parent = NULL;
-    node2->rpl_info->joined_dodag->rank = 2;
-    node2->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node2, 2);
     node2->alive = TRUE;
 
     sim_field_draw_node(node1, cr, pixel_x1, pixel_y);
@@ -624,13 +566,7 @@ static void draw_legend9(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node1);
     rpl_node_init(node1);
     node1->phy_info->tx_power = 0.5;
-    node1->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node1->rpl_info->joined_dodag->dodag_id = NULL;
-    node1->rpl_info->joined_dodag->parent_list = NULL;
-    node1->rpl_info->joined_dodag->sibling_list = NULL;
-    node1->rpl_info->joined_dodag->pref_parent = NULL;
-    node1->rpl_info->joined_dodag->rank = 3;
-    node1->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node1, 3);
     node1->alive = TRUE;
 
     node_t *node2 = node_create();
@@ -641,13 +577,7 @@ static void draw_legend9(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node2);
     rpl_node_init(node2);
     node2->phy_info->tx_power = 0.5;
-    node2->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node2->rpl_info->joined_dodag->dodag_id = NULL;
-    node2->rpl_info->joined_dodag->parent_list = NULL;
-    node2->rpl_info->joined_dodag->sibling_list = NULL;
-    node2->rpl_info->joined_dodag->pref_parent = NULL;
-    node2->rpl_info->joined_dodag->rank = 3;
-    node2->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node2, 3);
     node2->alive = TRUE;
 
     sim_field_draw_node(node1, cr, pixel_x1, pixel_y);
@@ -698,13 +628,7 @@ static void draw_legend10(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node1);
     rpl_node_init(node1);
     node1->phy_info->tx_power = 0.5;
-    node1->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node1->rpl_info->joined_dodag->dodag_id = NULL;
-    node1->rpl_info->joined_dodag->parent_list = NULL;
-    node1->rpl_info->joined_dodag->sibling_list = NULL;
-    node1->rpl_info->joined_dodag->pref_parent = NULL;
-    node1->rpl_info->joined_dodag->rank = 3;
-    node1->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node1, 3);
     node1->alive = TRUE;
 
     node_t *node2 = node_create();
@@ -715,13 +639,7 @@ static void draw_legend10(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node2);
     rpl_node_init(node2);
     node2->phy_info->tx_power = 0.5;
-    node2->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node2->rpl_info->joined_dodag->dodag_id = NULL;
-    node2->rpl_info->joined_dodag->parent_list = NULL;
-    node2->rpl_info->joined_dodag->sibling_list = NULL;
-    node2->rpl_info->joined_dodag->pref_parent = NULL;
-    node2->rpl_info->joined_dodag->rank = 2;
-    node2->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node2, 2);
     node2->alive = FALSE;
 
     sim_field_draw_node(node1, cr, pixel_x1, pixel_y);
@@ -772,13 +690,7 @@ static void draw_legend11(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node1);
     rpl_node_init(node1);
     node1->phy_info->tx_power = 0.5;
-    node1->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node1->rpl_info->joined_dodag->dodag_id = NULL;
-    node1->rpl_info->joined_dodag->parent_list = NULL;
-    node1->rpl_info->joined_dodag->sibling_list = NULL;
-    node1->rpl_info->joined_dodag->pref_parent = NULL;
-    node1->rpl_info->joined_dodag->rank = 3;
-    node1->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node1, 3);
     node1->alive = TRUE;
 
     node_t *node2 = node_create();
@@ -789,13 +701,7 @@ static void draw_legend11(GdkWindow *window, GdkGC *gc)
     icmp_node_init(node2);
     rpl_node_init(node2);
     node2->phy_info->tx_power = 0.5;
-    node2->rpl_info->joined_dodag = malloc(sizeof(rpl_dodag_t));
-    node2->rpl_info->joined_dodag->dodag_id = NULL;
-    node2->rpl_info->joined_dodag->parent_list = NULL;
-    node2->rpl_info->joined_dodag->sibling_list = NULL;
-    node2->rpl_info->joined_dodag->pref_parent = NULL;
-    node2->rpl_info->joined_dodag->rank = 3;
-    node2->rpl_info->joined_dodag->seq_num = 0;
+    legend_init_dodag(node2, 3);
     node2->alive = FALSE;
 
     sim_field_draw_node(node1, cr, pixel_x1, pixel_y);
@@ -818,3 +724,24 @@ static void draw_legend11(GdkWindow *window, GdkGC *gc)
     cairo_surface_destroy(surface);
 }
 
+static void legend_init_dodag(node_t *node, uint16 rank)
+{
+    /* just enough of a joined dodag for the node to be drawn */
+    rpl_dodag_t *dodag = malloc(sizeof(rpl_dodag_t));
+
+    dodag->dodag_id = NULL;
+    dodag->interned_dodag_id = ADDR_UNKNOWN;
+    dodag->parent_list = NULL;
+    dodag->parent_count = 0;
+    dodag->sibling_list = NULL;
+    dodag->sibling_count = 0;
+    node_map_init(&dodag->parent_map);
+    node_map_init(&dodag->sibling_map);
+    dodag->candidate_heap = NULL;
+    dodag->candidate_count = 0;
+    dodag->pref_parent = NULL;
+    dodag->rank = rank;
+    dodag->seq_num = 0;
+
+    node->rpl_info->joined_dodag = dodag;
+}
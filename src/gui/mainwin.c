@@ -706,7 +706,7 @@ void main_win_node_to_gui(node_t *node, uint32 what)
         }
         else if (rpl_node_is_root(node)) {
             gtk_entry_set_text(GTK_ENTRY(params_nodes_dag_id_entry), root_info->dodag_id);
-            snprintf(temp, sizeof(temp), "%d", rpl_seq_num_get(node->rpl_info->root_info->dodag_id));
+            snprintf(temp, sizeof(temp), "%d", rpl_seq_num_get(node->rpl_info->root_info->interned_dodag_id));
             gtk_entry_set_text(GTK_ENTRY(params_nodes_seq_num_entry), temp);
 
             snprintf(temp, sizeof(temp), "%d", RPL_RANK_ROOT);
@@ -803,7 +803,8 @@ void main_win_node_to_gui(node_t *node, uint32 what)
             snprintf(temp, sizeof(temp), "%d/%d", node->measure_info->gen_ip_packet_count, node->measure_info->fwd_ip_packet_count);
             gtk_label_set_text(GTK_LABEL(params_nodes_measure_stat_ip_packets_label), temp);
 
-            snprintf(temp, sizeof(temp), "%d", node->ip_info->enqueued_count);
+            snprintf(temp, sizeof(temp), "%d (%d ms avg)", node->ip_info->enqueued_count,
+                    node->measure_info->ip_dequeued_count > 0 ? node->measure_info->ip_queue_delay_total / node->measure_info->ip_dequeued_count : 0);
             gtk_label_set_text(GTK_LABEL(params_nodes_measure_stat_queued_ip_packets_label), temp);
 
             float percent;
@@ -2560,6 +2561,9 @@ static void gui_to_system()
     rs_system->no_link_quality_thresh = gtk_spin_button_get_value(GTK_SPIN_BUTTON(params_system_no_link_quality_spin)) / 100.0;
     rs_system->transmission_time = gtk_spin_button_get_value(GTK_SPIN_BUTTON(params_system_transmission_time_spin));
 
+    /* the no-link distance threshold bounds the gain tables */
+    phy_update_gains();
+
     /* mac */
     rs_system->mac_pdu_timeout = gtk_spin_button_get_value(GTK_SPIN_BUTTON(params_system_mac_pdu_timeout_spin));
 
@@ -2672,6 +2676,7 @@ static void gui_to_node(node_t *node)
     bool should_start_ping = FALSE;
     if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(params_nodes_enable_ping_measurements_check))) {
         node->icmp_info->ping_ip_address = gtk_combo_box_get_active_text(GTK_COMBO_BOX(params_nodes_ping_address_combo));
+        node->icmp_info->ping_address_id = addr_intern(node->icmp_info->ping_ip_address);
         should_start_ping = TRUE;
     }
     else {
@@ -2699,6 +2704,7 @@ static void gui_to_node(node_t *node)
             free(root_info->dodag_id);
         }
         root_info->dodag_id = strdup(gtk_entry_get_text(GTK_ENTRY(params_nodes_dag_id_entry)));
+        root_info->interned_dodag_id = addr_intern(root_info->dodag_id);
 
         if (node->rpl_info->root_info->grounded) {
             if (root_info->configured_dodag_id != NULL) {
@@ -2707,6 +2713,7 @@ static void gui_to_node(node_t *node)
             root_info->configured_dodag_id = strdup(gtk_entry_get_text(GTK_ENTRY(params_nodes_dag_id_entry)));
         }
     }
+    rpl_node_update_tree(node); /* the grounded flag may have changed */
 
     /* measure */
     bool should_start_connect_measure = FALSE;
@@ -2726,7 +2733,7 @@ static void gui_to_node(node_t *node)
             rs_system_cancel_event(node, icmp_event_ping_timeout, NULL, NULL, 0);
             rs_system_cancel_event(node, icmp_event_ping_request, NULL, NULL, 0);
             rs_system_schedule_event(node, icmp_event_ping_request,
-                    node->icmp_info->ping_ip_address, (void *) node->icmp_info->ping_seq_num++,
+                    GUINT_TO_POINTER(node->icmp_info->ping_address_id), (void *) node->icmp_info->ping_seq_num++,
                     rs_system_random() % node->icmp_info->ping_interval);
         }
         if (should_start_connect_measure) {
@@ -160,7 +160,7 @@ void sim_field_draw_node(node_t *node, cairo_t *cr, double pixel_x, double pixel
     uint8 sequence_number;
 
     if (rpl_node_is_root(node)) {
-        sequence_number = rpl_seq_num_get(node->rpl_info->root_info->dodag_id);
+        sequence_number = rpl_seq_num_get(node->rpl_info->root_info->interned_dodag_id);
     }
     else if (rpl_node_is_joined(node)) {
         sequence_number = node->rpl_info->joined_dodag->seq_num;
@@ -225,6 +225,7 @@ node_t *rs_add_node(coord_t x, coord_t y)
     ip_node_init(node, new_ip_address);
     icmp_node_init(node);
     rpl_node_init(node);
+    traffic_node_init(node);
 
     rs_system_add_node(node);
 
@@ -24,8 +24,19 @@
 #include "system.h"
 
 
+    /**** global variables ****/
+
+static uint32 *                 free_index_list = NULL;
+static uint32                   free_index_count = 0;
+static uint32                   next_index = 0;
+
+
     /**** local function prototypes ****/
 
+static uint32                   map_slot(node_map_t *map, uint32 key);
+static void                     map_grow(node_map_t *map);
+
+
     /**** exported functions ****/
 
 node_t *node_create()
@@ -38,8 +49,18 @@ node_t *node_create()
     node->ip_info = NULL;
     node->icmp_info = NULL;
     node->rpl_info = NULL;
+    node->traffic_info = NULL;
 
     node->alive = FALSE;
+
+    /* reuse the indexes of the destroyed nodes first, so they stay dense */
+    if (free_index_count > 0) {
+        node->index = free_index_list[--free_index_count];
+    }
+    else {
+        node->index = next_index++;
+    }
+
     return node;
 }
 
@@ -54,6 +75,7 @@ bool node_destroy(node_t *node)
         }
     }
 
+    traffic_node_done(node);
     rpl_node_done(node);
     icmp_node_done(node);
     ip_node_done(node);
@@ -61,6 +83,9 @@ bool node_destroy(node_t *node)
     phy_node_done(node);
     measure_node_done(node);
 
+    free_index_list = realloc(free_index_list, (free_index_count + 1) * sizeof(uint32));
+    free_index_list[free_index_count++] = node->index;
+
     free(node);
 
     return TRUE;
@@ -103,6 +128,137 @@ bool node_kill(node_t* node)
     return TRUE;
 }
 
+void node_map_init(node_map_t *map)
+{
+    rs_assert(map != NULL);
+
+    map->key_list = NULL;
+    map->value_list = NULL;
+    map->size = 0;
+    map->count = 0;
+}
+
+void node_map_done(node_map_t *map)
+{
+    rs_assert(map != NULL);
+
+    if (map->key_list != NULL) {
+        free(map->key_list);
+        free(map->value_list);
+    }
+
+    node_map_init(map);
+}
+
+void *node_map_get(node_map_t *map, node_t *node)
+{
+    rs_assert(map != NULL);
+
+    if (map->count == 0 || node == NULL) {
+        return NULL;
+    }
+
+    uint32 slot = map_slot(map, node->index + 1);
+    if (map->key_list[slot] == 0) {
+        return NULL;
+    }
+
+    return map->value_list[slot];
+}
+
+void node_map_put(node_map_t *map, node_t *node, void *value)
+{
+    rs_assert(map != NULL);
+    rs_assert(node != NULL);
+
+    if (2 * (map->count + 1) > map->size) {
+        map_grow(map);
+    }
+
+    uint32 slot = map_slot(map, node->index + 1);
+    if (map->key_list[slot] == 0) {
+        map->key_list[slot] = node->index + 1;
+        map->count++;
+    }
+
+    map->value_list[slot] = value;
+}
+
+bool node_map_remove(node_map_t *map, node_t *node)
+{
+    rs_assert(map != NULL);
+    rs_assert(node != NULL);
+
+    if (map->count == 0) {
+        return FALSE;
+    }
+
+    uint32 mask = map->size - 1;
+    uint32 slot = map_slot(map, node->index + 1);
+    if (map->key_list[slot] == 0) {
+        return FALSE;
+    }
+
+    /* shift the following entries of the cluster back, so no tombstones are needed */
+    uint32 next = slot;
+    while (TRUE) {
+        next = (next + 1) & mask;
+        if (map->key_list[next] == 0) {
+            break;
+        }
+
+        uint32 home = (map->key_list[next] * 2654435761u) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) { /* the entry may fill the hole */
+            map->key_list[slot] = map->key_list[next];
+            map->value_list[slot] = map->value_list[next];
+            slot = next;
+        }
+    }
+
+    map->key_list[slot] = 0;
+    map->value_list[slot] = NULL;
+    map->count--;
+
+    return TRUE;
+}
+
 
 /**** local functions ****/
 
+static uint32 map_slot(node_map_t *map, uint32 key)
+{
+    uint32 mask = map->size - 1;
+    uint32 slot = (key * 2654435761u) & mask;
+
+    while (map->key_list[slot] != 0 && map->key_list[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void map_grow(node_map_t *map)
+{
+    uint32 *old_key_list = map->key_list;
+    void **old_value_list = map->value_list;
+    uint32 old_size = map->size;
+
+    map->size = (old_size > 0) ? 2 * old_size : NODE_MAP_INITIAL_SIZE;
+    map->key_list = calloc(map->size, sizeof(uint32));
+    map->value_list = calloc(map->size, sizeof(void *));
+
+    uint32 i;
+    for (i = 0; i < old_size; i++) {
+        if (old_key_list[i] != 0) {
+            uint32 slot = map_slot(map, old_key_list[i]);
+            map->key_list[slot] = old_key_list[i];
+            map->value_list[slot] = old_value_list[i];
+        }
+    }
+
+    if (old_key_list != NULL) {
+        free(old_key_list);
+        free(old_value_list);
+    }
+}
+
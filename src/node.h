@@ -23,6 +23,8 @@
 
 #include "base.h"
 
+#define NODE_MAP_INITIAL_SIZE           8
+
 
     /* a node in the simulated network */
 typedef struct node_t {
@@ -33,15 +35,33 @@ typedef struct node_t {
     struct ip_node_info_t *     ip_info;
     struct icmp_node_info_t *   icmp_info;
     struct rpl_node_info_t *    rpl_info;
+    struct traffic_node_info_t *traffic_info;
 
     bool                        alive;
+    uint32                      index;  /* dense and unique among the existing nodes, reused after destroy */
 
 } node_t;
 
+    /* an open-addressing map from node indexes to per-neighbor records */
+typedef struct node_map_t {
+
+    uint32 *                    key_list;   /* node index + 1, 0 marks a free slot */
+    void **                     value_list;
+    uint32                      size;       /* a power of 2, at most half full */
+    uint16                      count;
+
+} node_map_t;
+
 
 node_t *                        node_create();
 bool                            node_destroy(node_t* node);
 
+void                            node_map_init(node_map_t *map);
+void                            node_map_done(node_map_t *map);
+void *                          node_map_get(node_map_t *map, node_t *node);
+void                            node_map_put(node_map_t *map, node_t *node, void *value);
+bool                            node_map_remove(node_map_t *map, node_t *node);
+
 bool                            node_wake(node_t* node);
 bool                            node_kill(node_t* node);
 
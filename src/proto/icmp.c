@@ -40,12 +40,12 @@ uint16                  icmp_event_ping_timeout;
 static bool             event_handler_node_wake(node_t *node);
 static bool             event_handler_node_kill(node_t *node);
 
-static bool             event_handler_pdu_send(node_t *node, char *dst_ip_address, icmp_pdu_t *pdu);
+static bool             event_handler_pdu_send(node_t *node, address_t dst_address, icmp_pdu_t *pdu);
 static bool             event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pdu_t *pdu); /* yes, it's ip_pdu_t, since icmp and ip work closely together */
 
-static bool             event_handler_ping_request(node_t *node, char *dst_ip_address, uint32 seq_num);
-static bool             event_handler_ping_reply(node_t *node, char *dst_ip_address, uint32 seq_num);
-static bool             event_handler_ping_timeout(node_t *node, char *dst_ip_address, uint32 seq_num);
+static bool             event_handler_ping_request(node_t *node, address_t dst_address, uint32 seq_num);
+static bool             event_handler_ping_reply(node_t *node, address_t dst_address, uint32 seq_num);
+static bool             event_handler_ping_timeout(node_t *node, address_t dst_address, uint32 seq_num);
 
 static void             event_arg_str(uint16 event_id, void *data1, void *data2, char *str1, char *str2, uint16 len);
 
@@ -169,6 +169,7 @@ void icmp_node_init(node_t *node)
 
     node->icmp_info = malloc(sizeof(icmp_node_info_t));
     node->icmp_info->ping_ip_address = NULL;
+    node->icmp_info->ping_address_id = ADDR_UNKNOWN;
     node->icmp_info->ping_interval = ICMP_DEFAULT_PING_INTERVAL;
     node->icmp_info->ping_timeout = ICMP_DEFAULT_PING_TIMEOUT;
     node->icmp_info->ping_request_time = -1;
@@ -189,14 +190,14 @@ void icmp_node_done(node_t *node)
     }
 }
 
-bool icmp_node_send(node_t *node, char *dst_ip_address, uint8 type, uint8 code, void *sdu)
+bool icmp_node_send(node_t *node, address_t dst_address, uint8 type, uint8 code, void *sdu)
 {
     rs_assert(node != NULL);
 
     icmp_pdu_t *icmp_pdu = icmp_pdu_create();
     icmp_pdu_set_sdu(icmp_pdu, type, code, sdu);
 
-    if (!event_execute(icmp_event_pdu_send, node, dst_ip_address, icmp_pdu)) {
+    if (!event_execute(icmp_event_pdu_send, node, GUINT_TO_POINTER(dst_address), icmp_pdu)) {
         icmp_pdu->sdu = NULL;
         icmp_pdu_destroy(icmp_pdu);
         return FALSE;
@@ -224,7 +225,7 @@ static bool event_handler_node_wake(node_t *node)
 {
     if (node->icmp_info->ping_ip_address != NULL) {
         rs_system_schedule_event(node, icmp_event_ping_request,
-                node->icmp_info->ping_ip_address, (void *) node->icmp_info->ping_seq_num++,
+                GUINT_TO_POINTER(node->icmp_info->ping_address_id), (void *) node->icmp_info->ping_seq_num++,
                 rs_system_random() % node->icmp_info->ping_interval);
     }
 
@@ -242,9 +243,9 @@ static bool event_handler_node_kill(node_t *node)
     return TRUE;
 }
 
-static bool event_handler_pdu_send(node_t *node, char *dst_ip_address, icmp_pdu_t *pdu)
+static bool event_handler_pdu_send(node_t *node, address_t dst_address, icmp_pdu_t *pdu)
 {
-    return ip_node_send(node, dst_ip_address, IP_NEXT_HEADER_ICMP, pdu);
+    return ip_node_send(node, dst_address, IP_NEXT_HEADER_ICMP, pdu);
 }
 
 static bool event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu)
@@ -257,22 +258,22 @@ static bool event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pd
     switch (pdu->type) {
 
         case ICMP_TYPE_ECHO_REQUEST: {
-            rs_debug(DEBUG_ICMP, "node '%s': received a ping request from '%s'", node->phy_info->name, ip_pdu->src_address);
+            rs_debug(DEBUG_ICMP, "node '%s': received a ping request from '%s'", node->phy_info->name, addr_to_string(ip_pdu->src_address));
 
-            event_execute(icmp_event_ping_reply, node, ip_pdu->src_address, pdu->sdu);
+            event_execute(icmp_event_ping_reply, node, GUINT_TO_POINTER(ip_pdu->src_address), pdu->sdu);
 
             break;
         }
 
         case ICMP_TYPE_ECHO_REPLY: {
             if (node->icmp_info->ping_request_time != -1) {
-                rs_debug(DEBUG_ICMP, "node '%s': received a ping reply from '%s'", node->phy_info->name, ip_pdu->src_address);
+                rs_debug(DEBUG_ICMP, "node '%s': received a ping reply from '%s'", node->phy_info->name, addr_to_string(ip_pdu->src_address));
                 measure_node_add_ping(node, TRUE);
                 rs_system_cancel_event(node, icmp_event_ping_timeout, NULL, pdu->sdu, 0);
 
                 if (node->icmp_info->ping_ip_address != NULL) {
                     rs_system_schedule_event(node, icmp_event_ping_request,
-                            node->icmp_info->ping_ip_address, (void *) node->icmp_info->ping_seq_num++, node->icmp_info->ping_interval);
+                            GUINT_TO_POINTER(node->icmp_info->ping_address_id), (void *) node->icmp_info->ping_seq_num++, node->icmp_info->ping_interval);
                 }
 
                 node->icmp_info->ping_request_time = -1;
@@ -330,40 +331,40 @@ static bool event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pd
     return all_ok;
 }
 
-static bool event_handler_ping_request(node_t *node, char *dst_ip_address, uint32 seq_num)
+static bool event_handler_ping_request(node_t *node, address_t dst_address, uint32 seq_num)
 {
-    rs_debug(DEBUG_ICMP, "node '%s': sending a ping request to '%s'", node->phy_info->name, node->icmp_info->ping_ip_address);
+    rs_debug(DEBUG_ICMP, "node '%s': sending a ping request to '%s'", node->phy_info->name, addr_to_string(dst_address));
 
-    icmp_node_send(node, dst_ip_address, ICMP_TYPE_ECHO_REQUEST, 0, (void *) seq_num);
+    icmp_node_send(node, dst_address, ICMP_TYPE_ECHO_REQUEST, 0, (void *) seq_num);
 
     rs_system_schedule_event(node, icmp_event_ping_timeout,
-            dst_ip_address, (void *) seq_num, node->icmp_info->ping_timeout);
+            GUINT_TO_POINTER(dst_address), (void *) seq_num, node->icmp_info->ping_timeout);
 
     node->icmp_info->ping_request_time = rs_system->now;
 
     return TRUE;
 }
 
-static bool event_handler_ping_reply(node_t *node, char *dst_ip_address, uint32 seq_num)
+static bool event_handler_ping_reply(node_t *node, address_t dst_address, uint32 seq_num)
 {
-    icmp_node_send(node, dst_ip_address, ICMP_TYPE_ECHO_REPLY, 0, (void *) seq_num);
+    icmp_node_send(node, dst_address, ICMP_TYPE_ECHO_REPLY, 0, (void *) seq_num);
 
     return TRUE;
 }
 
-static bool event_handler_ping_timeout(node_t *node, char *dst_ip_address, uint32 seq_num)
+static bool event_handler_ping_timeout(node_t *node, address_t dst_address, uint32 seq_num)
 {
     if (!node->icmp_info->ping_request_time == -1) {
         return TRUE; /* this should never happen */
     }
 
-    rs_debug(DEBUG_ICMP, "node '%s': ping request to '%s' timeout", node->phy_info->name, dst_ip_address);
+    rs_debug(DEBUG_ICMP, "node '%s': ping request to '%s' timeout", node->phy_info->name, addr_to_string(dst_address));
 
     measure_node_add_ping(node, FALSE);
 
     if (node->icmp_info->ping_ip_address != NULL) {
         rs_system_schedule_event(node, icmp_event_ping_request,
-                node->icmp_info->ping_ip_address, (void *) node->icmp_info->ping_seq_num++, node->icmp_info->ping_interval);
+                GUINT_TO_POINTER(node->icmp_info->ping_address_id), (void *) node->icmp_info->ping_seq_num++, node->icmp_info->ping_interval);
     }
 
     node->icmp_info->ping_request_time = -1;
@@ -378,36 +379,36 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
     str2[0] = '\0';
 
     if (event_id == icmp_event_pdu_send) {
-        char *dst_ip_address = data1;
+        address_t dst_address = GPOINTER_TO_UINT(data1);
 
-        snprintf(str1, len, "dst = '%s'", dst_ip_address != NULL ? dst_ip_address : "<<broadcast>>");
+        snprintf(str1, len, "dst = '%s'", dst_address != ADDR_BROADCAST ? addr_to_string(dst_address) : "<<broadcast>>");
     }
     else if (event_id == icmp_event_pdu_receive) {
         node_t *node = data1;
         ip_pdu_t *pdu = data2;
 
         snprintf(str1, len, "incoming_node = '%s'", (node != NULL ? node->phy_info->name : "<<unknown>>"));
-        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", pdu->src_address, pdu->dst_address);
+        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", addr_to_string(pdu->src_address), addr_to_string(pdu->dst_address));
     }
     else if (event_id == icmp_event_ping_request) {
-        char *dst_ip_address = data1;
+        address_t dst_address = GPOINTER_TO_UINT(data1);
         uint32 seq_num = (uint32) data2;
 
-        snprintf(str1, len, "dst = '%s'", dst_ip_address != NULL ? dst_ip_address : "<<broadcast>>");
+        snprintf(str1, len, "dst = '%s'", dst_address != ADDR_BROADCAST ? addr_to_string(dst_address) : "<<broadcast>>");
         snprintf(str2, len, "seq_num = %d", seq_num);
     }
     else if (event_id == icmp_event_ping_reply) {
-        char *dst_ip_address = data1;
+        address_t dst_address = GPOINTER_TO_UINT(data1);
         uint32 seq_num = (uint32) data2;
 
-        snprintf(str1, len, "dst = '%s'", dst_ip_address != NULL ? dst_ip_address : "<<broadcast>>");
+        snprintf(str1, len, "dst = '%s'", dst_address != ADDR_BROADCAST ? addr_to_string(dst_address) : "<<broadcast>>");
         snprintf(str2, len, "seq_num = %d", seq_num);
     }
     else if (event_id == icmp_event_ping_timeout) {
-        char *dst_ip_address = data1;
+        address_t dst_address = GPOINTER_TO_UINT(data1);
         uint32 seq_num = (uint32) data2;
 
-        snprintf(str1, len, "dst = '%s'", dst_ip_address != NULL ? dst_ip_address : "<<broadcast>>");
+        snprintf(str1, len, "dst = '%s'", dst_address != ADDR_BROADCAST ? addr_to_string(dst_address) : "<<broadcast>>");
         snprintf(str2, len, "seq_num = %d", seq_num);
     }
 }
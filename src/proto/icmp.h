@@ -38,6 +38,7 @@
 typedef struct icmp_node_info_t {
 
     char *                  ping_ip_address;
+    address_t               ping_address_id;
     sim_time_t              ping_interval;
     sim_time_t              ping_timeout;
     sim_time_t              ping_request_time;
@@ -78,7 +79,7 @@ void                        icmp_pdu_set_sdu(icmp_pdu_t *pdu, uint8 type, uint8
 void                        icmp_node_init(node_t *node);
 void                        icmp_node_done(node_t *node);
 
-bool                        icmp_node_send(node_t *node, char *dst_ip_address, uint8 type, uint8 code, void *sdu);
+bool                        icmp_node_send(node_t *node, address_t dst_address, uint8 type, uint8 code, void *sdu);
 bool                        icmp_node_receive(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu); /* yes, ip_pdu_t */
 
 
@@ -20,11 +20,29 @@
 
 // todo source routing
 
-#include <ctype.h>
-
 #include "ip.h"
 #include "../system.h"
 
+#define route_prefix_mask(len)      ((len) == 0 ? 0 : ~0ULL << (ADDR_MAX_BITS - (len)))
+#define route_bit_at(bits, pos)     (((bits) >> (ADDR_MAX_BITS - 1 - (pos))) & 1)
+
+#define ROUTE_VIA_LIST              0
+#define ROUTE_VIA_NEXT_HOP          1
+#define ROUTE_VIA_TYPE              2
+
+#define route_chain_append(index, route, prev, next) { \
+        route->prev = (index)->last; \
+        route->next = NULL; \
+        if ((index)->last != NULL) (index)->last->next = route; else (index)->first = route; \
+        (index)->last = route; \
+}
+
+#define route_chain_unlink(index, route, prev, next) { \
+        if (route->prev != NULL) route->prev->next = route->next; else (index)->first = route->next; \
+        if (route->next != NULL) route->next->prev = route->prev; else (index)->last = route->prev; \
+        route->prev = route->next = NULL; \
+}
+
 
     /**** global variables ****/
 
@@ -37,6 +55,10 @@ uint16                      ip_event_pdu_receive;
 
 uint16                      ip_event_neighbor_cache_timeout_check;
 
+    /* allocation counters, showing that forwarding copies nothing */
+uint32                      ip_pdu_create_count = 0;
+uint32                      ip_pdu_duplicate_count = 0;
+
 
     /**** local function prototypes ****/
 
@@ -47,9 +69,32 @@ static bool                 event_handler_pdu_send(node_t *node, node_t *incomin
 static bool                 event_handler_pdu_send_timeout_check(node_t *node, ip_send_info_t *ip_send_info, ip_pdu_t *pdu);
 static bool                 event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pdu_t *pdu);
 
-static bool                 event_handler_neighbor_cache_timeout(node_t *node, ip_neighbor_t *neighbor);
+static bool                 event_handler_neighbor_cache_timeout(node_t *node);
+
+static bool                 queue_push(node_t *node, node_t *incoming_node, ip_pdu_t *pdu);
+static void                 queue_drain(node_t *node);
+static void                 queue_flush(node_t *node);
+
+static void                 send_info_refresh(node_t *node, ip_send_info_t *ip_send_info, node_t *failed_hop);
+
+static void                 neighbor_expiry_insert(node_t *node, ip_neighbor_t *neighbor, sim_time_t expiry_time);
+static void                 neighbor_expiry_unlink(node_t *node, ip_neighbor_t *neighbor);
+static void                 neighbor_expiry_schedule(node_t *node);
+
+static void                 route_unlink(node_t *node, ip_route_t *route);
+static bool                 route_matches(ip_route_t *route, char *dst, int8 prefix_len, node_t *next_hop, int8 type);
+static ip_route_t *         route_first_candidate(node_t *node, node_t *next_hop, int8 type, uint8 *via);
+static ip_route_t *         route_next_candidate(node_t *node, ip_route_t *route, uint8 via);
+static void                 route_index_add(node_t *node, ip_route_t *route);
+static void                 route_index_rem(node_t *node, ip_route_t *route);
+static ip_route_index_t *   route_next_hop_index_find(node_t *node, node_t *next_hop);
 
-static uint8 *              route_expand_to_bits(char *dst, uint8 prefix_len);
+static void                 route_trie_add(node_t *node, ip_route_t *route);
+static void                 route_trie_rem(node_t *node, ip_route_t *route);
+static ip_route_trie_t *    route_trie_create(uint64 key, uint8 len, ip_route_trie_t *parent);
+static ip_route_trie_t *    route_trie_insert(ip_route_trie_t **root, uint64 key, uint8 len);
+static void                 route_trie_prune(ip_route_trie_t **root, ip_route_trie_t *trie);
+static void                 route_trie_destroy(ip_route_trie_t *trie);
 
 static void                 event_arg_str(uint16 event_id, void *data1, void *data2, char *str1, char *str2, uint16 len);
 
@@ -75,38 +120,34 @@ bool ip_done()
     return TRUE;
 }
 
-ip_send_info_t *ip_send_info_create(node_t *incoming_node, node_t *first_next_hop, node_t **next_hop_list, uint16 next_hop_count)
+ip_send_info_t *ip_send_info_create(node_t *node, node_t *incoming_node, node_t *first_next_hop)
 {
-    ip_send_info_t *ip_send_info = malloc(sizeof(ip_send_info_t));
+    rs_assert(node != NULL);
+
+    /* a node sends one unicast at a time, so its send info is reused */
+    ip_send_info_t *ip_send_info = &node->ip_info->send_info;
+    rs_assert(ip_send_info->rpl_next_hop_list == NULL);
 
     ip_send_info->incoming_node = incoming_node;
     ip_send_info->next_hop_index = 0;
 
-    uint16 i;
+    rpl_next_hop_list_t *next_hop_list = rpl_node_get_next_hop_list(node);
+    uint16 i, next_hop_count = next_hop_list != NULL ? next_hop_list->node_count : 0;
+
     for (i = 0; i < next_hop_count; i++) {
-        if (next_hop_list[i] == first_next_hop) {
+        if (next_hop_list->node_list[i] == first_next_hop) {
             first_next_hop = NULL;
             break;
         }
     }
 
-    if (first_next_hop != NULL) {
-        ip_send_info->next_hop_list = malloc((next_hop_count + 1) * sizeof(node_t *));
-        ip_send_info->next_hop_list[0] = first_next_hop;
-        ip_send_info->next_hop_count = 1;
-    }
-    else if (next_hop_count > 0) {
-        ip_send_info->next_hop_list = malloc(next_hop_count * sizeof(node_t *));
-        ip_send_info->next_hop_count = 0;
-    }
-    else {
-        ip_send_info->next_hop_list = NULL;
-        ip_send_info->next_hop_count = 0;
+    if (next_hop_list != NULL) {
+        rpl_next_hop_list_hold(next_hop_list);
     }
 
-    for (i = 0; i < next_hop_count; i++) {
-        ip_send_info->next_hop_list[ip_send_info->next_hop_count++] = next_hop_list[i];
-    }
+    ip_send_info->first_next_hop = first_next_hop;
+    ip_send_info->rpl_next_hop_list = next_hop_list;
+    ip_send_info->next_hop_count = next_hop_count + (first_next_hop != NULL ? 1 : 0);
 
     return ip_send_info;
 }
@@ -115,22 +156,38 @@ void ip_send_info_destroy(ip_send_info_t *ip_send_info)
 {
     rs_assert(ip_send_info != NULL);
 
-    if (ip_send_info->next_hop_list != NULL) {
-        free(ip_send_info->next_hop_list);
+    if (ip_send_info->rpl_next_hop_list != NULL) {
+        rpl_next_hop_list_release(ip_send_info->rpl_next_hop_list);
+        ip_send_info->rpl_next_hop_list = NULL;
     }
 
-    free(ip_send_info);
+    ip_send_info->first_next_hop = NULL;
+    ip_send_info->next_hop_count = 0;
 }
 
-ip_pdu_t *ip_pdu_create(char *src_address, char *dst_address)
+node_t *ip_send_info_get_next_hop(ip_send_info_t *ip_send_info, uint16 index)
 {
-    rs_assert(dst_address != NULL);
-    rs_assert(src_address != NULL);
+    rs_assert(ip_send_info != NULL);
+    rs_assert(index < ip_send_info->next_hop_count);
+
+    if (ip_send_info->first_next_hop != NULL) {
+        if (index == 0) {
+            return ip_send_info->first_next_hop;
+        }
 
+        index--;
+    }
+
+    return ip_send_info->rpl_next_hop_list->node_list[index];
+}
+
+ip_pdu_t *ip_pdu_create(address_t src_address, address_t dst_address)
+{
     ip_pdu_t *pdu = malloc(sizeof(ip_pdu_t));
+    ip_pdu_create_count++;
 
-    pdu->src_address = strdup(src_address);
-    pdu->dst_address = strdup(dst_address);
+    pdu->src_address = src_address;
+    pdu->dst_address = dst_address;
 
     pdu->flow_label = malloc(sizeof(ip_flow_label_t));
     pdu->flow_label->forward_error = FALSE;
@@ -139,11 +196,13 @@ ip_pdu_t *ip_pdu_create(char *src_address, char *dst_address)
     pdu->flow_label->rank_error = FALSE;
     pdu->flow_label->sender_rank = 0;
 
+    pdu->source_route = NULL;
+    pdu->source_route_count = 0;
+    pdu->source_route_index = 0;
+
     pdu->next_header = -1;
     pdu->sdu = NULL;
 
-    pdu->queued = FALSE;
-
     return pdu;
 }
 
@@ -151,13 +210,12 @@ void ip_pdu_destroy(ip_pdu_t *pdu)
 {
     rs_assert(pdu != NULL);
 
-    if (pdu->dst_address != NULL)
-        free(pdu->dst_address);
-    if (pdu->src_address != NULL)
-        free(pdu->src_address);
     if (pdu->flow_label != NULL)
         free(pdu->flow_label);
 
+    if (pdu->source_route != NULL)
+        free(pdu->source_route);
+
     if (pdu->sdu != NULL) {
         switch (pdu->next_header) {
 
@@ -171,6 +229,11 @@ void ip_pdu_destroy(ip_pdu_t *pdu)
 
                 break;
 
+            case IP_NEXT_HEADER_TRAFFIC :
+                traffic_pdu_destroy(pdu->sdu);
+
+                break;
+
         }
     }
 
@@ -182,15 +245,26 @@ ip_pdu_t *ip_pdu_duplicate(ip_pdu_t *pdu)
     rs_assert(pdu != NULL);
 
     ip_pdu_t *new_pdu = malloc(sizeof(ip_pdu_t));
+    ip_pdu_duplicate_count++;
 
-    new_pdu->dst_address = strdup(pdu->dst_address);
-    new_pdu->src_address = strdup(pdu->src_address);
+    new_pdu->dst_address = pdu->dst_address;
+    new_pdu->src_address = pdu->src_address;
 
     if (pdu->flow_label != NULL) {
         new_pdu->flow_label = malloc(sizeof(ip_flow_label_t));
         *new_pdu->flow_label = *pdu->flow_label;
     }
 
+    if (pdu->source_route != NULL) {
+        new_pdu->source_route = malloc(pdu->source_route_count * sizeof(address_t));
+        memcpy(new_pdu->source_route, pdu->source_route, pdu->source_route_count * sizeof(address_t));
+    }
+    else {
+        new_pdu->source_route = NULL;
+    }
+    new_pdu->source_route_count = pdu->source_route_count;
+    new_pdu->source_route_index = pdu->source_route_index;
+
     new_pdu->next_header = pdu->next_header;
 
     switch (pdu->next_header) {
@@ -204,13 +278,16 @@ ip_pdu_t *ip_pdu_duplicate(ip_pdu_t *pdu)
 
             break;
 
+        case IP_NEXT_HEADER_TRAFFIC :
+            new_pdu->sdu = traffic_pdu_duplicate(pdu->sdu);
+
+            break;
+
         default:
             rs_error("invalid ip next header '0x%04X'", pdu->next_header);
             new_pdu->sdu = NULL;
     }
 
-    new_pdu->queued = pdu->queued;
-
     return new_pdu;
 }
 
@@ -230,13 +307,32 @@ void ip_node_init(node_t *node, char *address)
     node->ip_info = malloc(sizeof(ip_node_info_t));
 
     node->ip_info->address = strdup(address);
+    node->ip_info->address_id = addr_intern(address);
 
     node->ip_info->route_list = NULL;
     node->ip_info->route_count = 0;
+    node->ip_info->route_trie = NULL;
+    memset(node->ip_info->route_type_index, 0, sizeof(node->ip_info->route_type_index));
+    node->ip_info->route_next_hop_index = NULL;
+    node->ip_info->route_next_hop_index_count = 0;
 
     node->ip_info->neighbor_list = NULL;
     node->ip_info->neighbor_count = 0;
-
+    node_map_init(&node->ip_info->neighbor_map);
+    node->ip_info->expiry_first = NULL;
+    node->ip_info->expiry_last = NULL;
+    node->ip_info->expiry_sweep_pending = FALSE;
+    node->ip_info->expiry_sweep_time = 0;
+
+    node->ip_info->send_info.incoming_node = NULL;
+    node->ip_info->send_info.first_next_hop = NULL;
+    node->ip_info->send_info.rpl_next_hop_list = NULL;
+    node->ip_info->send_info.next_hop_count = 0;
+    node->ip_info->send_info.next_hop_index = 0;
+
+    node->ip_info->queue = NULL;
+    node->ip_info->queue_size = 0;
+    node->ip_info->queue_head = 0;
     node->ip_info->enqueued_count = 0;
     node->ip_info->busy = FALSE;
 }
@@ -256,9 +352,6 @@ void ip_node_done(node_t *node)
                 if (route->dst != NULL) {
                     free(route->dst);
                 }
-                if (route->dst_bit_expanded != NULL) {
-                    free(route->dst_bit_expanded);
-                }
                 if (route->further_info != NULL) {
                     free(route->further_info);
                 }
@@ -271,6 +364,20 @@ void ip_node_done(node_t *node)
             free(node->ip_info->route_list);
         }
 
+        route_trie_destroy(node->ip_info->route_trie);
+
+        if (node->ip_info->route_next_hop_index != NULL) {
+            free(node->ip_info->route_next_hop_index);
+        }
+
+        queue_flush(node);
+        ip_send_info_destroy(&node->ip_info->send_info);
+        if (node->ip_info->queue != NULL) {
+            free(node->ip_info->queue);
+        }
+
+        node_map_done(&node->ip_info->neighbor_map);
+
         free(node->ip_info);
         node->ip_info = NULL;
     }
@@ -285,6 +392,9 @@ void ip_node_set_address(node_t *node, const char *address)
         free(node->ip_info->address);
 
     node->ip_info->address = strdup(address);
+    node->ip_info->address_id = addr_intern(address);
+
+    rs_system_nodes_changed();
 }
 
 ip_route_t *ip_node_add_route(node_t *node, char *dst, uint8 prefix_len, node_t *next_hop, uint8 type, void *further_info)
@@ -294,6 +404,11 @@ ip_route_t *ip_node_add_route(node_t *node, char *dst, uint8 prefix_len, node_t
     rs_assert(next_hop != NULL);
     rs_assert(strlen(dst) * 4 >= prefix_len);
 
+    if (prefix_len > ADDR_MAX_BITS) { /* the prefix mask can't cover more than the address bits */
+        rs_error("node '%s': invalid prefix length %d for route '%s', using %d", node->phy_info->name, prefix_len, dst, ADDR_MAX_BITS);
+        prefix_len = ADDR_MAX_BITS;
+    }
+
     rs_debug(DEBUG_IP, "node '%s': adding route '%s/%d' via '%s'",
             node->phy_info->name, dst, prefix_len, next_hop->phy_info->name);
 
@@ -302,11 +417,14 @@ ip_route_t *ip_node_add_route(node_t *node, char *dst, uint8 prefix_len, node_t
     route->dst = strdup(dst);
     route->prefix_len = prefix_len;
     route->next_hop = next_hop;
-    route->dst_bit_expanded = route_expand_to_bits(dst, prefix_len);
     route->type = type;
     route->further_info = further_info;
     route->update_time = rs_system->now;
 
+    route_trie_add(node, route);
+    route_index_add(node, route);
+
+    route->list_index = node->ip_info->route_count;
     node->ip_info->route_list = realloc(node->ip_info->route_list, (node->ip_info->route_count + 1) * sizeof(ip_route_t *));
     node->ip_info->route_list[node->ip_info->route_count++] = route;
 
@@ -316,29 +434,9 @@ ip_route_t *ip_node_add_route(node_t *node, char *dst, uint8 prefix_len, node_t
 void ip_node_rem_route(node_t *node, ip_route_t *route)
 {
     rs_assert(node != NULL);
+    rs_assert(route->list_index < node->ip_info->route_count && node->ip_info->route_list[route->list_index] == route);
 
-    int32 i;
-    for (i = node->ip_info->route_count - 1; i >= 0; i--) { /* going backwards to increase performance a little bit */
-        if (route == node->ip_info->route_list[i]) {
-            rs_debug(DEBUG_IP, "node '%s': removing route '%s/%d' via '%s'",
-                    node->phy_info->name, route->dst, route->prefix_len, route->next_hop->phy_info->name);
-
-            free(route->dst);
-            if (route->further_info != NULL) {
-                free(route->further_info);
-            }
-            free(route);
-
-            uint16 j;
-            for (j = i; j < node->ip_info->route_count - 1; j++) {
-                node->ip_info->route_list[j] = node->ip_info->route_list[j + 1];
-            }
-
-            node->ip_info->route_count--;
-
-            break;
-        }
-    }
+    route_unlink(node, route);
 
     node->ip_info->route_list = realloc(node->ip_info->route_list, node->ip_info->route_count * sizeof(ip_route_t *));
     if (node->ip_info->route_count == 0) {
@@ -350,41 +448,16 @@ void ip_node_rem_routes(node_t *node, char *dst, int8 prefix_len, node_t *next_h
 {
     rs_assert(node != NULL);
 
-    int32 i;
-    for (i = node->ip_info->route_count - 1; i >= 0; i--) { /* going backwards to increase performance a little bit */
-        ip_route_t *route = node->ip_info->route_list[i];
-
-        if (dst != NULL && (strcmp(route->dst, dst) != 0)) {
-            continue;
-        }
-
-        if (prefix_len >= 0 && (route->prefix_len != prefix_len)) {
-            continue;
-        }
-
-        if (next_hop != NULL && (route->next_hop != next_hop)) {
-            continue;
-        }
-
-        if (type >= 0 && (route->type != type)) {
-            continue;
-        }
-
-        rs_debug(DEBUG_IP, "node '%s': removing route '%s/%d' via '%s'",
-                node->phy_info->name, route->dst, route->prefix_len, route->next_hop->phy_info->name);
-
-        free(route->dst);
-        if (route->further_info != NULL) {
-            free(route->further_info);
-        }
-        free(route);
+    uint8 via;
+    ip_route_t *route = route_first_candidate(node, next_hop, type, &via);
+    while (route != NULL) {
+        ip_route_t *next_route = route_next_candidate(node, route, via);
 
-        uint16 j;
-        for (j = i; j < node->ip_info->route_count - 1; j++) {
-            node->ip_info->route_list[j] = node->ip_info->route_list[j + 1];
+        if (route_matches(route, dst, prefix_len, next_hop, type)) {
+            route_unlink(node, route);
         }
 
-        node->ip_info->route_count--;
+        route = next_route;
     }
 
     node->ip_info->route_list = realloc(node->ip_info->route_list, node->ip_info->route_count * sizeof(ip_route_t *));
@@ -400,23 +473,10 @@ ip_route_t **ip_node_get_routes(node_t *node, uint16 *route_count, char *dst, in
     ip_route_t **route_list = NULL;
     *route_count = 0;
 
-    uint16 i;
-    for (i = 0; i < node->ip_info->route_count; i++) {
-        ip_route_t *route = node->ip_info->route_list[i];
-
-        if (dst != NULL && (strcmp(route->dst, dst) != 0)) {
-            continue;
-        }
-
-        if (prefix_len >= 0 && (route->prefix_len != prefix_len)) {
-            continue;
-        }
-
-        if (next_hop != NULL && (route->next_hop != next_hop)) {
-            continue;
-        }
-
-        if (type >= 0 && (route->type != type)) {
+    uint8 via;
+    ip_route_t *route;
+    for (route = route_first_candidate(node, next_hop, type, &via); route != NULL; route = route_next_candidate(node, route, via)) {
+        if (!route_matches(route, dst, prefix_len, next_hop, type)) {
             continue;
         }
 
@@ -427,60 +487,65 @@ ip_route_t **ip_node_get_routes(node_t *node, uint16 *route_count, char *dst, in
     return route_list;
 }
 
-ip_route_t *ip_node_get_next_hop_route(node_t *node, char *dst_address)
+ip_route_t *ip_node_get_next_hop_route(node_t *node, address_t dst_address)
 {
     rs_assert(node != NULL);
-    rs_assert(dst_address != NULL);
 
-    if (strcmp(node->ip_info->address, dst_address) == 0) { /* sending to the node itself? */
+    if (node->ip_info->address_id == dst_address) { /* sending to the node itself? */
         return NULL;
     }
 
-    uint16 i, j;
-    int16 best_prefix_len = -1;
-    int16 best_type = 255;  /* a big number */
-    ip_route_t *best_route = NULL;
-
-    uint8 dst_len = strlen(dst_address) * 4;
-    uint8 *dst_bits_expanded = route_expand_to_bits(dst_address, dst_len);
+    uint8 dst_len;
+    uint64 dst_bits = addr_to_bits(dst_address, &dst_len);
 
-    for (i = 0; i < node->ip_info->route_count; i++) {
-        ip_route_t *route = node->ip_info->route_list[i];
+    ip_route_t *best_route = NULL;
+    ip_route_trie_t *trie = node->ip_info->route_trie;
 
-        if (route->type > best_type) { /* prefer the smallest type */
-            continue;
+    /* every matching prefix lies on the path to the destination, shortest first */
+    while (trie != NULL && trie->len <= dst_len) {
+        if ((trie->key ^ dst_bits) & route_prefix_mask(trie->len)) {
+            break;
         }
-        else if (route->type == best_type) {
-            if (route->prefix_len <= best_prefix_len) { /* prefer the longest prefix */
-                continue;
+
+        ip_route_t *route;
+        for (route = trie->route_first; route != NULL; route = route->trie_next) {
+            if (best_route == NULL || route->type < best_route->type) { /* prefer the smallest type */
+                best_route = route;
+            }
+            else if (route->type == best_route->type && route->prefix_len > best_route->prefix_len) { /* prefer the longest prefix */
+                best_route = route;
             }
         }
 
-        if (dst_len < route->prefix_len) {
-            rs_warn("node '%s': invalid IP address '%s' for route '%s/%d'", node->phy_info->name, dst_address, route->dst, route->prefix_len);
-            continue;
+        if (trie->len == ADDR_MAX_BITS) {
+            break;
         }
 
-        if (route->dst_bit_expanded == NULL) {
-            route->dst_bit_expanded = route_expand_to_bits(route->dst, route->prefix_len);
-        }
+        trie = trie->child[route_bit_at(dst_bits, trie->len)];
+    }
 
-        bool match = TRUE;
-        for (j = 0; j < route->prefix_len; j++) {
-            if (route->dst_bit_expanded[j] != dst_bits_expanded[j]) {
-                match = FALSE;
-                break;
-            }
-        }
+    return best_route;
+}
 
-        if (match) {
-            best_route = route;
-            best_prefix_len = route->prefix_len;
-            best_type = route->type;
-        }
+void ip_node_reindex_routes(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    route_trie_destroy(node->ip_info->route_trie);
+    node->ip_info->route_trie = NULL;
+
+    memset(node->ip_info->route_type_index, 0, sizeof(node->ip_info->route_type_index));
+    if (node->ip_info->route_next_hop_index != NULL) {
+        free(node->ip_info->route_next_hop_index);
     }
+    node->ip_info->route_next_hop_index = NULL;
+    node->ip_info->route_next_hop_index_count = 0;
 
-    return best_route;
+    uint16 i;
+    for (i = 0; i < node->ip_info->route_count; i++) {
+        route_trie_add(node, node->ip_info->route_list[i]);
+        route_index_add(node, node->ip_info->route_list[i]);
+    }
 }
 
 ip_neighbor_t *ip_node_add_neighbor(node_t *node, node_t *neighbor_node)
@@ -497,6 +562,10 @@ ip_neighbor_t *ip_node_add_neighbor(node_t *node, node_t *neighbor_node)
     node->ip_info->neighbor_list = realloc(node->ip_info->neighbor_list, (node->ip_info->neighbor_count + 1) * sizeof(ip_neighbor_t *));
     node->ip_info->neighbor_list[node->ip_info->neighbor_count] = neighbor;
     node->ip_info->neighbor_count++;
+    node_map_put(&node->ip_info->neighbor_map, neighbor_node, neighbor);
+
+    neighbor_expiry_insert(node, neighbor, rs_system->now + rs_system->ip_neighbor_timeout);
+    neighbor_expiry_schedule(node);
 
     /* install a route to this neighbor */
     ip_node_add_route(node, neighbor_node->ip_info->address, strlen(neighbor_node->ip_info->address) * 4,
@@ -537,8 +606,12 @@ bool ip_node_rem_neighbor(node_t *node, ip_neighbor_t *neighbor)
         node->ip_info->neighbor_list = NULL;
     }
 
+    /* a sweep left without expiring neighbors just finds nothing to do */
+    neighbor_expiry_unlink(node, neighbor);
+
     /* remove the route to this neighbor */
     if (neighbor->node != NULL) {
+        node_map_remove(&node->ip_info->neighbor_map, neighbor->node);
         ip_node_rem_routes(node, neighbor->node->ip_info->address, strlen(neighbor->node->ip_info->address) * 4, neighbor->node, IP_ROUTE_TYPE_CONNECTED);
     }
 
@@ -552,21 +625,14 @@ ip_neighbor_t* ip_node_find_neighbor_by_node(node_t *node, node_t *neighbor_node
     rs_assert(node != NULL);
     rs_assert(neighbor_node != NULL);
 
-    uint16 i;
-    for (i = 0; i < node->ip_info->neighbor_count; i++) {
-        if (node->ip_info->neighbor_list[i]->node == neighbor_node) {
-            return node->ip_info->neighbor_list[i];
-        }
-    }
-
-    return NULL;
+    return node_map_get(&node->ip_info->neighbor_map, neighbor_node);
 }
 
-bool ip_node_send(node_t *node, char *dst_ip_address, uint16 next_header, void *sdu)
+bool ip_node_send(node_t *node, address_t dst_address, uint16 next_header, void *sdu)
 {
     rs_assert(node != NULL);
 
-    ip_pdu_t *ip_pdu = ip_pdu_create(node->ip_info->address, dst_ip_address != NULL ? dst_ip_address : "");
+    ip_pdu_t *ip_pdu = ip_pdu_create(node->ip_info->address_id, dst_address);
     ip_pdu_set_sdu(ip_pdu, next_header, sdu);
 
     if (!event_execute(ip_event_pdu_send, node, NULL, ip_pdu)) {
@@ -585,8 +651,7 @@ bool ip_node_forward(node_t *node, node_t *incoming_node, ip_pdu_t *pdu) {
     rs_assert(node != NULL);
     rs_assert(pdu != NULL);
 
-    pdu = ip_pdu_duplicate(pdu);
-
+    /* the received pdu itself moves on, the send path now owns it */
     if (!event_execute(ip_event_pdu_send, node, incoming_node, pdu)) {
         ip_pdu_destroy(pdu);
 
@@ -603,11 +668,8 @@ bool ip_node_receive(node_t *node, node_t *incoming_node, ip_pdu_t *pdu)
     rs_assert(node != NULL);
     rs_assert(pdu != NULL);
 
-    bool all_ok = event_execute(ip_event_pdu_receive, node, incoming_node, pdu);
-
-    ip_pdu_destroy(pdu);
-
-    return all_ok;
+    /* the receive handler disposes of the pdu, by delivering or by forwarding it */
+    return event_execute(ip_event_pdu_receive, node, incoming_node, pdu);
 }
 
 
@@ -627,8 +689,10 @@ static bool event_handler_node_kill(node_t *node)
         ip_node_rem_neighbor(node, neighbor);
     }
 
-    node->ip_info->enqueued_count = 0;
+    queue_flush(node);
+    ip_send_info_destroy(&node->ip_info->send_info); /* its timeout check is canceled along with the other events */
     node->ip_info->busy = FALSE;
+    node->ip_info->expiry_sweep_pending = FALSE;
 
     ip_node_rem_routes(node, NULL, -1, NULL, IP_ROUTE_TYPE_CONNECTED);
     ip_node_rem_routes(node, NULL, -1, NULL, IP_ROUTE_TYPE_RPL_DAO);
@@ -640,14 +704,8 @@ static bool event_handler_node_kill(node_t *node)
 static bool event_handler_pdu_send(node_t *node, node_t *incoming_node, ip_pdu_t *pdu)
 {
     if (node->ip_info->busy) { /* IP layer busy */
-        if (node->ip_info->enqueued_count < rs_system->ip_queue_size) { /* still enough room in IP queue */
-            rs_debug(DEBUG_IP, "node '%s': IP layer is busy (%d), retrying later", node->phy_info->name, node->ip_info->enqueued_count);
-            rs_system_schedule_event(node, ip_event_pdu_send, incoming_node, pdu, rs_system->ip_pdu_timeout);
-
-            if (!pdu->queued) { /* "add" the packet to "queue" only once */
-                node->ip_info->enqueued_count++;
-                pdu->queued = TRUE;
-            }
+        if (queue_push(node, incoming_node, pdu)) { /* still enough room in IP queue */
+            rs_debug(DEBUG_IP, "node '%s': IP layer is busy (%d), packet queued", node->phy_info->name, node->ip_info->enqueued_count);
 
             return TRUE;
         }
@@ -665,9 +723,7 @@ static bool event_handler_pdu_send(node_t *node, node_t *incoming_node, ip_pdu_t
         }
     }
     else { /* IP layer idle */
-        pdu->queued = FALSE;
-
-        if (strlen(pdu->dst_address) == 0) { /* broadcast */
+        if (pdu->dst_address == ADDR_BROADCAST) {
             if (mac_node_send(node, NULL, MAC_TYPE_IP, pdu)) {
                 rs_system_schedule_event(node, ip_event_pdu_send_timeout_check, NULL, pdu, rs_system->ip_pdu_timeout);
                 node->ip_info->busy = TRUE;
@@ -679,12 +735,20 @@ static bool event_handler_pdu_send(node_t *node, node_t *incoming_node, ip_pdu_t
             return TRUE;
         }
         else { /* unicast, must route the packet */
-            ip_route_t *route = ip_node_get_next_hop_route(node, pdu->dst_address);
+            rpl_node_set_source_route(node, pdu);
+
+            /* a source routed packet heads for the next listed hop first */
+            address_t route_dst = pdu->dst_address;
+            if (pdu->source_route_index < pdu->source_route_count) {
+                route_dst = pdu->source_route[pdu->source_route_index];
+            }
+
+            ip_route_t *route = ip_node_get_next_hop_route(node, route_dst);
 
             node_t *next_hop = NULL;
 
             if (route == NULL) {
-                rs_debug(DEBUG_IP, "node '%s': destination '%s' not reachable, querying RPL for next hops", node->phy_info->name, pdu->dst_address);
+                rs_debug(DEBUG_IP, "node '%s': destination '%s' not reachable, querying RPL for next hops", node->phy_info->name, addr_to_string(pdu->dst_address));
             }
             else {
                 next_hop = route->next_hop;
@@ -695,28 +759,24 @@ static bool event_handler_pdu_send(node_t *node, node_t *incoming_node, ip_pdu_t
                 return mac_node_send(node, redir_next_hop, MAC_TYPE_IP, pdu);
             }
 
-            uint16 next_hop_count;
-            node_t **next_hop_list = rpl_node_get_next_hop_list(node, &next_hop_count);
-
-            ip_send_info_t *ip_send_info = ip_send_info_create(incoming_node, next_hop, next_hop_list, next_hop_count);
-
-            if (next_hop_list != NULL) {
-                free(next_hop_list);
-            }
+            ip_send_info_t *ip_send_info = ip_send_info_create(node, incoming_node, next_hop);
 
             if (ip_send_info->next_hop_count > 0) {
-                if (mac_node_send(node, ip_send_info->next_hop_list[0], MAC_TYPE_IP, pdu)) {
+                if (mac_node_send(node, ip_send_info_get_next_hop(ip_send_info, 0), MAC_TYPE_IP, pdu)) {
                     rs_system_schedule_event(node, ip_event_pdu_send_timeout_check, ip_send_info, pdu, rs_system->ip_pdu_timeout);
                     node->ip_info->busy = TRUE;
                 }
                 else {
                     rs_error("node '%s': MAC layer should never be busy, please increase IP PDU timeout", node->phy_info->name);
+                    ip_send_info_destroy(ip_send_info);
                 }
 
                 return TRUE;
             }
             else {
-                rs_debug(DEBUG_IP, "node '%s': destination '%s' not reachable at all", node->phy_info->name, pdu->dst_address);
+                ip_send_info_destroy(ip_send_info);
+
+                rs_debug(DEBUG_IP, "node '%s': destination '%s' not reachable at all", node->phy_info->name, addr_to_string(pdu->dst_address));
 
                 if (pdu->next_header == IP_NEXT_HEADER_MEASURE) {
                     measure_pdu_t *measure_pdu = pdu->sdu;
@@ -733,15 +793,24 @@ static bool event_handler_pdu_send(node_t *node, node_t *incoming_node, ip_pdu_t
 
 static bool event_handler_pdu_send_timeout_check(node_t *node, ip_send_info_t *ip_send_info, ip_pdu_t *pdu)
 {
+    if (rs_system->mac_csma && node->mac_info->busy) { /* the MAC layer is still backing off or retrying */
+        rs_system_schedule_event(node, ip_event_pdu_send_timeout_check, ip_send_info, pdu, rs_system->mac_pdu_timeout);
+
+        return TRUE;
+    }
+
     if (node->mac_info->error) {
         if (ip_send_info != NULL) { /* unicast */
+            node_t *failed_hop = ip_send_info_get_next_hop(ip_send_info, ip_send_info->next_hop_index);
+            send_info_refresh(node, ip_send_info, failed_hop);
+
             if (ip_send_info->next_hop_index < ip_send_info->next_hop_count - 1) { /* still some next_hops to try */
                 rs_debug(DEBUG_IP, "node '%s': hop '%s' failed, trying hop '%s'",
                         node->phy_info->name,
-                        ip_send_info->next_hop_list[ip_send_info->next_hop_index]->phy_info->name,
-                        ip_send_info->next_hop_list[ip_send_info->next_hop_index + 1]->phy_info->name);
+                        failed_hop->phy_info->name,
+                        ip_send_info_get_next_hop(ip_send_info, ip_send_info->next_hop_index + 1)->phy_info->name);
 
-                if (mac_node_send(node, ip_send_info->next_hop_list[++ip_send_info->next_hop_index], MAC_TYPE_IP, pdu)) {
+                if (mac_node_send(node, ip_send_info_get_next_hop(ip_send_info, ++ip_send_info->next_hop_index), MAC_TYPE_IP, pdu)) {
                     rs_system_schedule_event(node, ip_event_pdu_send_timeout_check, ip_send_info, pdu, rs_system->ip_pdu_timeout);
                 }
                 else {
@@ -754,7 +823,7 @@ static bool event_handler_pdu_send_timeout_check(node_t *node, ip_send_info_t *i
                 rs_debug(DEBUG_RPL, "node '%s': a forwarding failure occurred, with src = '%s' and dst = '%s'",
                         node->phy_info->name,
                         ip_send_info->incoming_node != NULL ? ip_send_info->incoming_node->phy_info->name : "<<local>>",
-                        pdu->src_address, pdu->dst_address);
+                        addr_to_string(pdu->src_address), addr_to_string(pdu->dst_address));
 
                 event_execute(rpl_event_forward_failure, node, ip_send_info->incoming_node, pdu);
 
@@ -769,9 +838,7 @@ static bool event_handler_pdu_send_timeout_check(node_t *node, ip_send_info_t *i
                 ip_send_info_destroy(ip_send_info);
 
                 node->ip_info->busy = FALSE;
-                if (node->ip_info->enqueued_count > 0) {
-                    node->ip_info->enqueued_count--;
-                }
+                queue_drain(node);
             }
         }
         else { /* broadcast */
@@ -780,20 +847,19 @@ static bool event_handler_pdu_send_timeout_check(node_t *node, ip_send_info_t *i
             ip_pdu_destroy(pdu);
 
             node->ip_info->busy = FALSE;
-            if (node->ip_info->enqueued_count > 0) {
-                node->ip_info->enqueued_count--;
-            }
+            queue_drain(node);
         }
     }
     else { /* at least one node received the message */
         if (ip_send_info != NULL) {
             ip_send_info_destroy(ip_send_info);
         }
+        else { /* the broadcast receivers got copies, the original stayed here */
+            ip_pdu_destroy(pdu);
+        }
 
         node->ip_info->busy = FALSE;
-        if (node->ip_info->enqueued_count > 0) {
-            node->ip_info->enqueued_count--;
-        }
+        queue_drain(node);
     }
 
     return TRUE;
@@ -809,24 +875,36 @@ static bool event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pd
     else {
         neighbor = ip_node_add_neighbor(node, incoming_node);
         event_execute(rpl_event_neighbor_attach, node, incoming_node, NULL);
-
-        rs_system_schedule_event(node, ip_event_neighbor_cache_timeout_check, neighbor, NULL, rs_system->ip_neighbor_timeout);
     }
 
     rs_debug(DEBUG_IP, "node '%s': received packet from '%s', with src = '%s' and dst = '%s'",
             node->phy_info->name, incoming_node != NULL ? incoming_node->phy_info->name : "<<unknown>>",
-            pdu->src_address, pdu->dst_address);
+            addr_to_string(pdu->src_address), addr_to_string(pdu->dst_address));
 
-    if (!rpl_node_process_incoming_flow_label(node, incoming_node, pdu)) { /* drop the packet if RPL says so */
+    uint8 verdict = rpl_node_process_incoming_flow_label(node, incoming_node, pdu);
+    if (verdict == RPL_FLOW_LABEL_DROP) { /* drop the packet if RPL says so */
         rs_debug(DEBUG_IP, "node '%s': dropped packet from '%s', with src = '%s' and dst = '%s'",
                 node->phy_info->name, incoming_node != NULL ? incoming_node->phy_info->name : "<<unknown>>",
-                pdu->src_address, pdu->dst_address);
+                addr_to_string(pdu->src_address), addr_to_string(pdu->dst_address));
+
+        ip_pdu_destroy(pdu);
+
+        return TRUE;
+    }
+    else if (verdict == RPL_FLOW_LABEL_REROUTE) {
+        ip_node_forward(node, incoming_node, pdu);
 
         return TRUE;
     }
 
+    /* we are the next hop listed in the source route header */
+    if (pdu->source_route_index < pdu->source_route_count &&
+            pdu->source_route[pdu->source_route_index] == node->ip_info->address_id) {
+        pdu->source_route_index++;
+    }
+
     /* if the packet is not intended for us, neither broadcasted, we forward it */
-    if (strcmp(node->ip_info->address, pdu->dst_address) != 0 && (strlen(pdu->dst_address) > 0)) {
+    if (pdu->dst_address != node->ip_info->address_id && pdu->dst_address != ADDR_BROADCAST) {
         /* give a special treatment to measure messages */
         if (pdu->next_header == IP_NEXT_HEADER_MEASURE) {
             measure_pdu_t *measure_pdu = pdu->sdu;
@@ -838,6 +916,8 @@ static bool event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pd
                     strcmp(measure_pdu->dst_node->rpl_info->root_info->dodag_id, node->rpl_info->root_info->dodag_id) == 0) {
 
                 pdu->sdu = NULL;
+                ip_pdu_destroy(pdu);
+
                 return measure_node_receive(node, incoming_node, measure_pdu);
             }
             else {
@@ -875,54 +955,420 @@ static bool event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pd
                 break;
             }
 
+            case IP_NEXT_HEADER_TRAFFIC: {
+                if (!traffic_node_receive(node, incoming_node, pdu)) { /* the IP pdu is passed as is, like for ICMP */
+                    all_ok = FALSE;
+                }
+                pdu->sdu = NULL;
+
+                break;
+            }
+
             default:
                 rs_error("node '%s': unknown IP next header '0x%04X'", node->phy_info->name, pdu->next_header);
                 all_ok = FALSE;
         }
 
+        ip_pdu_destroy(pdu);
+
         return all_ok;
     }
 }
 
-static bool event_handler_neighbor_cache_timeout(node_t *node, ip_neighbor_t *neighbor)
+static bool event_handler_neighbor_cache_timeout(node_t *node)
 {
-    if (neighbor->node == NULL || !phy_node_has_neighbor(neighbor->node, node)) {
-        event_execute(rpl_event_neighbor_detach, node, neighbor->node, NULL);
+    node->ip_info->expiry_sweep_pending = FALSE;
 
-        if (!ip_node_rem_neighbor(node, neighbor)) {
-            if (neighbor->node != NULL)
-                rs_error("node '%s': no longer has neighbor '%s'", node->phy_info->name, neighbor->node->phy_info->name);
+    /* only the neighbors due now are checked, those rearmed below can't come around again in this sweep */
+    uint16 count = node->ip_info->neighbor_count;
+    while (count-- > 0 && node->ip_info->expiry_first != NULL && node->ip_info->expiry_first->expiry_time <= rs_system->now) {
+        ip_neighbor_t *neighbor = node->ip_info->expiry_first;
 
-            return FALSE; /* this should never happen */
+        if (neighbor->node == NULL || !phy_node_has_neighbor(neighbor->node, node)) {
+            event_execute(rpl_event_neighbor_detach, node, neighbor->node, NULL);
+
+            if (!ip_node_rem_neighbor(node, neighbor)) {
+                if (neighbor->node != NULL)
+                    rs_error("node '%s': no longer has neighbor '%s'", node->phy_info->name, neighbor->node->phy_info->name);
+
+                return FALSE; /* this should never happen */
+            }
+        }
+        else {
+            neighbor_expiry_unlink(node, neighbor);
+            neighbor_expiry_insert(node, neighbor, rs_system->now + rs_system->ip_neighbor_timeout);
         }
     }
-    else {
-        if (neighbor->node != NULL) {
-            rs_system_schedule_event(node, ip_event_neighbor_cache_timeout_check, neighbor, NULL, rs_system->ip_neighbor_timeout);
+
+    neighbor_expiry_schedule(node);
+
+    return TRUE;
+}
+
+static bool queue_push(node_t *node, node_t *incoming_node, ip_pdu_t *pdu)
+{
+    ip_node_info_t *ip_info = node->ip_info;
+
+    if (ip_info->enqueued_count >= rs_system->ip_queue_size) {
+        return FALSE;
+    }
+
+    if (ip_info->enqueued_count == ip_info->queue_size) { /* the queue size setting has grown */
+        ip_queued_pdu_t *queue = malloc(rs_system->ip_queue_size * sizeof(ip_queued_pdu_t));
+
+        uint32 i;
+        for (i = 0; i < ip_info->enqueued_count; i++) {
+            queue[i] = ip_info->queue[(ip_info->queue_head + i) % ip_info->queue_size];
         }
+
+        if (ip_info->queue != NULL) {
+            free(ip_info->queue);
+        }
+
+        ip_info->queue = queue;
+        ip_info->queue_size = rs_system->ip_queue_size;
+        ip_info->queue_head = 0;
+    }
+
+    ip_queued_pdu_t *entry = &ip_info->queue[(ip_info->queue_head + ip_info->enqueued_count) % ip_info->queue_size];
+    entry->pdu = pdu;
+    entry->incoming_node = incoming_node;
+    entry->enqueue_time = rs_system->now;
+
+    ip_info->enqueued_count++;
+
+    return TRUE;
+}
+
+static void queue_drain(node_t *node)
+{
+    ip_node_info_t *ip_info = node->ip_info;
+
+    /* a packet may fail right away (e.g. unreachable), in which case the next one gets its chance */
+    while (!ip_info->busy && ip_info->enqueued_count > 0) {
+        ip_queued_pdu_t entry = ip_info->queue[ip_info->queue_head];
+
+        ip_info->queue_head = (ip_info->queue_head + 1) % ip_info->queue_size;
+        ip_info->enqueued_count--;
+
+        rs_debug(DEBUG_IP, "node '%s': dequeued packet after %d ms, %d left", node->phy_info->name, rs_system->now - entry.enqueue_time, ip_info->enqueued_count);
+        measure_node_add_ip_queue_delay(node, rs_system->now - entry.enqueue_time);
+
+        if (!event_execute(ip_event_pdu_send, node, entry.incoming_node, entry.pdu)) {
+            ip_pdu_destroy(entry.pdu);
+        }
+    }
+}
+
+static void queue_flush(node_t *node)
+{
+    ip_node_info_t *ip_info = node->ip_info;
+
+    while (ip_info->enqueued_count > 0) {
+        ip_pdu_destroy(ip_info->queue[ip_info->queue_head].pdu);
+
+        ip_info->queue_head = (ip_info->queue_head + 1) % ip_info->queue_size;
+        ip_info->enqueued_count--;
+    }
+}
+
+static void send_info_refresh(node_t *node, ip_send_info_t *ip_send_info, node_t *failed_hop)
+{
+    rpl_next_hop_list_t *next_hop_list = ip_send_info->rpl_next_hop_list;
+    if (next_hop_list == NULL || rpl_next_hop_list_is_current(node, next_hop_list)) {
+        return;
+    }
+
+    /* the parents or siblings changed while sending, the remaining hops of the old snapshot may be gone */
+    rs_debug(DEBUG_IP, "node '%s': next hops changed during the send, switching to the current ones", node->phy_info->name);
+
+    rpl_next_hop_list_release(next_hop_list);
+
+    next_hop_list = rpl_node_get_next_hop_list(node);
+    if (next_hop_list != NULL) {
+        rpl_next_hop_list_hold(next_hop_list);
+    }
+
+    ip_send_info->first_next_hop = NULL; /* the routed hop always goes first, so it was already tried */
+    ip_send_info->rpl_next_hop_list = next_hop_list;
+    ip_send_info->next_hop_count = next_hop_list != NULL ? next_hop_list->node_count : 0;
+
+    /* start over at the head, past the hop that just failed if it still leads */
+    if (ip_send_info->next_hop_count > 0 && next_hop_list->node_list[0] == failed_hop) {
+        ip_send_info->next_hop_index = 0;
+    }
+    else {
+        ip_send_info->next_hop_index = -1;
+    }
+}
+
+static void route_unlink(node_t *node, ip_route_t *route)
+{
+    rs_debug(DEBUG_IP, "node '%s': removing route '%s/%d' via '%s'",
+            node->phy_info->name, route->dst, route->prefix_len, route->next_hop->phy_info->name);
+
+    route_trie_rem(node, route);
+    route_index_rem(node, route);
+
+    /* the last route fills the gap, the list order is not significant */
+    ip_route_t *last_route = node->ip_info->route_list[--node->ip_info->route_count];
+    node->ip_info->route_list[route->list_index] = last_route;
+    last_route->list_index = route->list_index;
+
+    free(route->dst);
+    if (route->further_info != NULL) {
+        free(route->further_info);
+    }
+    free(route);
+}
+
+static bool route_matches(ip_route_t *route, char *dst, int8 prefix_len, node_t *next_hop, int8 type)
+{
+    if (dst != NULL && (strcmp(route->dst, dst) != 0)) {
+        return FALSE;
+    }
+
+    if (prefix_len >= 0 && (route->prefix_len != prefix_len)) {
+        return FALSE;
+    }
+
+    if (next_hop != NULL && (route->next_hop != next_hop)) {
+        return FALSE;
+    }
+
+    if (type >= 0 && (route->type != type)) {
+        return FALSE;
     }
 
     return TRUE;
 }
 
-static uint8 *route_expand_to_bits(char *dst, uint8 prefix_len)
+static ip_route_t *route_first_candidate(node_t *node, node_t *next_hop, int8 type, uint8 *via)
+{
+    /* walk the narrowest index the criteria allow */
+    if (next_hop != NULL) {
+        *via = ROUTE_VIA_NEXT_HOP;
+        ip_route_index_t *index = route_next_hop_index_find(node, next_hop);
+
+        return index != NULL ? index->first : NULL;
+    }
+    else if (type >= 0 && type < IP_ROUTE_TYPE_COUNT) {
+        *via = ROUTE_VIA_TYPE;
+
+        return node->ip_info->route_type_index[type].first;
+    }
+    else {
+        /* backwards, so that unlinking the current route never moves an unvisited one */
+        *via = ROUTE_VIA_LIST;
+
+        return node->ip_info->route_count > 0 ? node->ip_info->route_list[node->ip_info->route_count - 1] : NULL;
+    }
+}
+
+static ip_route_t *route_next_candidate(node_t *node, ip_route_t *route, uint8 via)
 {
-    /* expand the destination hex digits to bits, for the sake of performance */
-    uint8* dst_bit_expanded = malloc(prefix_len);
+    switch (via) {
+        case ROUTE_VIA_NEXT_HOP :
+            return route->next_hop_next;
+
+        case ROUTE_VIA_TYPE :
+            return route->type_next;
+
+        default:
+            return route->list_index > 0 ? node->ip_info->route_list[route->list_index - 1] : NULL;
+    }
+}
+
+static void route_index_add(node_t *node, ip_route_t *route)
+{
+    if (route->type < IP_ROUTE_TYPE_COUNT) {
+        route_chain_append(&node->ip_info->route_type_index[route->type], route, type_prev, type_next);
+    }
+    else {
+        route->type_prev = route->type_next = NULL;
+    }
+
+    ip_route_index_t *index = route_next_hop_index_find(node, route->next_hop);
+    if (index == NULL) {
+        node->ip_info->route_next_hop_index = realloc(node->ip_info->route_next_hop_index,
+                (node->ip_info->route_next_hop_index_count + 1) * sizeof(ip_route_index_t));
+
+        index = &node->ip_info->route_next_hop_index[node->ip_info->route_next_hop_index_count++];
+        index->next_hop = route->next_hop;
+        index->first = NULL;
+        index->last = NULL;
+    }
+
+    route_chain_append(index, route, next_hop_prev, next_hop_next);
+}
+
+static void route_index_rem(node_t *node, ip_route_t *route)
+{
+    if (route->type < IP_ROUTE_TYPE_COUNT) {
+        route_chain_unlink(&node->ip_info->route_type_index[route->type], route, type_prev, type_next);
+    }
+
+    ip_route_index_t *index = route_next_hop_index_find(node, route->next_hop);
+    rs_assert(index != NULL);
+
+    route_chain_unlink(index, route, next_hop_prev, next_hop_next);
+
+    if (index->first == NULL) { /* no more routes via this next hop */
+        *index = node->ip_info->route_next_hop_index[--node->ip_info->route_next_hop_index_count];
+
+        if (node->ip_info->route_next_hop_index_count == 0) {
+            free(node->ip_info->route_next_hop_index);
+            node->ip_info->route_next_hop_index = NULL;
+        }
+    }
+}
 
+static ip_route_index_t *route_next_hop_index_find(node_t *node, node_t *next_hop)
+{
+    /* there are only as many entries as distinct next hops, i.e. neighbors */
     uint16 i;
-    for (i = 0; i < prefix_len; i++) {
-        char c = dst[i / 4];
+    for (i = 0; i < node->ip_info->route_next_hop_index_count; i++) {
+        if (node->ip_info->route_next_hop_index[i].next_hop == next_hop) {
+            return &node->ip_info->route_next_hop_index[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void route_trie_add(node_t *node, ip_route_t *route)
+{
+    uint8 dst_len;
+    route->dst_id = addr_intern(route->dst);
+    route->dst_bits = addr_to_bits(route->dst_id, &dst_len) & route_prefix_mask(route->prefix_len);
+    route->trie_node = route_trie_insert(&node->ip_info->route_trie, route->dst_bits, route->prefix_len);
+    route->trie_next = NULL;
+
+    /* keep the insertion order, the first route wins among equals */
+    ip_route_t **link = &route->trie_node->route_first;
+    while (*link != NULL) {
+        link = &(*link)->trie_next;
+    }
+    *link = route;
+}
+
+static void route_trie_rem(node_t *node, ip_route_t *route)
+{
+    ip_route_trie_t *trie = route->trie_node;
+    rs_assert(trie != NULL);
+
+    ip_route_t **link = &trie->route_first;
+    while (*link != route) {
+        link = &(*link)->trie_next;
+    }
+    *link = route->trie_next;
+
+    route->trie_node = NULL;
+    route->trie_next = NULL;
+
+    route_trie_prune(&node->ip_info->route_trie, trie);
+}
+
+static ip_route_trie_t *route_trie_create(uint64 key, uint8 len, ip_route_trie_t *parent)
+{
+    ip_route_trie_t *trie = malloc(sizeof(ip_route_trie_t));
+
+    trie->key = key;
+    trie->len = len;
+    trie->route_first = NULL;
+    trie->parent = parent;
+    trie->child[0] = NULL;
+    trie->child[1] = NULL;
+
+    return trie;
+}
+
+static ip_route_trie_t *route_trie_insert(ip_route_trie_t **root, uint64 key, uint8 len)
+{
+    ip_route_trie_t **link = root;
+    ip_route_trie_t *parent = NULL;
+
+    while (*link != NULL) {
+        ip_route_trie_t *trie = *link;
+
+        uint8 min_len = trie->len < len ? trie->len : len;
+        uint64 diff = (trie->key ^ key) & route_prefix_mask(min_len);
+        uint8 common_len = diff != 0 ? __builtin_clzll(diff) : min_len;
+
+        if (common_len == trie->len) {
+            if (len == trie->len) { /* exact prefix already present */
+                return trie;
+            }
+
+            parent = trie;
+            link = &trie->child[route_bit_at(key, trie->len)];
+
+            continue;
+        }
 
-        if (isdigit(c)) {
-            dst_bit_expanded[i] = (((c - '0') & (8u >> (i % 4))) != 0);
+        ip_route_trie_t *new_trie;
+        if (common_len == len) { /* the new prefix goes right above the existing node */
+            new_trie = route_trie_create(key, len, parent);
+            new_trie->child[route_bit_at(trie->key, len)] = trie;
+            trie->parent = new_trie;
+            *link = new_trie;
+        }
+        else { /* the prefixes diverge, a branching node is needed */
+            ip_route_trie_t *branch = route_trie_create(key & route_prefix_mask(common_len), common_len, parent);
+            new_trie = route_trie_create(key, len, branch);
+
+            branch->child[route_bit_at(key, common_len)] = new_trie;
+            branch->child[route_bit_at(trie->key, common_len)] = trie;
+            trie->parent = branch;
+            *link = branch;
+        }
+
+        return new_trie;
+    }
+
+    *link = route_trie_create(key, len, parent);
+
+    return *link;
+}
+
+static void route_trie_prune(ip_route_trie_t **root, ip_route_trie_t *trie)
+{
+    /* drop the nodes left without routes, unless they still branch */
+    while (trie != NULL && trie->route_first == NULL && (trie->child[0] == NULL || trie->child[1] == NULL)) {
+        ip_route_trie_t *child = trie->child[0] != NULL ? trie->child[0] : trie->child[1];
+        ip_route_trie_t *parent = trie->parent;
+
+        if (parent == NULL) {
+            *root = child;
         }
         else {
-            dst_bit_expanded[i] = (((c - 'A' + 10) & (8u >> (i % 4))) != 0);
+            parent->child[parent->child[1] == trie] = child;
+        }
+
+        if (child != NULL) {
+            child->parent = parent;
         }
+
+        free(trie);
+
+        if (child != NULL) { /* the parent keeps the same number of children */
+            break;
+        }
+
+        trie = parent;
+    }
+}
+
+static void route_trie_destroy(ip_route_trie_t *trie)
+{
+    if (trie == NULL) {
+        return;
     }
 
-    return dst_bit_expanded;
+    route_trie_destroy(trie->child[0]);
+    route_trie_destroy(trie->child[1]);
+
+    free(trie);
 }
 
 static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1, char *str2, uint16 len)
@@ -936,7 +1382,7 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
         ip_pdu_t *pdu = data2;
 
         snprintf(str1, len, "incoming_node = '%s'", (node != NULL ? node->phy_info->name : "<<local>>"));
-        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", pdu->src_address, pdu->dst_address);
+        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", addr_to_string(pdu->src_address), addr_to_string(pdu->dst_address));
     }
     else if (event_id == ip_event_pdu_send_timeout_check) {
         ip_send_info_t *send_info = data1;
@@ -952,11 +1398,81 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
         mac_pdu_t *pdu = data2;
 
         snprintf(str1, len, "incoming_node = '%s'", (node != NULL ? node->phy_info->name : "<<unknown>>"));
-        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", pdu->src_address, pdu->dst_address);
+        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", addr_to_string(pdu->src_address), addr_to_string(pdu->dst_address));
+    }
+}
+
+static void neighbor_expiry_insert(node_t *node, ip_neighbor_t *neighbor, sim_time_t expiry_time)
+{
+    ip_node_info_t *ip_info = node->ip_info;
+
+    neighbor->expiry_time = expiry_time;
+
+    /* the expiry times mostly grow, so the place is almost always found at the tail */
+    ip_neighbor_t *prev = ip_info->expiry_last;
+    while (prev != NULL && prev->expiry_time > expiry_time) {
+        prev = prev->expiry_prev;
+    }
+
+    neighbor->expiry_prev = prev;
+    neighbor->expiry_next = (prev != NULL) ? prev->expiry_next : ip_info->expiry_first;
+
+    if (neighbor->expiry_next != NULL) {
+        neighbor->expiry_next->expiry_prev = neighbor;
+    }
+    else {
+        ip_info->expiry_last = neighbor;
+    }
+
+    if (prev != NULL) {
+        prev->expiry_next = neighbor;
+    }
+    else {
+        ip_info->expiry_first = neighbor;
+    }
+}
+
+static void neighbor_expiry_unlink(node_t *node, ip_neighbor_t *neighbor)
+{
+    ip_node_info_t *ip_info = node->ip_info;
+
+    if (neighbor->expiry_prev != NULL) {
+        neighbor->expiry_prev->expiry_next = neighbor->expiry_next;
+    }
+    else {
+        ip_info->expiry_first = neighbor->expiry_next;
     }
-    else if (event_id == ip_event_neighbor_cache_timeout_check) {
-        ip_neighbor_t *neighbor = data1;
 
-        snprintf(str1, len, "neighbor = '%s'", (neighbor->node != NULL ? neighbor->node->phy_info->name : "<<unknown>>"));
+    if (neighbor->expiry_next != NULL) {
+        neighbor->expiry_next->expiry_prev = neighbor->expiry_prev;
     }
+    else {
+        ip_info->expiry_last = neighbor->expiry_prev;
+    }
+
+    neighbor->expiry_prev = NULL;
+    neighbor->expiry_next = NULL;
+}
+
+static void neighbor_expiry_schedule(node_t *node)
+{
+    ip_node_info_t *ip_info = node->ip_info;
+
+    if (ip_info->expiry_first == NULL) {
+        return;
+    }
+
+    sim_time_t expiry_time = ip_info->expiry_first->expiry_time;
+    if (ip_info->expiry_sweep_pending) {
+        if (ip_info->expiry_sweep_time <= expiry_time) { /* the pending sweep comes early enough */
+            return;
+        }
+
+        rs_system_cancel_event(node, ip_event_neighbor_cache_timeout_check, NULL, NULL, 0);
+    }
+
+    rs_system_schedule_event(node, ip_event_neighbor_cache_timeout_check, NULL, NULL, expiry_time - rs_system->now);
+
+    ip_info->expiry_sweep_pending = TRUE;
+    ip_info->expiry_sweep_time = expiry_time;
 }
@@ -30,12 +30,16 @@
 #define IP_ROUTE_TYPE_MANUAL        1
 #define IP_ROUTE_TYPE_RPL_DAO       2
 #define IP_ROUTE_TYPE_RPL_DIO       3
+#define IP_ROUTE_TYPE_COUNT         4
 
 
+    /* the state of the single unicast send a node may have in progress */
 typedef struct ip_send_info_t {
 
     node_t *                incoming_node;
-    node_t **               next_hop_list;
+    node_t *                first_next_hop;     /* the routed next hop, when not among the RPL candidates */
+    struct rpl_next_hop_list_t *
+                            rpl_next_hop_list;  /* referenced, not copied */
     uint16                  next_hop_count;
     int16                   next_hop_index;
 
@@ -46,6 +50,11 @@ typedef struct ip_neighbor_t {
     node_t *                node;
     sim_time_t              last_packet_time;
 
+        /* position in the node's expiry list, ordered by the time of the next check */
+    sim_time_t              expiry_time;
+    struct ip_neighbor_t *  expiry_prev;
+    struct ip_neighbor_t *  expiry_next;
+
 } ip_neighbor_t;
 
 typedef struct ip_flow_label_t {
@@ -62,6 +71,7 @@ typedef struct ip_flow_label_t {
 typedef struct ip_route_t {
 
     char *                  dst;
+    address_t               dst_id;         /* interned dst */
     uint8                   prefix_len;
     node_t *                next_hop;
 
@@ -70,41 +80,98 @@ typedef struct ip_route_t {
 
     sim_time_t              update_time;
 
-        /* destination expressed as a bit-array, a performance workaround */
-    uint8 *                 dst_bit_expanded;
+        /* destination bits, left aligned, and the place of the route in the prefix trie */
+    uint64                  dst_bits;
+    struct ip_route_trie_t *trie_node;
+    struct ip_route_t *     trie_next;
+
+        /* position in the route list and links in the next hop and type indexes */
+    uint16                  list_index;
+    struct ip_route_t *     next_hop_prev;
+    struct ip_route_t *     next_hop_next;
+    struct ip_route_t *     type_prev;
+    struct ip_route_t *     type_next;
 
 } ip_route_t;
 
+    /* the routes sharing a next hop or a type, in insertion order */
+typedef struct ip_route_index_t {
+
+    node_t *                next_hop;   /* unused by the type index */
+    ip_route_t *            first;
+    ip_route_t *            last;
+
+} ip_route_index_t;
+
+    /* a node of the path-compressed binary trie indexing the routes by prefix */
+typedef struct ip_route_trie_t {
+
+    uint64                  key;
+    uint8                   len;
+    ip_route_t *            route_first;    /* all the routes having exactly this prefix */
+
+    struct ip_route_trie_t *parent;
+    struct ip_route_trie_t *child[2];
+
+} ip_route_trie_t;
+
+    /* a packet waiting in the transmit queue while the IP layer is busy */
+typedef struct ip_queued_pdu_t {
+
+    struct ip_pdu_t *       pdu;
+    node_t *                incoming_node;
+    sim_time_t              enqueue_time;
+
+} ip_queued_pdu_t;
+
     /* info that a node supporting IP should store */
 typedef struct ip_node_info_t {
 
     char *                  address;
+    address_t               address_id;
 
     ip_route_t **           route_list;
     uint16                  route_count;
+    ip_route_trie_t *       route_trie;
+    ip_route_index_t        route_type_index[IP_ROUTE_TYPE_COUNT];
+    ip_route_index_t *      route_next_hop_index;
+    uint16                  route_next_hop_index_count;
 
     ip_neighbor_t **        neighbor_list;
     uint16                  neighbor_count;
+    node_map_t              neighbor_map;
+    ip_neighbor_t *         expiry_first;
+    ip_neighbor_t *         expiry_last;
+    bool                    expiry_sweep_pending;   /* a single sweep event per node, at the earliest expiry */
+    sim_time_t              expiry_sweep_time;
 
     bool                    busy;
-    uint32                  enqueued_count;
+    ip_send_info_t          send_info;
 
+        /* FIFO ring of packets waiting for the IP layer to become idle */
+    ip_queued_pdu_t *       queue;
+    uint32                  queue_size;
+    uint32                  queue_head;
+    uint32                  enqueued_count;
 
 } ip_node_info_t;
 
     /* fields contained in a IP packet */
 typedef struct ip_pdu_t {
 
-    char *                  dst_address;
-    char *                  src_address;
+    address_t               dst_address;
+    address_t               src_address;
 
     ip_flow_label_t *       flow_label;
 
+        /* the source route header, attached by the root of a non-storing dodag */
+    address_t *             source_route;
+    uint8                   source_route_count;
+    uint8                   source_route_index; /* the next hop to visit */
+
     uint16                  next_header;
     void *                  sdu;
 
-    bool                    queued; /* workaround for IP queue/buffer management */
-
 } ip_pdu_t;
 
 
@@ -117,14 +184,18 @@ extern uint16               ip_event_pdu_receive;
 
 extern uint16               ip_event_neighbor_cache_timeout_check;
 
+extern uint32               ip_pdu_create_count;
+extern uint32               ip_pdu_duplicate_count;
+
 
 bool                        ip_init();
 bool                        ip_done();
 
-ip_send_info_t *            ip_send_info_create(node_t *incoming_node, node_t *first_next_hop, node_t **next_hop_list, uint16 next_hop_count);
+ip_send_info_t *            ip_send_info_create(node_t *node, node_t *incoming_node, node_t *first_next_hop);
 void                        ip_send_info_destroy(ip_send_info_t *ip_send_info);
+node_t *                    ip_send_info_get_next_hop(ip_send_info_t *ip_send_info, uint16 index);
 
-ip_pdu_t *                  ip_pdu_create(char *src_address, char *dst_address);
+ip_pdu_t *                  ip_pdu_create(address_t src_address, address_t dst_address);
 void                        ip_pdu_destroy(ip_pdu_t *pdu);
 ip_pdu_t *                  ip_pdu_duplicate(ip_pdu_t *pdu);
 void                        ip_pdu_set_sdu(ip_pdu_t *pdu, uint16 next_header, void *sdu);
@@ -138,13 +209,14 @@ ip_route_t *                ip_node_add_route(node_t *node, char *dst, uint8 pre
 void                        ip_node_rem_route(node_t *node, ip_route_t *route);
 void                        ip_node_rem_routes(node_t *node, char *dst, int8 prefix_len, node_t *next_hop, int8 type);
 ip_route_t **               ip_node_get_routes(node_t *node, uint16 *route_count, char *dst, int8 prefix_len, node_t *next_hop, int8 type);
-ip_route_t *                ip_node_get_next_hop_route(node_t *node, char *dst_address);
+ip_route_t *                ip_node_get_next_hop_route(node_t *node, address_t dst_address);
+void                        ip_node_reindex_routes(node_t *node);
 
 ip_neighbor_t *             ip_node_add_neighbor(node_t *node, node_t *neighbor_node);
 bool                        ip_node_rem_neighbor(node_t *node, ip_neighbor_t *neighbor);
 ip_neighbor_t *             ip_node_find_neighbor_by_node(node_t *node, node_t *neighbor_node);
 
-bool                        ip_node_send(node_t *node, char *dst_ip_address, uint16 next_header, void *sdu);
+bool                        ip_node_send(node_t *node, address_t dst_address, uint16 next_header, void *sdu);
 bool                        ip_node_forward(node_t *node, node_t *incoming_node, ip_pdu_t *pdu);
 bool                        ip_node_receive(node_t *node, node_t *incoming_node, ip_pdu_t *pdu);
 
@@ -29,6 +29,7 @@ uint16                  mac_event_node_kill;
 
 uint16                  mac_event_pdu_send;
 uint16                  mac_event_pdu_send_timeout_check;
+uint16                  mac_event_pdu_send_attempt;
 uint16                  mac_event_pdu_receive;
 
 
@@ -39,10 +40,17 @@ static bool             event_handler_node_kill(node_t *node);
 
 static bool             event_handler_pdu_send(node_t *node, node_t *outgoing_node, mac_pdu_t *pdu);
 static bool             event_handler_pdu_send_timeout_check(node_t *node, node_t *outgoing_node, mac_pdu_t *pdu);
+static bool             event_handler_pdu_send_attempt(node_t *node);
 static bool             event_handler_pdu_receive(node_t *node, node_t *incoming_node, mac_pdu_t *pdu);
 
 static void             event_arg_str(uint16 event_id, void *data1, void *data2, char *str1, char *str2, uint16 len);
 
+static bool             queue_push(node_t *node, node_t *outgoing_node, mac_pdu_t *pdu);
+static void             queue_flush(node_t *node);
+static void             csma_start(node_t *node);
+static void             csma_backoff(node_t *node);
+static void             csma_done(node_t *node, bool delivered);
+
     /**** exported functions ****/
 
 bool mac_init()
@@ -52,6 +60,7 @@ bool mac_init()
 
     mac_event_pdu_send = event_register("pdu_send", "mac", (event_handler_t) event_handler_pdu_send, event_arg_str);
     mac_event_pdu_send_timeout_check = event_register("pdu_send_timeout_check", "mac", (event_handler_t) event_handler_pdu_send_timeout_check, event_arg_str);
+    mac_event_pdu_send_attempt = event_register("pdu_send_attempt", "mac", (event_handler_t) event_handler_pdu_send_attempt, event_arg_str);
     mac_event_pdu_receive = event_register("pdu_receive", "mac", (event_handler_t) event_handler_pdu_receive, event_arg_str);
 
     return TRUE;
@@ -62,15 +71,12 @@ bool mac_done()
     return TRUE;
 }
 
-mac_pdu_t *mac_pdu_create(char *src_address, char *dst_address)
+mac_pdu_t *mac_pdu_create(address_t src_address, address_t dst_address)
 {
-    rs_assert(src_address != NULL);
-    rs_assert(dst_address != NULL);
-
     mac_pdu_t *pdu = malloc(sizeof(mac_pdu_t));
 
-    pdu->src_address = strdup(src_address);
-    pdu->dst_address = strdup(dst_address);
+    pdu->src_address = src_address;
+    pdu->dst_address = dst_address;
 
     pdu->type = -1;
     pdu->sdu = NULL;
@@ -82,12 +88,6 @@ void mac_pdu_destroy(mac_pdu_t *pdu)
 {
     rs_assert(pdu != NULL);
 
-    if (pdu->dst_address != NULL)
-        free(pdu->dst_address);
-
-    if (pdu->src_address != NULL)
-        free(pdu->src_address);
-
     if (pdu->sdu != NULL) {
         switch (pdu->type) {
 
@@ -107,8 +107,8 @@ mac_pdu_t *mac_pdu_duplicate(mac_pdu_t *pdu)
 
     mac_pdu_t *new_pdu = malloc(sizeof(mac_pdu_t));
 
-    new_pdu->src_address = strdup(pdu->src_address);
-    new_pdu->dst_address = strdup(pdu->dst_address);
+    new_pdu->src_address = pdu->src_address;
+    new_pdu->dst_address = pdu->dst_address;
 
     new_pdu->type = pdu->type;
 
@@ -138,8 +138,18 @@ void mac_node_init(node_t *node, char *address)
     node->mac_info = malloc(sizeof(mac_node_info_t));
 
     node->mac_info->address = strdup(address);
+    node->mac_info->address_id = addr_intern(address);
     node->mac_info->busy = FALSE;
     node->mac_info->error = FALSE;
+
+    node->mac_info->queue = NULL;
+    node->mac_info->queue_size = 0;
+    node->mac_info->queue_head = 0;
+    node->mac_info->queued_count = 0;
+    node->mac_info->backoff_count = 0;
+    node->mac_info->backoff_exponent = 0;
+    node->mac_info->retry_count = 0;
+    node->mac_info->transmitted = FALSE;
 }
 
 void mac_node_done(node_t *node)
@@ -150,6 +160,10 @@ void mac_node_done(node_t *node)
         if (node->mac_info->address != NULL)
             free(node->mac_info->address);
 
+        queue_flush(node);
+        if (node->mac_info->queue != NULL)
+            free(node->mac_info->queue);
+
         free(node->mac_info);
         node->mac_info = NULL;
     }
@@ -164,13 +178,16 @@ void mac_node_set_address(node_t *node, const char *address)
         free(node->mac_info->address);
 
     node->mac_info->address = strdup(address);
+    node->mac_info->address_id = addr_intern(address);
+
+    rs_system_nodes_changed();
 }
 
 bool mac_node_send(node_t *node, node_t *outgoing_node, uint16 type, void *sdu)
 {
     rs_assert(node != NULL);
 
-    mac_pdu_t *mac_pdu = mac_pdu_create(node->mac_info->address, outgoing_node != NULL ? outgoing_node->mac_info->address : "");
+    mac_pdu_t *mac_pdu = mac_pdu_create(node->mac_info->address_id, outgoing_node != NULL ? outgoing_node->mac_info->address_id : ADDR_BROADCAST);
     mac_pdu_set_sdu(mac_pdu, type, sdu);
 
     if (!event_execute(mac_event_pdu_send, node, outgoing_node, mac_pdu)) {
@@ -205,6 +222,8 @@ bool event_handler_node_wake(node_t *node)
 
 bool event_handler_node_kill(node_t *node)
 {
+    queue_flush(node); /* the pending attempts and timeout checks are canceled along with the other events */
+
     node->mac_info->busy = FALSE;
     node->mac_info->error = FALSE;
 
@@ -213,6 +232,21 @@ bool event_handler_node_kill(node_t *node)
 
 bool event_handler_pdu_send(node_t *node, node_t *outgoing_node, mac_pdu_t *pdu)
 {
+    if (rs_system->mac_csma) {
+        if (!queue_push(node, outgoing_node, pdu)) {
+            rs_debug(DEBUG_MAC, "node '%s': MAC queue is full, dropping frame", node->phy_info->name);
+
+            return FALSE;
+        }
+
+        if (!node->mac_info->busy) {
+            node->mac_info->busy = TRUE;
+            csma_start(node);
+        }
+
+        return TRUE;
+    }
+
     if (node->mac_info->busy) {
         rs_debug(DEBUG_MAC, "node '%s': MAC layer is busy, dropping frame", node->phy_info->name);
 
@@ -233,23 +267,105 @@ bool event_handler_pdu_send(node_t *node, node_t *outgoing_node, mac_pdu_t *pdu)
 
 bool event_handler_pdu_send_timeout_check(node_t *node, node_t *outgoing_node, mac_pdu_t *pdu)
 {
+    if (rs_system->mac_csma) {
+        mac_node_info_t *mac_info = node->mac_info;
+
+        if (mac_info->error && outgoing_node != NULL && mac_info->retry_count < rs_system->mac_max_retries) { /* no ACK, try again */
+            rs_debug(DEBUG_MAC, "node '%s': no ACK from '%s', retransmitting frame (%d)", node->phy_info->name, outgoing_node->phy_info->name, mac_info->retry_count + 1);
+
+            mac_info->retry_count++;
+            mac_info->transmitted = FALSE;
+            mac_info->backoff_count = 0;
+            mac_info->backoff_exponent = rs_system->mac_min_backoff_exponent;
+            csma_backoff(node);
+        }
+        else {
+            if (mac_info->error) {
+                rs_debug(DEBUG_MAC, "node '%s': a frame wasn't correctly received, destroying it", node->phy_info->name);
+            }
+
+            csma_done(node, !mac_info->error);
+        }
+
+        return TRUE;
+    }
+
+    if (outgoing_node != NULL) { /* a unicast frame, acknowledged or not */
+        rpl_node_add_link_sample(node, outgoing_node, 1, !node->mac_info->error);
+    }
+
     if (node->mac_info->error) { /* the message wasn't received */
         rs_debug(DEBUG_MAC, "node '%s': a frame wasn't correctly received, destroying it", node->phy_info->name);
         pdu->sdu = NULL;
         mac_pdu_destroy(pdu);
     }
+    else if (outgoing_node == NULL) { /* the receivers got copies of a broadcast frame */
+        pdu->sdu = NULL;
+        mac_pdu_destroy(pdu);
+    }
 
     node->mac_info->busy = FALSE;
 
     return TRUE;
 }
 
+bool event_handler_pdu_send_attempt(node_t *node)
+{
+    mac_node_info_t *mac_info = node->mac_info;
+
+    if (mac_info->queued_count == 0) {
+        return TRUE;
+    }
+
+    mac_queued_frame_t *frame = &mac_info->queue[mac_info->queue_head];
+
+    if (phy_node_get_channel_free_time(node) > rs_system->now) { /* clear channel assessment failed */
+        if (++mac_info->backoff_count > rs_system->mac_max_backoffs) {
+            rs_debug(DEBUG_MAC, "node '%s': channel access failure, dropping frame", node->phy_info->name);
+
+            csma_done(node, FALSE);
+
+            return TRUE;
+        }
+
+        if (mac_info->backoff_exponent < rs_system->mac_max_backoff_exponent) {
+            mac_info->backoff_exponent++;
+        }
+
+        csma_backoff(node);
+
+        return TRUE;
+    }
+
+    if (!phy_node_send(node, frame->outgoing_node, frame->pdu)) {
+        csma_done(node, FALSE);
+
+        return FALSE;
+    }
+
+    rs_system_schedule_event(node, mac_event_pdu_send_timeout_check, frame->outgoing_node, frame->pdu, rs_system->mac_pdu_timeout);
+
+    mac_info->error = TRUE;
+    mac_info->transmitted = TRUE;
+
+    return TRUE;
+}
+
 bool event_handler_pdu_receive(node_t *node, node_t *incoming_node, mac_pdu_t *pdu)
 {
     bool all_ok = TRUE;
 
     incoming_node->mac_info->error = FALSE; /* emulate a MAC acknowledgment */
 
+    mac_node_info_t *sender_info = incoming_node->mac_info;
+    if (rs_system->mac_csma && pdu->dst_address != ADDR_BROADCAST && sender_info->transmitted &&
+            sender_info->queued_count > 0 && sender_info->queue[sender_info->queue_head].pdu == pdu) {
+
+        /* the ACK completes the frame right away, the sender may go on with its queue */
+        rs_system_cancel_event(incoming_node, mac_event_pdu_send_timeout_check, NULL, pdu, 0);
+        csma_done(incoming_node, TRUE);
+    }
+
     switch (pdu->type) {
 
         case MAC_TYPE_IP : {
@@ -282,7 +398,7 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
         mac_pdu_t *pdu = data2;
 
         snprintf(str1, len, "outgoing_node = '%s'", (node != NULL ? node->phy_info->name : "<<broadcast>>"));
-        snprintf(str2, len, "mac_pdu = {src = '%s', dst = '%s'}", pdu->src_address, pdu->dst_address);
+        snprintf(str2, len, "mac_pdu = {src = '%s', dst = '%s'}", addr_to_string(pdu->src_address), addr_to_string(pdu->dst_address));
     }
     else if (event_id == mac_event_pdu_send_timeout_check) {
         node_t *node = data1;
@@ -294,6 +410,110 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
         mac_pdu_t *pdu = data2;
 
         snprintf(str1, len, "incoming_node = '%s'", (node != NULL ? node->phy_info->name : "<<unknown>>"));
-        snprintf(str2, len, "mac_pdu = {src = '%s', dst = '%s'}", pdu->src_address, pdu->dst_address);
+        snprintf(str2, len, "mac_pdu = {src = '%s', dst = '%s'}", addr_to_string(pdu->src_address), addr_to_string(pdu->dst_address));
+    }
+}
+
+static bool queue_push(node_t *node, node_t *outgoing_node, mac_pdu_t *pdu)
+{
+    mac_node_info_t *mac_info = node->mac_info;
+
+    if (mac_info->queued_count >= rs_system->mac_queue_size) {
+        return FALSE;
+    }
+
+    if (mac_info->queued_count == mac_info->queue_size) { /* the queue size setting has grown */
+        mac_queued_frame_t *queue = malloc(rs_system->mac_queue_size * sizeof(mac_queued_frame_t));
+
+        uint16 i;
+        for (i = 0; i < mac_info->queued_count; i++) {
+            queue[i] = mac_info->queue[(mac_info->queue_head + i) % mac_info->queue_size];
+        }
+
+        if (mac_info->queue != NULL) {
+            free(mac_info->queue);
+        }
+
+        mac_info->queue = queue;
+        mac_info->queue_size = rs_system->mac_queue_size;
+        mac_info->queue_head = 0;
+    }
+
+    mac_queued_frame_t *frame = &mac_info->queue[(mac_info->queue_head + mac_info->queued_count) % mac_info->queue_size];
+    frame->pdu = pdu;
+    frame->outgoing_node = outgoing_node;
+
+    mac_info->queued_count++;
+
+    return TRUE;
+}
+
+static void queue_flush(node_t *node)
+{
+    mac_node_info_t *mac_info = node->mac_info;
+
+    while (mac_info->queued_count > 0) {
+        mac_queued_frame_t *frame = &mac_info->queue[mac_info->queue_head];
+
+        /* a unicast frame already on the air belongs to its receiver, whose pending receive event
+         * outlives this node; a broadcast original is still ours, the receivers got copies */
+        if (!mac_info->transmitted || frame->outgoing_node == NULL) {
+            mac_pdu_destroy(frame->pdu);
+        }
+
+        mac_info->transmitted = FALSE;
+        mac_info->queue_head = (mac_info->queue_head + 1) % mac_info->queue_size;
+        mac_info->queued_count--;
+    }
+
+    mac_info->queue_head = 0;
+}
+
+static void csma_start(node_t *node)
+{
+    node->mac_info->backoff_count = 0;
+    node->mac_info->backoff_exponent = rs_system->mac_min_backoff_exponent;
+    node->mac_info->retry_count = 0;
+    node->mac_info->transmitted = FALSE;
+
+    csma_backoff(node);
+}
+
+static void csma_backoff(node_t *node)
+{
+    /* instead of ticking through the backoff slots, the attempt is scheduled right away
+     * for when the channel is expected to be idle, plus a random number of slots */
+    uint32 slots = phy_node_random(node) % (1 << node->mac_info->backoff_exponent);
+    sim_time_t delay = phy_node_get_channel_free_time(node) - rs_system->now + slots * rs_system->mac_backoff_slot;
+
+    rs_system_schedule_event(node, mac_event_pdu_send_attempt, NULL, NULL, delay);
+}
+
+static void csma_done(node_t *node, bool delivered)
+{
+    mac_node_info_t *mac_info = node->mac_info;
+
+    node_t *outgoing_node = mac_info->queue[mac_info->queue_head].outgoing_node;
+    if (outgoing_node != NULL) { /* a unicast frame, after all its retries */
+        rpl_node_add_link_sample(node, outgoing_node, mac_info->retry_count + 1, delivered);
+    }
+
+    if (!delivered || outgoing_node == NULL) { /* the upper layer still owns the payload, broadcast receivers got copies */
+        mac_pdu_t *pdu = mac_info->queue[mac_info->queue_head].pdu;
+        pdu->sdu = NULL;
+        mac_pdu_destroy(pdu);
+
+        mac_info->error = TRUE;
+    }
+
+    mac_info->transmitted = FALSE;
+    mac_info->queue_head = (mac_info->queue_head + 1) % mac_info->queue_size;
+    mac_info->queued_count--;
+
+    if (mac_info->queued_count > 0) {
+        csma_start(node);
+    }
+    else {
+        mac_info->busy = FALSE;
     }
 }
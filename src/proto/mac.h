@@ -25,20 +25,39 @@
 #include "../node.h"
 
 
+    /* a frame waiting in the CSMA/CA transmit queue */
+typedef struct mac_queued_frame_t {
+
+    struct mac_pdu_t *  pdu;
+    node_t *            outgoing_node;
+
+} mac_queued_frame_t;
+
     /* info that a node supporting MAC layer should store */
 typedef struct mac_node_info_t {
 
     char *              address;
+    address_t           address_id;
     bool                busy;
     bool                error;
 
+        /* CSMA/CA FIFO ring, the head frame is being backed off or waits for its ACK */
+    mac_queued_frame_t *queue;
+    uint16              queue_size;
+    uint16              queue_head;
+    uint16              queued_count;
+    uint8               backoff_count;
+    uint8               backoff_exponent;
+    uint8               retry_count;
+    bool                transmitted;    /* the head frame is on the air, a receiver may own it already */
+
 } mac_node_info_t;
 
     /* fields contained in a MAC frame */
 typedef struct mac_pdu_t {
 
-	char *             dst_address;
-	char *             src_address;
+	address_t          dst_address;
+	address_t          src_address;
 
 	uint16             type;
 	void *             sdu;
@@ -51,13 +70,14 @@ extern uint16           mac_event_node_kill;
 
 extern uint16           mac_event_pdu_send;
 extern uint16           mac_event_pdu_send_timeout_check;
+extern uint16           mac_event_pdu_send_attempt;
 extern uint16           mac_event_pdu_receive;
 
 
 bool                    mac_init();
 bool                    mac_done();
 
-mac_pdu_t *             mac_pdu_create(char *src_address, char *dst_address);
+mac_pdu_t *             mac_pdu_create(address_t src_address, address_t dst_address);
 void                    mac_pdu_destroy(mac_pdu_t *pdu);
 mac_pdu_t *             mac_pdu_duplicate(mac_pdu_t *pdu);
 void                    mac_pdu_set_sdu(mac_pdu_t *pdu, uint16 type, void *sdu);
@@ -25,6 +25,7 @@
     /**** global variables ****/
 
 static measure_converg_t            measure_converg;
+static sim_time_t                   connect_refresh_time = -1;  /* the time step with a refresh pending, -1 if none */
 
 uint16                              measure_event_node_wake;
 uint16                              measure_event_node_kill;
@@ -33,6 +34,7 @@ uint16                              measure_event_pdu_send;
 uint16                              measure_event_pdu_receive;
 
 uint16                              measure_event_connect_update;
+uint16                              measure_event_connect_refresh;
 uint16                              measure_event_connect_hop_passed;
 uint16                              measure_event_connect_hop_failed;
 uint16                              measure_event_connect_hop_timeout;
@@ -45,10 +47,11 @@ uint16                              measure_event_connect_lost;
 static bool                         event_handler_node_wake(node_t *node);
 static bool                         event_handler_node_kill(node_t *node);
 
-static bool                         event_handler_pdu_send(node_t *node, char *dst_ip_address, measure_pdu_t *pdu);
+static bool                         event_handler_pdu_send(node_t *node, address_t dst_address, measure_pdu_t *pdu);
 static bool                         event_handler_pdu_receive(node_t *node, node_t *incoming_node, measure_pdu_t *pdu);
 
 static bool                         event_handler_connect_update(node_t *node, node_t *dst_node);
+static bool                         event_handler_connect_refresh();
 static bool                         event_handler_connect_hop_passed(node_t *node, node_t *dst_node, node_t *hop);
 static bool                         event_handler_connect_hop_failed(node_t *node, node_t *dst_node, node_t *hop);
 static bool                         event_handler_connect_hop_timeout(node_t *node, node_t *dst_node, node_t *last_hop);
@@ -69,6 +72,7 @@ bool measure_init()
     measure_event_pdu_receive = event_register("pdu_receive", "measure", (event_handler_t) event_handler_pdu_receive, event_arg_str);
 
     measure_event_connect_update = event_register("connect_update", "measure", (event_handler_t) event_handler_connect_update, NULL);
+    measure_event_connect_refresh = event_register("connect_refresh", "measure", (event_handler_t) event_handler_connect_refresh, NULL);
     measure_event_connect_hop_passed = event_register("connect_hop_passed", "measure", (event_handler_t) event_handler_connect_hop_passed, event_arg_str);
     measure_event_connect_hop_failed = event_register("connect_hop_failed", "measure", (event_handler_t) event_handler_connect_hop_failed, event_arg_str);
     measure_event_connect_hop_timeout = event_register("connect_hop_timeout", "measure", (event_handler_t) event_handler_connect_hop_timeout, event_arg_str);
@@ -138,10 +142,20 @@ void measure_node_init(node_t *node)
     node->measure_info->rpl_s_dis_message_count = 0;
     node->measure_info->rpl_s_dio_message_count = 0;
     node->measure_info->rpl_s_dao_message_count = 0;
+    node->measure_info->rpl_dio_suppressed_count = 0;
+    node->measure_info->rpl_sr_computed_count = 0;
+    node->measure_info->rpl_sr_cached_count = 0;
+    node->measure_info->rpl_sr_step_total = 0;
     node->measure_info->ping_successful_count = 0;
     node->measure_info->ping_timeout_count = 0;
     node->measure_info->gen_ip_packet_count = 0;
     node->measure_info->fwd_ip_packet_count = 0;
+    node->measure_info->collision_count = 0;
+    node->measure_info->ip_dequeued_count = 0;
+    node->measure_info->ip_queue_delay_total = 0;
+    node->measure_info->traffic_sent_count = 0;
+    node->measure_info->traffic_received_count = 0;
+    node->measure_info->traffic_delay_total = 0;
 }
 
 void measure_node_done(node_t *node)
@@ -161,7 +175,7 @@ bool measure_node_send(node_t *node, node_t *dst_node, uint8 type)
 
     measure_pdu_t *measure_pdu = measure_pdu_create(node, dst_node, type);
 
-    if (!event_execute(measure_event_pdu_send, node, dst_node->ip_info->address, measure_pdu)) {
+    if (!event_execute(measure_event_pdu_send, node, GUINT_TO_POINTER(dst_node->ip_info->address_id), measure_pdu)) {
         measure_pdu_destroy(measure_pdu);
         return FALSE;
     }
@@ -225,6 +239,26 @@ void measure_node_add_rpl_dao_message(node_t *node, bool sent)
         node->measure_info->rpl_r_dao_message_count++;
 }
 
+void measure_node_add_rpl_dio_suppressed(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    node->measure_info->rpl_dio_suppressed_count++;
+}
+
+void measure_node_add_rpl_source_route(node_t *node, bool cached, uint16 step_count)
+{
+    rs_assert(node != NULL);
+
+    if (cached) {
+        node->measure_info->rpl_sr_cached_count++;
+    }
+    else {
+        node->measure_info->rpl_sr_computed_count++;
+        node->measure_info->rpl_sr_step_total += step_count;
+    }
+}
+
 void measure_node_add_ping(node_t *node, bool successful)
 {
     rs_assert(node != NULL);
@@ -246,6 +280,34 @@ void measure_node_add_ip_packet(node_t *node, bool generated)
         node->measure_info->fwd_ip_packet_count++;
 }
 
+void measure_node_add_collision(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    node->measure_info->collision_count++;
+}
+
+void measure_node_add_ip_queue_delay(node_t *node, sim_time_t delay)
+{
+    rs_assert(node != NULL);
+
+    node->measure_info->ip_dequeued_count++;
+    node->measure_info->ip_queue_delay_total += delay;
+}
+
+void measure_node_add_traffic_packet(node_t *node, bool received, sim_time_t delay)
+{
+    rs_assert(node != NULL);
+
+    if (received) {
+        node->measure_info->traffic_received_count++;
+        node->measure_info->traffic_delay_total += delay;
+    }
+    else {
+        node->measure_info->traffic_sent_count++;
+    }
+}
+
 void measure_node_reset(node_t *node)
 {
     rs_assert(node != NULL);
@@ -265,34 +327,31 @@ void measure_node_reset(node_t *node)
     node->measure_info->rpl_s_dis_message_count = 0;
     node->measure_info->rpl_s_dio_message_count = 0;
     node->measure_info->rpl_s_dao_message_count = 0;
+    node->measure_info->rpl_dio_suppressed_count = 0;
+    node->measure_info->rpl_sr_computed_count = 0;
+    node->measure_info->rpl_sr_cached_count = 0;
+    node->measure_info->rpl_sr_step_total = 0;
     node->measure_info->ping_successful_count = 0;
     node->measure_info->ping_timeout_count = 0;
     node->measure_info->gen_ip_packet_count = 0;
     node->measure_info->fwd_ip_packet_count = 0;
+    node->measure_info->collision_count = 0;
+    node->measure_info->ip_dequeued_count = 0;
+    node->measure_info->ip_queue_delay_total = 0;
+    node->measure_info->traffic_sent_count = 0;
+    node->measure_info->traffic_received_count = 0;
+    node->measure_info->traffic_delay_total = 0;
 }
 
 void measure_connect_update()
 {
-    uint16 i;
-    for (i = 0; i < rs_system->node_count; i++) {
-        node_t *node = rs_system->node_list[i];
-
-        if (node->measure_info->connect_busy) {
-            continue;
-        }
-
-        if (node->measure_info->connect_dst_node == NULL) {
-            node->measure_info->connect_dst_reachable = FALSE;
-            continue;
-        }
-
-        if (node->measure_info->connect_dst_node == node) {
-            node->measure_info->connect_dst_reachable = TRUE;
-            continue;
-        }
-
-        rs_system_schedule_event(node, measure_event_connect_update, node->measure_info->connect_dst_node, NULL, 0);
+    /* neighbor changes come in storms, a single refresh at the end of the time step covers them all */
+    if (connect_refresh_time == rs_system->now) {
+        return;
     }
+
+    connect_refresh_time = rs_system->now;
+    rs_system_schedule_event(NULL, measure_event_connect_refresh, NULL, NULL, 0);
 }
 
 measure_converg_t *measure_converg_get()
@@ -356,6 +415,9 @@ static bool event_handler_node_kill(node_t *node)
 {
     rs_system_cancel_event(node, measure_event_connect_hop_timeout, NULL, NULL, 0);
 
+    /* the pending refresh doesn't survive a stop, which drops the schedules after killing the nodes */
+    connect_refresh_time = -1;
+
     if (node->measure_info->connect_dst_reachable) { /* force a disconnect */
         event_execute(measure_event_connect_lost, node, node->measure_info->connect_dst_node, node);
     }
@@ -363,9 +425,9 @@ static bool event_handler_node_kill(node_t *node)
     return TRUE;
 }
 
-static bool event_handler_pdu_send(node_t *node, char *dst_ip_address, measure_pdu_t *pdu)
+static bool event_handler_pdu_send(node_t *node, address_t dst_address, measure_pdu_t *pdu)
 {
-    return ip_node_send(node, dst_ip_address, IP_NEXT_HEADER_MEASURE, pdu);
+    return ip_node_send(node, dst_address, IP_NEXT_HEADER_MEASURE, pdu);
 }
 
 static bool event_handler_pdu_receive(node_t *node, node_t *incoming_node, measure_pdu_t *pdu)
@@ -415,6 +477,36 @@ static bool event_handler_connect_update(node_t *node, node_t *dst_node)
     }
 }
 
+static bool event_handler_connect_refresh()
+{
+    connect_refresh_time = -1;
+
+    uint16 i;
+    for (i = 0; i < rs_system->node_count; i++) {
+        node_t *node = rs_system->node_list[i];
+
+        if (node->measure_info->connect_busy) {
+            continue;
+        }
+
+        if (node->measure_info->connect_dst_node == NULL) {
+            node->measure_info->connect_dst_reachable = FALSE;
+            continue;
+        }
+
+        if (node->measure_info->connect_dst_node == node) {
+            node->measure_info->connect_dst_reachable = TRUE;
+            continue;
+        }
+
+        rs_system_schedule_event(node, measure_event_connect_update, node->measure_info->connect_dst_node, NULL, 0);
+    }
+
+    measure_converg_update();
+
+    return TRUE;
+}
+
 static bool event_handler_connect_hop_passed(node_t *node, node_t *dst_node, node_t *hop)
 {
     rs_system_cancel_event(node, measure_event_connect_hop_timeout, dst_node, NULL, 0);
@@ -478,9 +570,9 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
     str2[0] = '\0';
 
     if (event_id == measure_event_pdu_send) {
-            char *dst_ip_address = data1;
+            address_t dst_address = GPOINTER_TO_UINT(data1);
 
-            snprintf(str1, len, "dst = '%s'", dst_ip_address != NULL ? dst_ip_address : "<<broadcast>>");
+            snprintf(str1, len, "dst = '%s'", dst_address != ADDR_BROADCAST ? addr_to_string(dst_address) : "<<broadcast>>");
     }
     else if (event_id == measure_event_pdu_receive) {
         node_t *node = data1;
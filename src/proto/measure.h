@@ -55,10 +55,20 @@ typedef struct measure_node_info_t {
     uint32                  rpl_s_dis_message_count;
     uint32                  rpl_s_dio_message_count;
     uint32                  rpl_s_dao_message_count;
+    uint32                  rpl_dio_suppressed_count;   /* DIOs not sent because enough consistent ones were heard */
+    uint32                  rpl_sr_computed_count;      /* source routes computed by a non-storing root */
+    uint32                  rpl_sr_cached_count;        /* source routes found in the path cache */
+    uint32                  rpl_sr_step_total;          /* parent pointers followed while computing source routes */
     uint32                  ping_successful_count;
     uint32                  ping_timeout_count;
     uint32                  gen_ip_packet_count;
     uint32                  fwd_ip_packet_count;
+    uint32                  collision_count;
+    uint32                  ip_dequeued_count;
+    uint32                  ip_queue_delay_total;   /* in ms, over all the dequeued packets */
+    uint32                  traffic_sent_count;
+    uint32                  traffic_received_count;
+    uint32                  traffic_delay_total;    /* in ms, over all the received traffic packets */
 
 } measure_node_info_t;
 
@@ -91,6 +101,7 @@ extern uint16               measure_event_pdu_send;
 extern uint16               measure_event_pdu_receive;
 
 extern uint16               measure_event_connect_update;
+extern uint16               measure_event_connect_refresh;
 extern uint16               measure_event_connect_hop_passed;
 extern uint16               measure_event_connect_hop_failed;
 extern uint16               measure_event_connect_hop_timeout;
@@ -116,8 +127,13 @@ void                        measure_node_add_forward_failure(node_t *node);
 void                        measure_node_add_rpl_dis_message(node_t *node, bool sent);
 void                        measure_node_add_rpl_dio_message(node_t *node, bool sent);
 void                        measure_node_add_rpl_dao_message(node_t *node, bool sent);
+void                        measure_node_add_rpl_dio_suppressed(node_t *node);
+void                        measure_node_add_rpl_source_route(node_t *node, bool cached, uint16 step_count);
 void                        measure_node_add_ping(node_t *node, bool successful);
 void                        measure_node_add_ip_packet(node_t *node, bool generated);
+void                        measure_node_add_collision(node_t *node);
+void                        measure_node_add_ip_queue_delay(node_t *node, sim_time_t delay);
+void                        measure_node_add_traffic_packet(node_t *node, bool received, sim_time_t delay);
 void                        measure_node_reset(node_t *node);
 
 void                        measure_connect_update();
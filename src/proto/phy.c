@@ -19,6 +19,10 @@
 */
 
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "phy.h"
 #include "../system.h"
@@ -34,9 +38,26 @@ uint16                  phy_event_pdu_receive;
 
 uint16                  phy_event_neighbor_attach;
 uint16                  phy_event_neighbor_detach;
+uint16                  phy_event_neighbors_update;
 
 uint16                  phy_event_change_mobility;
 
+uint16                  phy_event_trace_advance;
+
+    /* the link trace currently replayed */
+static uint8 *          trace_data = NULL;
+static size_t           trace_size = 0;
+static phy_trace_header_t *trace_header = NULL;
+static phy_trace_record_t *trace_record_list = NULL;
+static uint32           trace_cursor = 0;
+static node_t **        trace_node_list = NULL;
+
+    /* current quality of the traced links, open addressing on (src << 16 | dst) + 1 */
+static uint32 *         trace_link_key_list = NULL;
+static percent_t *      trace_link_quality_list = NULL;
+static uint32           trace_link_size = 0;
+static uint32           trace_link_count = 0;
+
 
     /**** local function prototypes ****/
 
@@ -48,11 +69,58 @@ static bool             event_handler_pdu_receive(node_t *node, node_t *incoming
 
 static bool             event_handler_neighbor_attach(node_t *node, node_t *neighbor_node);
 static bool             event_handler_neighbor_detach(node_t *node, node_t *neighbor_node);
+static bool             event_handler_neighbors_update(node_t *node);
 
 static bool             event_handler_change_mobility(node_t *node, phy_mobility_t *mobility);
 
+static bool             event_handler_trace_advance(node_t *node);
+
 static void             event_arg_str(uint16 event_id, void *data1, void *data2, char *str1, char *str2, uint16 len);
 
+static percent_t        linear_gain(node_t *src_node, node_t *dst_node, coord_t distance);
+static percent_t        log_distance_gain(node_t *src_node, node_t *dst_node, coord_t distance);
+static percent_t        unit_disk_gain(node_t *src_node, node_t *dst_node, coord_t distance);
+
+static double           pair_normal_sample(char *name1, char *name2, uint32 salt);
+static phy_link_t *     node_find_link(node_t *node, node_t *dst_node);
+static void             node_set_gain(node_t *node, node_t *dst_node, percent_t gain);
+static void             neighbor_change_add(node_t *node, node_t *neighbor_node, bool was_neighbor);
+static uint32           link_delivery_threshold(node_t *node, percent_t gain);
+static uint32           quality_delivery_threshold(percent_t quality);
+static uint32           name_hash(char *name1, char *name2, uint32 salt);
+
+static void             trace_consume(bool notify);
+static percent_t *      trace_link_lookup(uint32 key, bool create);
+
+static void             mobility_model_start(node_t *node);
+static sim_time_t       mobility_model_next_leg(node_t *node);
+static double           mobility_model_uniform(phy_mobility_model_t *model);
+static double           mobility_model_normal(phy_mobility_model_t *model);
+
+
+    /* a propagation model computes the tx power independent gain of the src->dst link;
+     * it is only evaluated when nodes move or the model params change */
+typedef percent_t (*propagation_gain_t)(node_t *src_node, node_t *dst_node, coord_t distance);
+
+typedef struct propagation_model_t {
+
+    char *              name;
+    propagation_gain_t  gain;
+
+} propagation_model_t;
+
+static char *           mobility_model_name_list[PHY_MOBILITY_MODEL_COUNT] = {
+    "none",
+    "random_waypoint",
+    "gauss_markov"
+};
+
+static propagation_model_t  propagation_model_list[PHY_PROPAGATION_MODEL_COUNT] = {
+    { "linear", linear_gain },
+    { "log_distance", log_distance_gain },
+    { "unit_disk", unit_disk_gain }
+};
+
 
     /**** exported functions ****/
 
@@ -66,22 +134,228 @@ bool phy_init()
     
     phy_event_neighbor_attach = event_register("neighbor_attach", "phy", (event_handler_t) event_handler_neighbor_attach, event_arg_str);
     phy_event_neighbor_detach = event_register("neighbor_detach", "phy", (event_handler_t) event_handler_neighbor_detach, event_arg_str);
+    phy_event_neighbors_update = event_register("neighbors_update", "phy", (event_handler_t) event_handler_neighbors_update, NULL);
 
     phy_event_change_mobility = event_register("change_mobility", "phy", (event_handler_t) event_handler_change_mobility, event_arg_str);
 
+    phy_event_trace_advance = event_register("trace_advance", "phy", (event_handler_t) event_handler_trace_advance, NULL);
+
     return TRUE;
 }
 
 bool phy_done()
 {
+    phy_trace_stop();
+
+    return TRUE;
+}
+
+char *phy_propagation_model_get_name(uint8 model)
+{
+    rs_assert(model < PHY_PROPAGATION_MODEL_COUNT);
+
+    return propagation_model_list[model].name;
+}
+
+int8 phy_propagation_model_find_by_name(char *name)
+{
+    rs_assert(name != NULL);
+
+    uint8 i;
+    for (i = 0; i < PHY_PROPAGATION_MODEL_COUNT; i++) {
+        if (!strcmp(propagation_model_list[i].name, name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+char *phy_mobility_model_get_name(uint8 type)
+{
+    rs_assert(type < PHY_MOBILITY_MODEL_COUNT);
+
+    return mobility_model_name_list[type];
+}
+
+int8 phy_mobility_model_find_by_name(char *name)
+{
+    rs_assert(name != NULL);
+
+    uint8 i;
+    for (i = 0; i < PHY_MOBILITY_MODEL_COUNT; i++) {
+        if (!strcmp(mobility_model_name_list[i], name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool phy_trace_start(char *file_name)
+{
+    rs_assert(file_name != NULL);
+
+    phy_trace_stop();
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        rs_error("failed to open link trace '%s': %s", file_name, strerror(errno));
+        return FALSE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < sizeof(phy_trace_header_t)) {
+        rs_error("invalid link trace '%s'", file_name);
+        close(fd);
+        return FALSE;
+    }
+
+    /* the trace is paged in by the kernel as the cursor advances, never loaded as a whole */
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        rs_error("failed to map link trace '%s': %s", file_name, strerror(errno));
+        return FALSE;
+    }
+
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    phy_trace_header_t *header = data;
+    size_t expected_size = sizeof(phy_trace_header_t) +
+            (size_t) header->name_count * PHY_TRACE_NAME_LEN +
+            (size_t) header->record_count * sizeof(phy_trace_record_t);
+
+    if (memcmp(header->magic, PHY_TRACE_MAGIC, 4) != 0 || header->version != PHY_TRACE_VERSION ||
+            header->name_count > 0xFFFF || st.st_size < expected_size) {
+
+        rs_error("invalid link trace '%s'", file_name);
+        munmap(data, st.st_size);
+        return FALSE;
+    }
+
+    trace_data = data;
+    trace_size = st.st_size;
+    trace_header = header;
+    trace_record_list = (phy_trace_record_t *) (trace_data + sizeof(phy_trace_header_t) + header->name_count * PHY_TRACE_NAME_LEN);
+    trace_cursor = 0;
+
+    /* resolve the names of the trace against the existing nodes */
+    trace_node_list = malloc(header->name_count * sizeof(node_t *));
+
+    uint16 node_count;
+    node_t **node_list = rs_system_get_node_list_copy(&node_count);
+
+    uint32 i, j;
+    for (i = 0; i < node_count; i++) {
+        node_list[i]->phy_info->trace_index = -1;
+    }
+
+    for (j = 0; j < header->name_count; j++) {
+        char *name = (char *) (trace_data + sizeof(phy_trace_header_t) + j * PHY_TRACE_NAME_LEN);
+        trace_node_list[j] = NULL;
+
+        for (i = 0; i < node_count; i++) {
+            if (strncmp(node_list[i]->phy_info->name, name, PHY_TRACE_NAME_LEN) == 0) {
+                trace_node_list[j] = node_list[i];
+                node_list[i]->phy_info->trace_index = j;
+                break;
+            }
+        }
+
+        if (trace_node_list[j] == NULL) {
+            rs_warn("link trace node '%.16s' does not exist", name);
+        }
+    }
+
+    if (node_list != NULL) {
+        free(node_list);
+    }
+
+    /* whatever holds at the start is in place before the nodes wake up */
+    trace_consume(FALSE);
+
     return TRUE;
 }
 
+void phy_trace_stop()
+{
+    if (trace_data == NULL) {
+        return;
+    }
+
+    munmap(trace_data, trace_size);
+
+    trace_data = NULL;
+    trace_size = 0;
+    trace_header = NULL;
+    trace_record_list = NULL;
+    trace_cursor = 0;
+
+    free(trace_node_list);
+    trace_node_list = NULL;
+
+    free(trace_link_key_list);
+    free(trace_link_quality_list);
+    trace_link_key_list = NULL;
+    trace_link_quality_list = NULL;
+    trace_link_size = 0;
+    trace_link_count = 0;
+}
+
+bool phy_trace_active()
+{
+    return trace_data != NULL;
+}
+
+percent_t phy_trace_get_quality(node_t *src_node, node_t *dst_node)
+{
+    rs_assert(src_node != NULL);
+    rs_assert(dst_node != NULL);
+
+    if (src_node->phy_info->trace_index < 0 || dst_node->phy_info->trace_index < 0) {
+        return 0;
+    }
+
+    percent_t *quality = trace_link_lookup(((uint32) src_node->phy_info->trace_index << 16 | dst_node->phy_info->trace_index) + 1, FALSE);
+
+    return quality != NULL ? *quality : 0;
+}
+
+void phy_update_gains()
+{
+    uint16 i, node_count;
+    node_t **node_list = rs_system_get_node_list_copy(&node_count);
+
+    for (i = 0; i < node_count; i++) {
+        node_t *node = node_list[i];
+
+        if (node->phy_info->link_list != NULL) {
+            free(node->phy_info->link_list);
+        }
+
+        node->phy_info->link_list = NULL;
+        node->phy_info->link_count = 0;
+        node_map_done(&node->phy_info->link_map);
+    }
+
+    for (i = 0; i < node_count; i++) {
+        phy_node_update_gains(node_list[i]);
+    }
+
+    if (node_list != NULL) {
+        free(node_list);
+    }
+}
+
 phy_pdu_t *phy_pdu_create()
 {
     phy_pdu_t *pdu = malloc(sizeof(phy_pdu_t));
 
     pdu->sdu = NULL;
+    pdu->corrupted = FALSE;
+    pdu->duplicate = FALSE;
 
     return pdu;
 }
@@ -104,6 +378,8 @@ phy_pdu_t *phy_pdu_duplicate(phy_pdu_t *pdu)
     phy_pdu_t *new_pdu = malloc(sizeof(phy_pdu_t));
 
     new_pdu->sdu = mac_pdu_duplicate(pdu->sdu);
+    new_pdu->corrupted = FALSE;
+    new_pdu->duplicate = TRUE;
 
     return new_pdu;
 }
@@ -141,8 +417,27 @@ void phy_node_init(node_t *node, char *name, coord_t cx, coord_t cy)
     node->phy_info->neighbor_list = NULL;
     node->phy_info->neighbor_count = 0;
 
+    node->phy_info->neighbor_change_list = NULL;
+    node->phy_info->neighbor_change_count = 0;
+    node->phy_info->neighbor_change_size = 0;
+    node_map_init(&node->phy_info->neighbor_change_map);
+
+    node->phy_info->link_list = NULL;
+    node->phy_info->link_count = 0;
+    node_map_init(&node->phy_info->link_map);
+
+    node->phy_info->reception_heap = NULL;
+    node->phy_info->reception_count = 0;
+    node->phy_info->reception_size = 0;
+
+    phy_node_seed_random(node);
+
     node->phy_info->mobility_list = NULL;
     node->phy_info->mobility_count = 0;
+
+    node->phy_info->mobility_model = NULL;
+
+    node->phy_info->trace_index = -1;
 }
 
 void phy_node_done(node_t *node)
@@ -156,10 +451,29 @@ void phy_node_done(node_t *node)
         if (node->phy_info->neighbor_list != NULL)
             free(node->phy_info->neighbor_list);
 
+        if (node->phy_info->neighbor_change_list != NULL)
+            free(node->phy_info->neighbor_change_list);
+
+        node_map_done(&node->phy_info->neighbor_change_map);
+
+        if (node->phy_info->link_list != NULL)
+            free(node->phy_info->link_list);
+
+        node_map_done(&node->phy_info->link_map);
+
+        if (node->phy_info->reception_heap != NULL)
+            free(node->phy_info->reception_heap);
+
         while (node->phy_info->mobility_count > 0) {
             phy_node_rem_mobility(node, node->phy_info->mobility_count - 1);
         }
 
+        phy_node_set_mobility_model(node, PHY_MOBILITY_MODEL_NONE);
+
+        if (node->phy_info->trace_index >= 0 && trace_node_list != NULL) {
+            trace_node_list[node->phy_info->trace_index] = NULL;
+        }
+
         free(node->phy_info);
         node->phy_info = NULL;
     }
@@ -174,6 +488,12 @@ void phy_node_set_name(node_t *node, const char *name)
         free(node->phy_info->name);
 
     node->phy_info->name = strdup(name);
+
+    /* the shadowing samples are derived from the node names */
+    if (rs_system_has_node(node)) {
+        rs_system_nodes_changed();
+        phy_node_update_gains(node);
+    }
 }
 
 void phy_node_set_coords(node_t* node, coord_t cx, coord_t cy)
@@ -183,6 +503,11 @@ void phy_node_set_coords(node_t* node, coord_t cx, coord_t cy)
     node->phy_info->cx = cx;
     node->phy_info->cy = cy;
 
+    /* a node that isn't in the system yet gets its gains when added */
+    if (rs_system_has_node(node)) {
+        phy_node_update_gains(node);
+    }
+
     if (node->alive) {
         phy_node_update_neighbors(node);
     }
@@ -194,6 +519,12 @@ void phy_node_set_tx_power(node_t* node, percent_t tx_power)
 
     node->phy_info->tx_power = tx_power;
 
+    uint16 i;
+    for (i = 0; i < node->phy_info->link_count; i++) {
+        phy_link_t *link = &node->phy_info->link_list[i];
+        link->delivery_threshold = link_delivery_threshold(node, link->gain);
+    }
+
     if (node->alive) {
         phy_node_update_neighbors(node);
     }
@@ -255,11 +586,54 @@ void phy_node_update_mobility_coords(node_t *node)
     node->phy_info->cy  = node->phy_info->mobility_start_y +
             node->phy_info->mobility_speed * (rs_system->now - node->phy_info->mobility_start_time) * node->phy_info->mobility_sin_alpha;
 
+    phy_node_update_gains(node);
+
     if (node->alive) {
         phy_node_update_neighbors(node);
     }
 }
 
+void phy_node_set_mobility_model(node_t *node, uint8 type)
+{
+    rs_assert(node != NULL);
+    rs_assert(type < PHY_MOBILITY_MODEL_COUNT);
+
+    phy_mobility_model_t *model = node->phy_info->mobility_model;
+
+    if (model != NULL) {
+        rs_system_cancel_event(node, phy_event_change_mobility, &model->leg, NULL, 0);
+        free(model);
+
+        node->phy_info->mobility_model = NULL;
+    }
+
+    if (type == PHY_MOBILITY_MODEL_NONE) {
+        return;
+    }
+
+    model = malloc(sizeof(phy_mobility_model_t));
+
+    model->type = type;
+    model->seed = name_hash(node->phy_info->name, "", PHY_RANDOM_SALT);
+
+    model->speed_min = 1;
+    model->speed_max = 5;
+    model->pause_time = 0;
+    model->alpha = 0.75;
+    model->interval = 1000;
+
+    model->leg.trigger_time = 0;
+    model->leg.duration = 0;
+    model->leg.dest_x = node->phy_info->cx;
+    model->leg.dest_y = node->phy_info->cy;
+
+    node->phy_info->mobility_model = model;
+
+    if (node->alive) {
+        mobility_model_start(node);
+    }
+}
+
 void phy_node_update_neighbors(node_t *node)
 {
     rs_assert(node != NULL);
@@ -281,24 +655,24 @@ void phy_node_update_neighbors(node_t *node)
         /* node to other_node link quality */
         if (rs_system_link_quality_enough(node, other_node)) {
             if (phy_node_add_neighbor(node, other_node)) { /* returns true if the neighbor wasn't present before */
-                rs_system_schedule_event(node, phy_event_neighbor_attach, other_node, NULL, 0);
+                neighbor_change_add(node, other_node, FALSE);
             }
         }
         else {
             if (phy_node_rem_neighbor(node, other_node)) { /* returns true if the neighbor was present before */
-                rs_system_schedule_event(node, phy_event_neighbor_detach, other_node, NULL, 0);
+                neighbor_change_add(node, other_node, TRUE);
             }
         }
 
         /* other_node to node link quality */
         if (rs_system_link_quality_enough(other_node, node)) {
             if (phy_node_add_neighbor(other_node, node)) { /* returns true if the neighbor wasn't present before */
-                rs_system_schedule_event(other_node, phy_event_neighbor_attach, node, NULL, 0);
+                neighbor_change_add(other_node, node, FALSE);
             }
         }
         else {
             if (phy_node_rem_neighbor(other_node, node)) { /* returns true if the neighbor was present before */
-                rs_system_schedule_event(other_node, phy_event_neighbor_detach, node, NULL, 0);
+                neighbor_change_add(other_node, node, TRUE);
             }
         }
     }
@@ -308,6 +682,100 @@ void phy_node_update_neighbors(node_t *node)
     }
 }
 
+void phy_node_update_gains(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    propagation_gain_t gain = propagation_model_list[rs_system->propagation_model].gain;
+
+    uint16 i, node_count;
+    node_t **node_list = rs_system_get_node_list_copy(&node_count);
+
+    for (i = 0; i < node_count; i++) {
+        node_t *other_node = node_list[i];
+
+        if (other_node == node) {
+            continue;
+        }
+
+        coord_t distance = sqrt(
+                pow(node->phy_info->cx - other_node->phy_info->cx, 2) +
+                pow(node->phy_info->cy - other_node->phy_info->cy, 2));
+
+        if (distance <= rs_system->no_link_dist_thresh) {
+            node_set_gain(node, other_node, gain(node, other_node, distance));
+            node_set_gain(other_node, node, gain(other_node, node, distance));
+        }
+        else {
+            phy_node_rem_gain(node, other_node);
+            phy_node_rem_gain(other_node, node);
+        }
+    }
+
+    if (node_list != NULL) {
+        free(node_list);
+    }
+}
+
+percent_t phy_node_get_gain(node_t *node, node_t *dst_node)
+{
+    rs_assert(node != NULL);
+    rs_assert(dst_node != NULL);
+
+    phy_link_t *link = node_find_link(node, dst_node);
+    if (link == NULL) { /* out of range */
+        return 0;
+    }
+
+    return link->gain;
+}
+
+bool phy_node_link_delivers(node_t *node, node_t *dst_node)
+{
+    rs_assert(node != NULL);
+    rs_assert(dst_node != NULL);
+
+    /* a replayed trace overrides the propagation model, even beyond the no-link distance */
+    if (phy_trace_active()) {
+        return phy_node_random(node) < quality_delivery_threshold(phy_trace_get_quality(node, dst_node));
+    }
+
+    phy_link_t *link = node_find_link(node, dst_node);
+    if (link == NULL) {
+        return FALSE;
+    }
+
+    return phy_node_random(node) < link->delivery_threshold;
+}
+
+void phy_node_rem_gain(node_t *node, node_t *dst_node)
+{
+    rs_assert(node != NULL);
+    rs_assert(dst_node != NULL);
+
+    uint16 i = GPOINTER_TO_UINT(node_map_get(&node->phy_info->link_map, dst_node));
+    if (i == 0) {
+        return;
+    }
+
+    i--;
+    node_map_remove(&node->phy_info->link_map, dst_node);
+
+    /* the order of the links is irrelevant, so the last one takes the freed slot */
+    node->phy_info->link_list[i] = node->phy_info->link_list[--node->phy_info->link_count];
+    if (i < node->phy_info->link_count) {
+        node_map_put(&node->phy_info->link_map, node->phy_info->link_list[i].node, GUINT_TO_POINTER(i + 1));
+    }
+
+    if (node->phy_info->link_count == 0) {
+        free(node->phy_info->link_list);
+        node->phy_info->link_list = NULL;
+    }
+    else {
+        node->phy_info->link_list = realloc(node->phy_info->link_list, node->phy_info->link_count * sizeof(phy_link_t));
+    }
+}
+
 bool phy_node_send(node_t *node, node_t *outgoing_node, void *sdu)
 {
     rs_assert(node != NULL);
@@ -330,6 +798,21 @@ bool phy_node_receive(node_t *node, node_t *incoming_node, phy_pdu_t *pdu)
     rs_assert(node != NULL);
     rs_assert(pdu != NULL);
 
+    if (pdu->corrupted) {
+        rs_debug(DEBUG_PHY, "node '%s': frame from '%s' collided, dropping it", node->phy_info->name, incoming_node->phy_info->name);
+
+        measure_node_add_collision(node);
+
+        /* only a unicast receiver gets the original, which the sender destroys when no ACK comes */
+        if (!pdu->duplicate) {
+            pdu->sdu = NULL;
+        }
+
+        phy_pdu_destroy(pdu);
+
+        return TRUE;
+    }
+
     bool all_ok = event_execute(phy_event_pdu_receive, node, incoming_node, pdu);
 
     phy_pdu_destroy(pdu);
@@ -337,6 +820,110 @@ bool phy_node_receive(node_t *node, node_t *incoming_node, phy_pdu_t *pdu)
     return all_ok;
 }
 
+void phy_node_seed_random(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    if (rs_system->deterministic_random) {
+        node->phy_info->random_z = name_hash(node->phy_info->name, "z", PHY_RANDOM_SALT) | 1;
+        node->phy_info->random_w = name_hash(node->phy_info->name, "w", PHY_RANDOM_SALT) | 1;
+    }
+    else {
+        node->phy_info->random_z = rand() | 1;
+        node->phy_info->random_w = rand() | 1;
+    }
+}
+
+uint32 phy_node_random(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    node->phy_info->random_z = 36969 * (node->phy_info->random_z & 0xFFFF) + (node->phy_info->random_z >> 16);
+    node->phy_info->random_w = 18000 * (node->phy_info->random_w & 0xFFFF) + (node->phy_info->random_w >> 16);
+
+    return (node->phy_info->random_z << 16) + node->phy_info->random_w;
+}
+
+bool phy_node_add_reception(node_t *node, phy_pdu_t *pdu)
+{
+    rs_assert(node != NULL);
+
+    phy_reception_t *heap = node->phy_info->reception_heap;
+    bool collided = FALSE;
+    uint16 i, child;
+
+    /* forget about the receptions that already ended */
+    while (node->phy_info->reception_count > 0 && heap[0].end_time <= rs_system->now) {
+        phy_reception_t last = heap[--node->phy_info->reception_count];
+
+        i = 0;
+        while ((child = 2 * i + 1) < node->phy_info->reception_count) {
+            if (child + 1 < node->phy_info->reception_count && heap[child + 1].end_time < heap[child].end_time) {
+                child++;
+            }
+            if (last.end_time <= heap[child].end_time) {
+                break;
+            }
+
+            heap[i] = heap[child];
+            i = child;
+        }
+
+        heap[i] = last;
+    }
+
+    /* all the receptions left in progress contain the current moment, so they overlap each other;
+     * when more than one is left, they have all been marked already */
+    if (node->phy_info->reception_count > 0) {
+        collided = TRUE;
+
+        if (pdu != NULL) {
+            pdu->corrupted = TRUE;
+        }
+
+        if (node->phy_info->reception_count == 1 && heap[0].pdu != NULL) {
+            heap[0].pdu->corrupted = TRUE;
+        }
+    }
+
+    if (node->phy_info->reception_count == node->phy_info->reception_size) {
+        node->phy_info->reception_size = node->phy_info->reception_size > 0 ? 2 * node->phy_info->reception_size : 4;
+        node->phy_info->reception_heap = realloc(node->phy_info->reception_heap, node->phy_info->reception_size * sizeof(phy_reception_t));
+        heap = node->phy_info->reception_heap;
+    }
+
+    phy_reception_t reception;
+    reception.end_time = rs_system->now + rs_system->transmission_time;
+    reception.pdu = pdu;
+
+    i = node->phy_info->reception_count++;
+    while (i > 0 && heap[(i - 1) / 2].end_time > reception.end_time) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    heap[i] = reception;
+
+    return collided;
+}
+
+sim_time_t phy_node_get_channel_free_time(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    /* the receptions are only tracked when collisions are enabled, the channel always looks idle otherwise */
+    sim_time_t free_time = rs_system->now;
+
+    uint16 i;
+    for (i = 0; i < node->phy_info->reception_count; i++) {
+        if (node->phy_info->reception_heap[i].end_time > free_time) {
+            free_time = node->phy_info->reception_heap[i].end_time;
+        }
+    }
+
+    return free_time;
+}
+
 bool phy_node_add_neighbor(node_t* node, node_t* neighbor_node)
 {
     rs_assert(node != NULL);
@@ -397,6 +984,28 @@ bool phy_node_has_neighbor(node_t* node, node_t *neighbor_node)
     return FALSE;
 }
 
+void phy_node_rem_neighbor_change(node_t *node, node_t *neighbor_node)
+{
+    rs_assert(node != NULL);
+    rs_assert(neighbor_node != NULL);
+
+    uint16 pos = GPOINTER_TO_UINT(node_map_get(&node->phy_info->neighbor_change_map, neighbor_node));
+    if (pos == 0) {
+        return;
+    }
+
+    node_map_remove(&node->phy_info->neighbor_change_map, neighbor_node);
+
+    /* the order of the notifications doesn't matter, move the last one into the freed slot */
+    node->phy_info->neighbor_change_count--;
+    if (pos - 1 < node->phy_info->neighbor_change_count) {
+        phy_neighbor_change_t *moved = &node->phy_info->neighbor_change_list[pos - 1];
+
+        *moved = node->phy_info->neighbor_change_list[node->phy_info->neighbor_change_count];
+        node_map_put(&node->phy_info->neighbor_change_map, moved->neighbor_node, GUINT_TO_POINTER(pos));
+    }
+}
+
 
     /**** local functions ****/
 
@@ -412,6 +1021,10 @@ static bool event_handler_node_wake(node_t *node)
         rs_system_schedule_event(node, phy_event_change_mobility, mobility, NULL, mobility->trigger_time);
     }
 
+    if (node->phy_info->mobility_model != NULL) {
+        mobility_model_start(node);
+    }
+
     return TRUE;
 }
 
@@ -441,6 +1054,20 @@ static bool event_handler_node_kill(node_t *node)
     node->phy_info->neighbor_list = NULL;
     node->phy_info->neighbor_count = 0;
 
+    /* a dead node isn't notified about its neighbors anymore */
+    rs_system_cancel_event(node, phy_event_neighbors_update, NULL, NULL, 0);
+    if (node->phy_info->neighbor_change_list != NULL) {
+        free(node->phy_info->neighbor_change_list);
+    }
+
+    node->phy_info->neighbor_change_list = NULL;
+    node->phy_info->neighbor_change_count = 0;
+    node->phy_info->neighbor_change_size = 0;
+    node_map_done(&node->phy_info->neighbor_change_map);
+
+    /* whatever was in flight towards this node is lost */
+    node->phy_info->reception_count = 0;
+
     return TRUE;
 }
 
@@ -471,13 +1098,61 @@ static bool event_handler_neighbor_detach(node_t *node, node_t *neighbor_node)
     return TRUE;
 }
 
+static bool event_handler_neighbors_update(node_t *node)
+{
+    /* detach the list first, the handlers below may queue changes for the next pass */
+    phy_neighbor_change_t *change_list = node->phy_info->neighbor_change_list;
+    uint16 change_count = node->phy_info->neighbor_change_count;
+    node_map_t change_map = node->phy_info->neighbor_change_map;
+
+    node->phy_info->neighbor_change_list = NULL;
+    node->phy_info->neighbor_change_count = 0;
+    node->phy_info->neighbor_change_size = 0;
+    node_map_init(&node->phy_info->neighbor_change_map);
+
+    uint16 i;
+    for (i = 0; i < change_count; i++) {
+        node_t *neighbor_node = change_list[i].neighbor_node;
+        bool is_neighbor = phy_node_has_neighbor(node, neighbor_node);
+
+        if (is_neighbor == change_list[i].was_neighbor) { /* the link flapped back within the step */
+            continue;
+        }
+
+        if (is_neighbor) {
+            event_execute(phy_event_neighbor_attach, node, neighbor_node, NULL);
+        }
+        else {
+            event_execute(phy_event_neighbor_detach, node, neighbor_node, NULL);
+        }
+    }
+
+    if (change_list != NULL) {
+        free(change_list);
+    }
+
+    node_map_done(&change_map);
+
+    return TRUE;
+}
+
 static bool event_handler_change_mobility(node_t *node, phy_mobility_t *mobility)
 {
+    /* procedural legs are generated only when the previous one ends */
+    bool procedural = (node->phy_info->mobility_model != NULL && mobility == &node->phy_info->mobility_model->leg);
+    sim_time_t next_leg_delay = 0;
+
+    if (procedural) {
+        next_leg_delay = mobility_model_next_leg(node);
+    }
+
     if (mobility->duration == 0) { /* instant position change */
         node->phy_info->mobility_speed = 0;
         node->phy_info->cx = mobility->dest_x;
         node->phy_info->cy = mobility->dest_y;
 
+        phy_node_update_gains(node);
+
         if (node->alive) {
             phy_node_update_neighbors(node);
         }
@@ -494,6 +1169,21 @@ static bool event_handler_change_mobility(node_t *node, phy_mobility_t *mobility
         node->phy_info->mobility_speed = dist / mobility->duration;
     }
 
+    if (procedural && next_leg_delay > 0) { /* a zero delay means the model is stalled for good */
+        rs_system_schedule_event(node, phy_event_change_mobility, mobility, NULL, next_leg_delay);
+    }
+
+    return TRUE;
+}
+
+static bool event_handler_trace_advance(node_t *node)
+{
+    if (trace_data == NULL) {
+        return TRUE;
+    }
+
+    trace_consume(TRUE);
+
     return TRUE;
 }
 
@@ -529,3 +1219,383 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
                 mobility->duration, mobility->dest_x, mobility->dest_y);
     }
 }
+
+static percent_t linear_gain(node_t *src_node, node_t *dst_node, coord_t distance)
+{
+    return (percent_t) (rs_system->no_link_dist_thresh - distance) / rs_system->no_link_dist_thresh;
+}
+
+static percent_t log_distance_gain(node_t *src_node, node_t *dst_node, coord_t distance)
+{
+    /* path loss in dB relative to the reference distance,
+     * normalized by the loss at the no-link distance threshold */
+    double max_loss = 10 * rs_system->path_loss_exponent * log10(rs_system->no_link_dist_thresh / PHY_LOG_DISTANCE_REF_DIST);
+    double loss = 0;
+
+    if (distance > PHY_LOG_DISTANCE_REF_DIST) {
+        loss = 10 * rs_system->path_loss_exponent * log10(distance / PHY_LOG_DISTANCE_REF_DIST);
+    }
+
+    /* static log-normal shadowing, identical in both directions */
+    if (rs_system->shadowing_deviation > 0) {
+        if (strcmp(src_node->phy_info->name, dst_node->phy_info->name) < 0) {
+            loss += rs_system->shadowing_deviation * pair_normal_sample(src_node->phy_info->name, dst_node->phy_info->name, PHY_SHADOWING_SALT);
+        }
+        else {
+            loss += rs_system->shadowing_deviation * pair_normal_sample(dst_node->phy_info->name, src_node->phy_info->name, PHY_SHADOWING_SALT);
+        }
+    }
+
+    /* per-direction term, making the link asymmetric */
+    if (rs_system->asymmetry_deviation > 0) {
+        loss += rs_system->asymmetry_deviation * pair_normal_sample(src_node->phy_info->name, dst_node->phy_info->name, PHY_ASYMMETRY_SALT);
+    }
+
+    if (max_loss <= 0) {
+        return 1.0;
+    }
+
+    double gain = 1 - loss / max_loss;
+    if (gain < 0) {
+        gain = 0;
+    }
+    else if (gain > 1) {
+        gain = 1;
+    }
+
+    return gain;
+}
+
+static percent_t unit_disk_gain(node_t *src_node, node_t *dst_node, coord_t distance)
+{
+    return 1.0;
+}
+
+static double pair_normal_sample(char *name1, char *name2, uint32 salt)
+{
+    /* a deterministic standard normal sample derived from an ordered pair of names */
+    uint32 hash = name_hash(name1, name2, salt);
+
+    uint32 z = 36969 * (hash & 0xFFFF) + (hash >> 16);
+    uint32 w = 18000 * ((hash >> 8) & 0xFFFF) + (hash >> 24) + 1;
+    z = 36969 * (z & 0xFFFF) + (z >> 16);
+    w = 18000 * (w & 0xFFFF) + (w >> 16);
+
+    double u1 = (((z << 16) + w) + 1.0) / 4294967297.0;
+    z = 36969 * (z & 0xFFFF) + (z >> 16);
+    w = 18000 * (w & 0xFFFF) + (w >> 16);
+    double u2 = ((z << 16) + w) / 4294967296.0;
+
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static phy_link_t *node_find_link(node_t *node, node_t *dst_node)
+{
+    /* positions rather than pointers are mapped, the list moves when it grows */
+    uint16 pos = GPOINTER_TO_UINT(node_map_get(&node->phy_info->link_map, dst_node));
+    if (pos == 0) {
+        return NULL;
+    }
+
+    return &node->phy_info->link_list[pos - 1];
+}
+
+static void node_set_gain(node_t *node, node_t *dst_node, percent_t gain)
+{
+    phy_link_t *link = node_find_link(node, dst_node);
+
+    if (link == NULL) {
+        node->phy_info->link_list = realloc(node->phy_info->link_list, (node->phy_info->link_count + 1) * sizeof(phy_link_t));
+        link = &node->phy_info->link_list[node->phy_info->link_count++];
+        link->node = dst_node;
+
+        node_map_put(&node->phy_info->link_map, dst_node, GUINT_TO_POINTER(node->phy_info->link_count));
+    }
+
+    link->gain = gain;
+    link->delivery_threshold = link_delivery_threshold(node, gain);
+}
+
+static void neighbor_change_add(node_t *node, node_t *neighbor_node, bool was_neighbor)
+{
+    if (node_map_get(&node->phy_info->neighbor_change_map, neighbor_node) != NULL) { /* keep the state from the step's start */
+        return;
+    }
+
+    /* a single notification pass per node and time step, no matter how many links changed */
+    if (node->phy_info->neighbor_change_count == 0) {
+        rs_system_schedule_event(node, phy_event_neighbors_update, NULL, NULL, 0);
+    }
+
+    if (node->phy_info->neighbor_change_count == node->phy_info->neighbor_change_size) {
+        node->phy_info->neighbor_change_size = node->phy_info->neighbor_change_size > 0 ? 2 * node->phy_info->neighbor_change_size : 4;
+        node->phy_info->neighbor_change_list = realloc(node->phy_info->neighbor_change_list, node->phy_info->neighbor_change_size * sizeof(phy_neighbor_change_t));
+    }
+
+    node->phy_info->neighbor_change_list[node->phy_info->neighbor_change_count].neighbor_node = neighbor_node;
+    node->phy_info->neighbor_change_list[node->phy_info->neighbor_change_count].was_neighbor = was_neighbor;
+    node->phy_info->neighbor_change_count++;
+
+    node_map_put(&node->phy_info->neighbor_change_map, neighbor_node, GUINT_TO_POINTER(node->phy_info->neighbor_change_count));
+}
+
+static uint32 link_delivery_threshold(node_t *node, percent_t gain)
+{
+    return quality_delivery_threshold(node->phy_info->tx_power * gain);
+}
+
+static uint32 quality_delivery_threshold(percent_t quality)
+{
+    /* logistic packet reception ratio, centered on the no-link quality threshold */
+    double prr = 1.0 / (1.0 + exp(-rs_system->prr_steepness * (quality - rs_system->no_link_quality_thresh)));
+
+    if (prr >= 1.0) {
+        return 0xFFFFFFFF;
+    }
+
+    return (uint32) (prr * 4294967295.0);
+}
+
+static uint32 name_hash(char *name1, char *name2, uint32 salt)
+{
+    uint32 hash = 5381 ^ salt;
+
+    while (*name1) {
+        hash = hash * 33 + (uint8) *name1++;
+    }
+
+    hash = hash * 33 + '/';
+
+    while (*name2) {
+        hash = hash * 33 + (uint8) *name2++;
+    }
+
+    return hash;
+}
+
+static void mobility_model_start(node_t *node)
+{
+    phy_mobility_model_t *model = node->phy_info->mobility_model;
+
+    model->random_z = 36969 * (model->seed & 0xFFFF) + (model->seed >> 16) + 1;
+    model->random_w = 18000 * ((model->seed >> 8) & 0xFFFF) + (model->seed >> 24) + 1;
+
+    model->speed = (model->speed_min + model->speed_max) / 2;
+    model->direction = 2 * M_PI * mobility_model_uniform(model);
+    model->mean_direction = model->direction;
+
+    rs_system_cancel_event(node, phy_event_change_mobility, &model->leg, NULL, 0);
+    rs_system_schedule_event(node, phy_event_change_mobility, &model->leg, NULL, 0);
+}
+
+static sim_time_t mobility_model_next_leg(node_t *node)
+{
+    phy_mobility_model_t *model = node->phy_info->mobility_model;
+    coord_t cx = node->phy_info->cx;
+    coord_t cy = node->phy_info->cy;
+    sim_time_t delay;
+
+    model->leg.trigger_time = rs_system->now;
+
+    switch (model->type) {
+
+        case PHY_MOBILITY_MODEL_RANDOM_WAYPOINT: {
+            double speed = model->speed_min + (model->speed_max - model->speed_min) * mobility_model_uniform(model);
+            coord_t dest_x = rs_system->width * mobility_model_uniform(model);
+            coord_t dest_y = rs_system->height * mobility_model_uniform(model);
+
+            if (speed > 0) {
+                double dist = sqrt(pow(dest_x - cx, 2) + pow(dest_y - cy, 2));
+
+                model->leg.dest_x = dest_x;
+                model->leg.dest_y = dest_y;
+                model->leg.duration = dist / speed * 1000;
+            }
+            else {
+                model->leg.dest_x = cx;
+                model->leg.dest_y = cy;
+                model->leg.duration = 0;
+            }
+
+            if (model->leg.duration == 0) { /* an instant change would be a jump */
+                model->leg.dest_x = cx;
+                model->leg.dest_y = cy;
+            }
+
+            delay = model->leg.duration + model->pause_time;
+
+            if (model->speed_max <= 0 && model->pause_time <= 0) { /* the node would never move nor pause */
+                delay = 0;
+            }
+            else if (delay < 1) { /* never schedule the next leg for the current moment */
+                delay = 1;
+            }
+
+            break;
+        }
+
+        case PHY_MOBILITY_MODEL_GAUSS_MARKOV: {
+            double mean_speed = (model->speed_min + model->speed_max) / 2;
+            double speed_dev = (model->speed_max - model->speed_min) / 2;
+            double memory = sqrt(1 - model->alpha * model->alpha);
+
+            /* steer back towards the center when getting close to the borders */
+            if (cx < PHY_GAUSS_MARKOV_BORDER_MARGIN * rs_system->width ||
+                    cx > (1 - PHY_GAUSS_MARKOV_BORDER_MARGIN) * rs_system->width ||
+                    cy < PHY_GAUSS_MARKOV_BORDER_MARGIN * rs_system->height ||
+                    cy > (1 - PHY_GAUSS_MARKOV_BORDER_MARGIN) * rs_system->height) {
+
+                model->mean_direction = atan2(rs_system->height / 2 - cy, rs_system->width / 2 - cx);
+            }
+
+            model->speed = model->alpha * model->speed + (1 - model->alpha) * mean_speed + memory * speed_dev * mobility_model_normal(model);
+            /* blend along the shortest arc, the angles wrap around at +/- pi */
+            double direction_diff = atan2(sin(model->mean_direction - model->direction), cos(model->mean_direction - model->direction));
+
+            model->direction += (1 - model->alpha) * direction_diff + memory * PHY_GAUSS_MARKOV_DIRECTION_DEV * mobility_model_normal(model);
+
+            if (model->speed < 0) {
+                model->speed = 0;
+            }
+
+            double dist = model->speed * model->interval / 1000;
+            coord_t dest_x = cx + dist * cos(model->direction);
+            coord_t dest_y = cy + dist * sin(model->direction);
+
+            if (dest_x < 0) dest_x = 0;
+            if (dest_x > rs_system->width) dest_x = rs_system->width;
+            if (dest_y < 0) dest_y = 0;
+            if (dest_y > rs_system->height) dest_y = rs_system->height;
+
+            model->leg.dest_x = dest_x;
+            model->leg.dest_y = dest_y;
+            model->leg.duration = model->interval;
+
+            delay = model->interval > 0 ? model->interval : 0;
+
+            break;
+        }
+
+        default:
+            model->leg.dest_x = cx;
+            model->leg.dest_y = cy;
+            model->leg.duration = 0;
+
+            delay = 0;
+    }
+
+    return delay;
+}
+
+static double mobility_model_uniform(phy_mobility_model_t *model)
+{
+    model->random_z = 36969 * (model->random_z & 0xFFFF) + (model->random_z >> 16);
+    model->random_w = 18000 * (model->random_w & 0xFFFF) + (model->random_w >> 16);
+
+    return ((model->random_z << 16) + model->random_w) / 4294967296.0;
+}
+
+static double mobility_model_normal(phy_mobility_model_t *model)
+{
+    double u1 = 1.0 - mobility_model_uniform(model); /* avoid log(0) */
+    double u2 = mobility_model_uniform(model);
+
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static void trace_consume(bool notify)
+{
+    while (trace_cursor < trace_header->record_count && trace_record_list[trace_cursor].time <= rs_system->now) {
+        phy_trace_record_t *record = &trace_record_list[trace_cursor++];
+
+        if (record->src >= trace_header->name_count || record->dst >= trace_header->name_count) {
+            continue;
+        }
+
+        percent_t *quality = trace_link_lookup(((uint32) record->src << 16 | record->dst) + 1, TRUE);
+        bool was_enough = (*quality >= rs_system->no_link_quality_thresh);
+        bool is_enough = (record->quality >= rs_system->no_link_quality_thresh);
+
+        *quality = record->quality;
+
+        /* the neighbor lists only change when a link crosses the threshold */
+        node_t *src_node = trace_node_list[record->src];
+        node_t *dst_node = trace_node_list[record->dst];
+
+        if (!notify || was_enough == is_enough || src_node == NULL || dst_node == NULL) {
+            continue;
+        }
+
+        if (!src_node->alive || !dst_node->alive) {
+            continue;
+        }
+
+        if (is_enough) {
+            if (phy_node_add_neighbor(src_node, dst_node)) {
+                neighbor_change_add(src_node, dst_node, FALSE);
+            }
+        }
+        else {
+            if (phy_node_rem_neighbor(src_node, dst_node)) {
+                neighbor_change_add(src_node, dst_node, TRUE);
+            }
+        }
+    }
+
+    if (trace_cursor < trace_header->record_count) {
+        rs_system_schedule_event(NULL, phy_event_trace_advance, NULL, NULL, trace_record_list[trace_cursor].time - rs_system->now);
+    }
+}
+
+static percent_t *trace_link_lookup(uint32 key, bool create)
+{
+    uint32 i;
+
+    if (create && 2 * (trace_link_count + 1) > trace_link_size) { /* keep the load under one half */
+        uint32 old_size = trace_link_size;
+        uint32 *old_key_list = trace_link_key_list;
+        percent_t *old_quality_list = trace_link_quality_list;
+
+        trace_link_size = old_size > 0 ? 2 * old_size : 1024;
+        trace_link_key_list = calloc(trace_link_size, sizeof(uint32));
+        trace_link_quality_list = malloc(trace_link_size * sizeof(percent_t));
+
+        for (i = 0; i < old_size; i++) {
+            if (old_key_list[i] != 0) {
+                uint32 pos = (old_key_list[i] * 2654435761U) & (trace_link_size - 1);
+                while (trace_link_key_list[pos] != 0) {
+                    pos = (pos + 1) & (trace_link_size - 1);
+                }
+
+                trace_link_key_list[pos] = old_key_list[i];
+                trace_link_quality_list[pos] = old_quality_list[i];
+            }
+        }
+
+        free(old_key_list);
+        free(old_quality_list);
+    }
+
+    if (trace_link_size == 0) {
+        return NULL;
+    }
+
+    uint32 pos = (key * 2654435761U) & (trace_link_size - 1);
+    while (trace_link_key_list[pos] != 0) {
+        if (trace_link_key_list[pos] == key) {
+            return &trace_link_quality_list[pos];
+        }
+
+        pos = (pos + 1) & (trace_link_size - 1);
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    trace_link_key_list[pos] = key;
+    trace_link_quality_list[pos] = 0;
+    trace_link_count++;
+
+    return &trace_link_quality_list[pos];
+}
@@ -24,6 +24,51 @@
 #include "../base.h"
 #include "../node.h"
 
+#define PHY_PROPAGATION_MODEL_LINEAR            0
+#define PHY_PROPAGATION_MODEL_LOG_DISTANCE      1
+#define PHY_PROPAGATION_MODEL_UNIT_DISK         2
+
+#define PHY_PROPAGATION_MODEL_COUNT             3
+
+#define PHY_LOG_DISTANCE_REF_DIST               1.0
+#define PHY_SHADOWING_SALT                      0x5AD0
+#define PHY_ASYMMETRY_SALT                      0xA53E
+#define PHY_RANDOM_SALT                         0x2A9D
+
+#define PHY_MOBILITY_MODEL_NONE                 0
+#define PHY_MOBILITY_MODEL_RANDOM_WAYPOINT      1
+#define PHY_MOBILITY_MODEL_GAUSS_MARKOV         2
+
+#define PHY_MOBILITY_MODEL_COUNT                3
+
+#define PHY_GAUSS_MARKOV_DIRECTION_DEV          (M_PI / 4)
+#define PHY_GAUSS_MARKOV_BORDER_MARGIN          0.1 /* fraction of the field size */
+
+#define PHY_TRACE_MAGIC                         "RSLT"
+#define PHY_TRACE_VERSION                       1
+#define PHY_TRACE_NAME_LEN                      16
+
+
+    /* link trace file layout: a header, header.name_count node names of PHY_TRACE_NAME_LEN bytes each,
+     * then header.record_count records, sorted by time */
+typedef struct phy_trace_header_t {
+
+    char                magic[4];
+    uint32              version;
+    uint32              name_count;
+    uint32              record_count;
+
+} phy_trace_header_t;
+
+typedef struct phy_trace_record_t {
+
+    int32               time;
+    uint16              src;                /* indexes in the name table */
+    uint16              dst;
+    float               quality;
+
+} phy_trace_record_t;
+
 
 typedef struct phy_mobility_t {
 
@@ -34,6 +79,63 @@ typedef struct phy_mobility_t {
 
 } phy_mobility_t;
 
+    /* a procedural mobility model, generating one leg at a time */
+typedef struct phy_mobility_model_t {
+
+    uint8               type;
+    uint32              seed;
+
+    coord_t             speed_min;          /* units per second */
+    coord_t             speed_max;
+    sim_time_t          pause_time;         /* random waypoint */
+    float               alpha;              /* gauss-markov memory, 0 to 1 */
+    sim_time_t          interval;           /* gauss-markov leg duration */
+
+    /* state */
+    phy_mobility_t      leg;
+    uint32              random_z;
+    uint32              random_w;
+    double              speed;
+    double              direction;
+    double              mean_direction;
+
+} phy_mobility_model_t;
+
+    /* fields contained in a PHY message */
+typedef struct phy_pdu_t {
+
+    void *              sdu;
+
+    bool                corrupted;  /* overlapped by another transmission */
+    bool                duplicate;  /* owned entirely by its receiver */
+
+} phy_pdu_t;
+
+    /* a reception in progress, as seen by the receiver */
+typedef struct phy_reception_t {
+
+    sim_time_t          end_time;
+    phy_pdu_t *         pdu;        /* NULL for transmissions that only interfere */
+
+} phy_reception_t;
+
+    /* a precomputed, tx power independent gain towards a node within range */
+typedef struct phy_link_t {
+
+    node_t *            node;
+    percent_t           gain;
+    uint32              delivery_threshold; /* a random draw below it means the frame is received */
+
+} phy_link_t;
+
+    /* a neighbor whose link crossed the quality threshold during the current time step */
+typedef struct phy_neighbor_change_t {
+
+    node_t *            neighbor_node;
+    bool                was_neighbor;       /* the state before the first change in this step */
+
+} phy_neighbor_change_t;
+
 
     /* info that a node supporting PHY layer should store */
 typedef struct phy_node_info_t {
@@ -57,18 +159,33 @@ typedef struct phy_node_info_t {
     node_t **           neighbor_list;
     uint16              neighbor_count;
 
+        /* attach/detach notifications pending until the end of the time step */
+    phy_neighbor_change_t *neighbor_change_list;
+    uint16              neighbor_change_count;
+    uint16              neighbor_change_size;
+    node_map_t          neighbor_change_map; /* neighbor node to position in neighbor_change_list + 1 */
+
+    phy_link_t *        link_list;
+    uint16              link_count;
+    node_map_t          link_map;           /* destination node to position in link_list + 1 */
+
+    uint32              random_z;
+    uint32              random_w;
+
+        /* in-flight receptions, a min-heap on end time */
+    phy_reception_t *   reception_heap;
+    uint16              reception_count;
+    uint16              reception_size;
+
     phy_mobility_t **   mobility_list;
     uint16              mobility_count;
 
-} phy_node_info_t;
+    phy_mobility_model_t *mobility_model;
 
+    int32               trace_index;        /* position in the link trace name table, -1 if absent */
 
-    /* fields contained in a PHY message */
-typedef struct phy_pdu_t {
+} phy_node_info_t;
 
-    void *              sdu;
-
-} phy_pdu_t;
 
 
 extern uint16           phy_event_node_wake;
@@ -79,13 +196,28 @@ extern uint16           phy_event_pdu_receive;
 
 extern uint16           phy_event_neighbor_attach;
 extern uint16           phy_event_neighbor_detach;
+extern uint16           phy_event_neighbors_update;
 
 extern uint16           phy_event_change_mobility;
 
+extern uint16           phy_event_trace_advance;
+
 
 bool                    phy_init();
 bool                    phy_done();
 
+char *                  phy_mobility_model_get_name(uint8 type);
+int8                    phy_mobility_model_find_by_name(char *name);
+
+char *                  phy_propagation_model_get_name(uint8 model);
+int8                    phy_propagation_model_find_by_name(char *name);
+void                    phy_update_gains();
+
+bool                    phy_trace_start(char *file_name);
+void                    phy_trace_stop();
+bool                    phy_trace_active();
+percent_t               phy_trace_get_quality(node_t *src_node, node_t *dst_node);
+
 phy_pdu_t *             phy_pdu_create();
 void                    phy_pdu_destroy(phy_pdu_t *pdu);
 phy_pdu_t *             phy_pdu_duplicate(phy_pdu_t *pdu);
@@ -100,13 +232,24 @@ void                    phy_node_set_tx_power(node_t* node, percent_t tw_power);
 void                    phy_node_add_mobility(node_t *node, sim_time_t trigger_time, sim_time_t duration, coord_t dest_x, coord_t dest_y);
 void                    phy_node_rem_mobility(node_t *node, uint16 index);
 void                    phy_node_update_mobility_coords(node_t *node);
+void                    phy_node_set_mobility_model(node_t *node, uint8 type);
 void                    phy_node_update_neighbors(node_t *node);
+void                    phy_node_update_gains(node_t *node);
+percent_t               phy_node_get_gain(node_t *node, node_t *dst_node);
+bool                    phy_node_link_delivers(node_t *node, node_t *dst_node);
+void                    phy_node_rem_gain(node_t *node, node_t *dst_node);
 
 bool                    phy_node_send(node_t *node, node_t *outgoing_node, void *sdu);
 bool                    phy_node_receive(node_t *node, node_t *incoming_node, phy_pdu_t *pdu);
+bool                    phy_node_add_reception(node_t *node, phy_pdu_t *pdu);
+sim_time_t              phy_node_get_channel_free_time(node_t *node);
+
+void                    phy_node_seed_random(node_t *node);
+uint32                  phy_node_random(node_t *node);
 
 bool                    phy_node_add_neighbor(node_t* node, node_t* neighbor_node);
 bool                    phy_node_rem_neighbor(node_t* node, node_t *neighbor_node);
 bool                    phy_node_has_neighbor(node_t* node, node_t *neighbor_node);
+void                    phy_node_rem_neighbor_change(node_t *node, node_t *neighbor_node);
 
 #endif /* PHY_H_ */
@@ -25,11 +25,23 @@
 
 
 
+    /* an objective function computes the rank increase through a candidate neighbor;
+     * it is evaluated for every DIO heard from a candidate, so it only looks up cached link metrics */
+typedef uint16 (*rpl_of_rank_increase_t)(node_t *node, rpl_neighbor_t *neighbor);
+
+typedef struct rpl_of_t {
+
+    char *                  name;
+    rpl_of_rank_increase_t  rank_increase;
+
+} rpl_of_t;
+
     /* used to coordinate the sequence numbers when multiple roots share the same DODAG id */
 typedef struct seq_num_mapping_t {
 
+    uint32                  key;        /* the interned dodag id + 1, 0 marks a free slot */
     uint8                   seq_num;
-    char *                  dodag_id;
+    uint16                  ref_count;  /* the roots of this dodag id */
 
 } seq_num_mapping_t;
 
@@ -50,6 +62,7 @@ uint16                      rpl_event_dao_pdu_receive;
 uint16                      rpl_event_neighbor_attach;
 uint16                      rpl_event_neighbor_detach;
 uint16				        rpl_event_new_pref_parent;
+uint16                      rpl_event_loop_detected;
 
 uint16                      rpl_event_forward_failure;
 uint16                      rpl_event_forward_inconsistency;
@@ -61,8 +74,13 @@ uint16                      rpl_event_dao_timeout_check;
 
 uint16                      rpl_event_seq_num_autoinc;
 
-static seq_num_mapping_t ** seq_num_mapping_list = NULL;
-static uint16               seq_num_mapping_count = 0;
+static seq_num_mapping_t *  seq_num_mapping_table = NULL;  /* open addressing, a power of 2, at most half full */
+static uint32               seq_num_mapping_size = 0;
+static uint32               seq_num_mapping_count = 0;
+
+static node_t **            tree_queue = NULL;     /* scratch space for relabeling a subtree */
+static uint32               tree_queue_size = 0;
+static uint32               tree_stamp = 0;
 
 
     /**** local function prototypes ****/
@@ -70,16 +88,17 @@ static uint16               seq_num_mapping_count = 0;
 static bool                 event_handler_node_wake(node_t *node);
 static bool                 event_handler_node_kill(node_t *node);
 
-static bool                 event_handler_dis_pdu_send(node_t *node, char *dst_ip_address);
+static bool                 event_handler_dis_pdu_send(node_t *node, address_t dst_address);
 static bool                 event_handler_dis_pdu_receive(node_t *node, node_t *incoming_node);
-static bool                 event_handler_dio_pdu_send(node_t *node, char *dst_ip_address, rpl_dio_pdu_t *pdu);
+static bool                 event_handler_dio_pdu_send(node_t *node, address_t dst_address, rpl_dio_pdu_t *pdu);
 static bool                 event_handler_dio_pdu_receive(node_t *node, node_t *incoming_node, rpl_dio_pdu_t *pdu);
-static bool                 event_handler_dao_pdu_send(node_t *node, char *dst_ip_address, rpl_dao_pdu_t *pdu);
+static bool                 event_handler_dao_pdu_send(node_t *node, address_t dst_address, rpl_dao_pdu_t *pdu);
 static bool                 event_handler_dao_pdu_receive(node_t *node, node_t *incoming_node, rpl_dao_pdu_t *pdu);
 
 static bool                 event_handler_neighbor_attach(node_t *node, node_t *neighbor_node);
 static bool                 event_handler_neighbor_detach(node_t *node, node_t *neighbor_node);
 static bool                 event_handler_new_pref_parent(node_t *node, node_t *pref_parent);
+static bool                 event_handler_loop_detected(node_t *node, node_t *pref_parent);
 
 static bool                 event_handler_forward_failure(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu);
 static bool                 event_handler_forward_inconsistency(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu);
@@ -91,21 +110,39 @@ static bool                 event_handler_dao_timeout_check(node_t *node, ip_rou
 
 static bool                 event_handler_seq_num_autoinc();
 
-static seq_num_mapping_t *  seq_num_mapping_get(char *dodag_id);
-static void                 seq_num_mapping_cleanup();
+static seq_num_mapping_t *  seq_num_mapping_find(address_t dodag_id);
+static void                 seq_num_mapping_acquire(address_t dodag_id);
+static void                 seq_num_mapping_release(address_t dodag_id);
+static void                 seq_num_mapping_sync(node_t *node);
+static uint32               seq_num_mapping_slot(uint32 key);
+static void                 seq_num_mapping_grow();
 
 static bool                 dio_pdu_changed(rpl_neighbor_t *neighbor, rpl_dio_pdu_t *dio_pdu);
 static bool                 dio_pdu_dodag_config_changed(rpl_neighbor_t *neighbor, rpl_dio_pdu_t *dio_pdu);
+static bool                 dio_pdu_consistent(node_t *node, rpl_dio_pdu_t *dio_pdu);
 
 static void                 start_dio_poisoning(node_t *node);
 static void                 start_as_root(node_t *node);
-static void                 join_dodag_iteration(node_t *node, rpl_dio_pdu_t *dio_pdu);
+static void                 join_dodag_iteration(node_t *node, rpl_dio_record_t *dio_record);
 
 static void                 choose_parents_and_siblings(node_t *node);
-static rpl_dio_pdu_t *      get_preferred_dodag_dio_pdu(node_t *node, bool *same);
+static void                 update_parents_and_siblings(node_t *node, rpl_neighbor_t *neighbor);
+static bool                 neighbor_is_candidate(node_t *node, rpl_neighbor_t *neighbor);
+static bool                 choose_pref_parent(node_t *node);
+static void                 classify_candidates(node_t *node, bool forget_others);
+static void                 classify_candidate(node_t *node, rpl_neighbor_t *neighbor);
+static void                 print_parents_and_siblings(node_t *node);
+static rpl_dio_record_t *   get_preferred_dodag_dio_record(node_t *node, bool *same);
 static void                 update_dodag_config(node_t *node, rpl_dio_pdu_t *dio_pdu);
 static void                 reset_trickle_timer(node_t *node);
+static void                 trickle_start_interval(node_t *node);
+static void                 trickle_schedule(node_t *node, uint8 phase, sim_time_t delay);
 static void                 forget_neighbor_messages(node_t *node);
+static void                 next_hop_list_invalidate(node_t *node);
+static void                 tree_update(node_t *node);
+static void                 tree_link(node_t *node, node_t *parent);
+static void                 tree_unlink(node_t *node);
+static void                 tree_relabel(node_t *node);
 
 static rpl_dio_pdu_t *      create_current_dio_message(node_t *node, bool include_dodag_config);
 static rpl_dio_pdu_t *      create_root_dio_message(node_t *node, bool include_dodag_config, bool inculde_seq_num);
@@ -113,10 +150,32 @@ static rpl_dio_pdu_t *      create_joined_dio_message(node_t *node, bool include
 static void                 update_neighbor_dio_message(rpl_neighbor_t *neighbor, rpl_dio_pdu_t *dio_pdu);
 
 static uint16               compute_candidate_rank(node_t *node, rpl_neighbor_t *neighbor);
+static uint16               of0_rank_increase(node_t *node, rpl_neighbor_t *neighbor);
+static uint16               mrhof_rank_increase(node_t *node, rpl_neighbor_t *neighbor);
+
+static bool                 candidate_heap_contains(rpl_dodag_t *dodag, rpl_neighbor_t *neighbor);
+static void                 candidate_heap_update(rpl_dodag_t *dodag, rpl_neighbor_t *neighbor, uint16 candidate_rank);
+static void                 candidate_heap_remove(rpl_dodag_t *dodag, rpl_neighbor_t *neighbor);
+static void                 candidate_heap_sift_up(rpl_dodag_t *dodag, uint16 pos);
+static void                 candidate_heap_sift_down(rpl_dodag_t *dodag, uint16 pos);
 static sim_time_t           compute_dao_delay(node_t *node);
+static int                  dao_target_compare(const void *a, const void *b);
+static bool                 node_is_storing(node_t *node);
+static bool                 dao_pdu_receive_non_storing(node_t *node, node_t *incoming_node, rpl_dao_pdu_t *pdu);
+
+static void                 source_route_table_update(node_t *node, address_t target, address_t parent);
+static void                 source_route_table_clear(node_t *node);
+static rpl_source_route_t * source_route_lookup(node_t *node, address_t dst);
+static void                 source_route_cache_unlink(rpl_source_route_table_t *table, int16 slot);
+static void                 source_route_cache_push(rpl_source_route_table_t *table, int16 slot);
 
 static void                 event_arg_str(uint16 event_id, void *data1, void *data2, char *str1, char *str2, uint16 len);
 
+static rpl_of_t             of_list[RPL_OF_COUNT] = {
+    { "of0", of0_rank_increase },
+    { "mrhof", mrhof_rank_increase }
+};
+
 
     /**** exported functions ****/
 
@@ -135,6 +194,7 @@ bool rpl_init()
     rpl_event_neighbor_attach = event_register("neighbor_attach", "rpl", (event_handler_t) event_handler_neighbor_attach, event_arg_str);
     rpl_event_neighbor_detach = event_register("neighbor_detach", "rpl", (event_handler_t) event_handler_neighbor_detach, event_arg_str);
     rpl_event_new_pref_parent = event_register("new_pref_parent", "rpl", (event_handler_t) event_handler_new_pref_parent, event_arg_str);
+    rpl_event_loop_detected = event_register("loop_detected", "rpl", (event_handler_t) event_handler_loop_detected, event_arg_str);
 
     rpl_event_forward_failure = event_register("forward_failure", "rpl", (event_handler_t) event_handler_forward_failure, event_arg_str);
     rpl_event_forward_inconsistency = event_register("forward_inconsistency", "rpl", (event_handler_t) event_handler_forward_inconsistency, event_arg_str);
@@ -151,16 +211,55 @@ bool rpl_init()
 
 bool rpl_done()
 {
+    if (seq_num_mapping_table != NULL) {
+        free(seq_num_mapping_table);
+        seq_num_mapping_table = NULL;
+        seq_num_mapping_size = 0;
+        seq_num_mapping_count = 0;
+    }
+
+    if (tree_queue != NULL) {
+        free(tree_queue);
+        tree_queue = NULL;
+        tree_queue_size = 0;
+    }
+
     return TRUE;
 }
 
+char *rpl_of_get_name(uint8 ocp)
+{
+    rs_assert(ocp < RPL_OF_COUNT);
+
+    return of_list[ocp].name;
+}
+
+int8 rpl_of_find_by_name(char *name)
+{
+    rs_assert(name != NULL);
+
+    uint8 i;
+    for (i = 0; i < RPL_OF_COUNT; i++) {
+        if (!strcmp(of_list[i].name, name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 rpl_neighbor_t *rpl_neighbor_create(node_t *node)
 {
     rpl_neighbor_t *neighbor = malloc(sizeof(rpl_neighbor_t));
 
     neighbor->node = node;
     neighbor->is_dao_parent = FALSE;
-    neighbor->last_dio_message = NULL;
+    neighbor->has_last_dio = FALSE;
+
+    neighbor->etx = RPL_ETX_INIT;
+
+    neighbor->candidate_rank = RPL_RANK_INFINITY;
+    neighbor->candidate_pos = 0;
 
     return neighbor;
 }
@@ -169,10 +268,6 @@ void rpl_neighbor_destroy(rpl_neighbor_t* neighbor)
 {
     rs_assert(neighbor != NULL);
 
-    if (neighbor->last_dio_message != NULL) {
-        rpl_dio_pdu_destroy(neighbor->last_dio_message);
-    }
-
     free(neighbor);
 }
 
@@ -181,6 +276,7 @@ rpl_root_info_t *rpl_root_info_create()
     rpl_root_info_t *root_info = malloc(sizeof(rpl_root_info_t));
 
     root_info->dodag_id = NULL;
+    root_info->interned_dodag_id = ADDR_UNKNOWN;
     root_info->configured_dodag_id = NULL;
     root_info->dodag_pref = RPL_DEFAULT_DAG_PREF;
     root_info->grounded = FALSE;
@@ -194,6 +290,7 @@ rpl_root_info_t *rpl_root_info_create()
     root_info->max_rank_inc = rs_system->rpl_max_inc_rank;
     //root_info->min_hop_rank_inc = rs_system->rpl_min_hop_rank_inc;
     root_info->min_hop_rank_inc = 1;
+    root_info->ocp = rs_system->rpl_ocp;
 
     return root_info;
 }
@@ -213,35 +310,43 @@ void rpl_root_info_destroy(rpl_root_info_t *root_info)
     free(root_info);
 }
 
-rpl_dodag_t *rpl_dodag_create(rpl_dio_pdu_t *dio_pdu)
+rpl_dodag_t *rpl_dodag_create(rpl_dio_record_t *dio_record)
 {
-    rs_assert(dio_pdu != NULL);
-    rs_assert(dio_pdu->dodag_config_suboption != NULL);
+    rs_assert(dio_record != NULL);
+    rs_assert(dio_record->has_dodag_config);
 
     rpl_dodag_t *dodag = malloc(sizeof(rpl_dodag_t));
 
-    dodag->dodag_id = strdup(dio_pdu->dodag_id);
-    dodag->dodag_pref = dio_pdu->dodag_pref;
-    dodag->grounded = dio_pdu->grounded;
-    dodag->dao_supported = dio_pdu->dao_supported;
-    dodag->dao_trigger = dio_pdu->dao_trigger;
-
-    dodag->dio_interval_doublings = dio_pdu->dodag_config_suboption->dio_interval_doublings;
-    dodag->dio_interval_min = dio_pdu->dodag_config_suboption->dio_interval_min;
-    dodag->dio_redundancy_constant = dio_pdu->dodag_config_suboption->dio_redundancy_constant;
-    dodag->max_rank_inc = dio_pdu->dodag_config_suboption->max_rank_inc;
-    dodag->min_hop_rank_inc = dio_pdu->dodag_config_suboption->min_hop_rank_inc;
-
-    dodag->seq_num = dio_pdu->seq_num;
+    dodag->dodag_id = strdup(addr_to_string(dio_record->dodag_id));
+    dodag->interned_dodag_id = dio_record->dodag_id;
+    dodag->dodag_pref = dio_record->dodag_pref;
+    dodag->grounded = dio_record->grounded;
+    dodag->dao_supported = dio_record->dao_supported;
+    dodag->dao_trigger = dio_record->dao_trigger;
+    dodag->storing = dio_record->storing;
+
+    dodag->dio_interval_doublings = dio_record->dio_interval_doublings;
+    dodag->dio_interval_min = dio_record->dio_interval_min;
+    dodag->dio_redundancy_constant = dio_record->dio_redundancy_constant;
+    dodag->max_rank_inc = dio_record->max_rank_inc;
+    dodag->min_hop_rank_inc = dio_record->min_hop_rank_inc;
+    dodag->ocp = dio_record->ocp;
+
+    dodag->seq_num = dio_record->seq_num;
     dodag->lowest_rank = RPL_RANK_INFINITY;
     dodag->rank = RPL_RANK_INFINITY;
 
     dodag->parent_list = NULL;
     dodag->parent_count = 0;
+    node_map_init(&dodag->parent_map);
     dodag->sibling_list = NULL;
     dodag->sibling_count = 0;
+    node_map_init(&dodag->sibling_map);
     dodag->pref_parent = NULL;
 
+    dodag->candidate_heap = NULL;
+    dodag->candidate_count = 0;
+
     return dodag;
 }
 
@@ -261,6 +366,13 @@ void rpl_dodag_destroy(rpl_dodag_t *dodag)
         free(dodag->sibling_list);
     }
 
+    if (dodag->candidate_heap != NULL) {
+        free(dodag->candidate_heap);
+    }
+
+    node_map_done(&dodag->parent_map);
+    node_map_done(&dodag->sibling_map);
+
     free(dodag);
 }
 
@@ -269,6 +381,7 @@ rpl_dio_pdu_t *rpl_dio_pdu_create()
     rpl_dio_pdu_t *pdu = malloc(sizeof(rpl_dio_pdu_t));
 
     pdu->dodag_id = NULL;
+    pdu->interned_dodag_id = ADDR_UNKNOWN;
     pdu->dodag_pref = RPL_DEFAULT_DAG_PREF;
     pdu->seq_num = 0;
 
@@ -279,6 +392,7 @@ rpl_dio_pdu_t *rpl_dio_pdu_create()
     pdu->grounded = FALSE;
     pdu->dao_supported = rs_system->rpl_dao_supported;
     pdu->dao_trigger = rs_system->rpl_dao_trigger;
+    pdu->storing = RPL_DEFAULT_NODE_STORING;
 
     pdu->dodag_config_suboption = NULL;
 
@@ -305,6 +419,7 @@ rpl_dio_pdu_t *rpl_dio_pdu_duplicate(rpl_dio_pdu_t *pdu)
     rpl_dio_pdu_t *new_pdu = malloc(sizeof(rpl_dio_pdu_t));
 
     new_pdu->dodag_id = strdup(pdu->dodag_id);
+    new_pdu->interned_dodag_id = pdu->interned_dodag_id;
     new_pdu->dodag_pref = pdu->dodag_pref;
     new_pdu->seq_num = pdu->seq_num;
 
@@ -315,6 +430,7 @@ rpl_dio_pdu_t *rpl_dio_pdu_duplicate(rpl_dio_pdu_t *pdu)
     new_pdu->grounded = pdu->grounded;
     new_pdu->dao_supported = pdu->dao_supported;
     new_pdu->dao_trigger = pdu->dao_trigger;
+    new_pdu->storing = pdu->storing;
 
     if (pdu->dodag_config_suboption != NULL) {
         new_pdu->dodag_config_suboption = rpl_dio_suboption_dodag_config_create();
@@ -324,6 +440,7 @@ rpl_dio_pdu_t *rpl_dio_pdu_duplicate(rpl_dio_pdu_t *pdu)
         new_pdu->dodag_config_suboption->dio_redundancy_constant = pdu->dodag_config_suboption->dio_redundancy_constant;
         new_pdu->dodag_config_suboption->max_rank_inc = pdu->dodag_config_suboption->max_rank_inc;
         new_pdu->dodag_config_suboption->min_hop_rank_inc = pdu->dodag_config_suboption->min_hop_rank_inc;
+        new_pdu->dodag_config_suboption->ocp = pdu->dodag_config_suboption->ocp;
     }
     else {
         new_pdu->dodag_config_suboption = NULL;
@@ -341,6 +458,7 @@ rpl_dio_suboption_dodag_config_t *rpl_dio_suboption_dodag_config_create()
     suboption->dio_redundancy_constant = 0;
     suboption->max_rank_inc = 0;
     suboption->min_hop_rank_inc = 0;
+    suboption->ocp = RPL_OF_OF0;
 
     return suboption;
 }
@@ -358,8 +476,8 @@ rpl_dao_pdu_t *rpl_dao_pdu_create()
 
     pdu->seq_num = 0;
     pdu->rank = 0;
-    pdu->dest = NULL;
-    pdu->prefix_len = 0;
+    pdu->target_list = NULL;
+    pdu->target_count = 0;
     pdu->life_time = 0;
     pdu->rr_stack = NULL;
     pdu->rr_count = 0;
@@ -371,6 +489,8 @@ void rpl_dao_pdu_destroy(rpl_dao_pdu_t *pdu)
 {
     rs_assert(pdu != NULL);
 
+    free(pdu->target_list);
+
     while (pdu->rr_count > 0) {
         free(pdu->rr_stack[--pdu->rr_count]);
     }
@@ -388,10 +508,18 @@ rpl_dao_pdu_t *rpl_dao_pdu_duplicate(rpl_dao_pdu_t *pdu)
 
     new_pdu->seq_num = pdu->seq_num;
     new_pdu->rank = pdu->rank;
-    new_pdu->dest = strdup(pdu->dest);
-    new_pdu->prefix_len = pdu->prefix_len;
     new_pdu->life_time = pdu->life_time;
 
+    if (pdu->target_count == 0) {
+        new_pdu->target_list = NULL;
+    }
+    else {
+        new_pdu->target_list = malloc(pdu->target_count * sizeof(rpl_dao_target_t));
+        memcpy(new_pdu->target_list, pdu->target_list, pdu->target_count * sizeof(rpl_dao_target_t));
+    }
+
+    new_pdu->target_count = pdu->target_count;
+
     if (pdu->rr_count == 0) {
         new_pdu->rr_stack = NULL;
     }
@@ -418,36 +546,41 @@ void rpl_dao_pdu_add_rr(rpl_dao_pdu_t *pdu, char *ip_address)
     pdu->rr_stack[pdu->rr_count - 1] = strdup(ip_address);
 }
 
-uint8 rpl_seq_num_get(char *dodag_id)
+void rpl_dao_pdu_add_target(rpl_dao_pdu_t *pdu, address_t dest, uint8 prefix_len, address_t parent)
 {
-    uint16 i;
-    for (i = 0; i < seq_num_mapping_count; i++) {
-        seq_num_mapping_t *mapping = seq_num_mapping_list[i];
-
-        if (strcmp(mapping->dodag_id, dodag_id) == 0) {
-            return mapping->seq_num;
-        }
-    }
+    rs_assert(pdu != NULL);
+    rs_assert(dest != ADDR_UNKNOWN);
 
-    return 0;
+    pdu->target_list = realloc(pdu->target_list, (++pdu->target_count) * sizeof(rpl_dao_target_t));
+    pdu->target_list[pdu->target_count - 1].dest = dest;
+    pdu->target_list[pdu->target_count - 1].prefix_len = prefix_len;
+    pdu->target_list[pdu->target_count - 1].parent = parent;
 }
 
-void rpl_seq_num_reset()
+uint8 rpl_seq_num_get(address_t dodag_id)
 {
-    uint16 i;
-    for (i = 0; i < seq_num_mapping_count; i++) {
-        seq_num_mapping_t *mapping = seq_num_mapping_list[i];
+    seq_num_mapping_t *mapping = seq_num_mapping_find(dodag_id);
 
-        if (mapping->dodag_id != NULL) {
-            free(mapping->dodag_id);
-        }
+    return mapping != NULL ? mapping->seq_num : 0;
+}
 
-        free(mapping);
+void rpl_seq_num_reset()
+{
+    if (seq_num_mapping_table != NULL) {
+        free(seq_num_mapping_table);
+        seq_num_mapping_table = NULL;
     }
 
-    free(seq_num_mapping_list);
-    seq_num_mapping_list = 0;
+    seq_num_mapping_size = 0;
     seq_num_mapping_count = 0;
+
+    /* the roots take their references again with their next DIO */
+    nodes_lock();
+    uint16 i;
+    for (i = 0; i < rs_system->node_count; i++) {
+        rs_system->node_list[i]->rpl_info->seq_num_dodag_id = ADDR_UNKNOWN;
+    }
+    nodes_unlock();
 }
 
 void rpl_node_init(node_t *node)
@@ -463,16 +596,35 @@ void rpl_node_init(node_t *node)
 
     node->rpl_info->trickle_i_doublings_so_far = 0;
     node->rpl_info->trickle_i = 0;
+    node->rpl_info->trickle_t = 0;
     node->rpl_info->trickle_c = 0;
-    node->rpl_info->last_trickle_i_schedule_time = 0;
-    node->rpl_info->last_trickle_t_schedule_time = 0;
+    node->rpl_info->trickle_phase = RPL_TRICKLE_PHASE_IDLE;
+    node->rpl_info->trickle_interval_start = 0;
+    node->rpl_info->trickle_next_time = 0;
 
     node->rpl_info->neighbor_list = NULL;
     node->rpl_info->neighbor_count = 0;
+    node_map_init(&node->rpl_info->neighbor_map);
 
     node->rpl_info->poison_count_so_far = 0;
 
     node->rpl_info->last_dio_send_time = 0;
+
+    node->rpl_info->next_hop_list = NULL;
+    node->rpl_info->next_hop_version = 0;
+
+    node->rpl_info->tree_parent = NULL;
+    node->rpl_info->tree_child_list = NULL;
+    node->rpl_info->tree_child_count = 0;
+    node->rpl_info->tree_child_pos = 0;
+    node->rpl_info->tree_root = NULL;
+    node->rpl_info->tree_grounded = FALSE;
+    node->rpl_info->tree_depth = 0;
+    node->rpl_info->tree_stamp = 0;
+
+    node->rpl_info->source_route_table = NULL;
+
+    node->rpl_info->seq_num_dodag_id = ADDR_UNKNOWN;
 }
 
 void rpl_node_done(node_t *node)
@@ -482,6 +634,10 @@ void rpl_node_done(node_t *node)
     if (node->rpl_info != NULL) {
         rpl_node_remove_all_neighbors(node);
 
+        if (node->rpl_info->seq_num_dodag_id != ADDR_UNKNOWN) {
+            seq_num_mapping_release(node->rpl_info->seq_num_dodag_id);
+        }
+
         if (node->rpl_info->root_info != NULL) {
             rpl_root_info_destroy(node->rpl_info->root_info);
         }
@@ -490,6 +646,24 @@ void rpl_node_done(node_t *node)
             rpl_dodag_destroy(node->rpl_info->joined_dodag);
         }
 
+        next_hop_list_invalidate(node);
+
+        /* leave the tree, the orphaned children are no longer connected */
+        if (node->rpl_info->tree_parent != NULL) {
+            tree_unlink(node);
+        }
+        while (node->rpl_info->tree_child_count > 0) {
+            node_t *child = node->rpl_info->tree_child_list[node->rpl_info->tree_child_count - 1];
+
+            tree_unlink(child);
+            tree_relabel(child);
+        }
+        if (node->rpl_info->tree_child_list != NULL) {
+            free(node->rpl_info->tree_child_list);
+        }
+
+        source_route_table_clear(node);
+
         free(node->rpl_info);
         node->rpl_info = NULL;
     }
@@ -504,6 +678,7 @@ void rpl_node_add_neighbor(node_t *node, node_t *neighbor_node)
 
     node->rpl_info->neighbor_list = realloc(node->rpl_info->neighbor_list, (node->rpl_info->neighbor_count + 1) * sizeof(rpl_neighbor_t *));
     node->rpl_info->neighbor_list[node->rpl_info->neighbor_count++] = neighbor;
+    node_map_put(&node->rpl_info->neighbor_map, neighbor_node, neighbor);
 }
 
 bool rpl_node_remove_neighbor(node_t *node, rpl_neighbor_t *neighbor)
@@ -526,6 +701,14 @@ bool rpl_node_remove_neighbor(node_t *node, rpl_neighbor_t *neighbor)
         return FALSE;
     }
 
+    if (neighbor->node != NULL) {
+        node_map_remove(&node->rpl_info->neighbor_map, neighbor->node);
+    }
+
+    if (node->rpl_info->joined_dodag != NULL) {
+        candidate_heap_remove(node->rpl_info->joined_dodag, neighbor);
+    }
+
     rpl_neighbor_destroy(neighbor);
 
     for (i = pos; i < node->rpl_info->neighbor_count - 1; i++) {
@@ -558,20 +741,18 @@ void rpl_node_remove_all_neighbors(node_t *node)
     }
 
     node->rpl_info->neighbor_count = 0;
+    node_map_done(&node->rpl_info->neighbor_map);
+
+    if (node->rpl_info->joined_dodag != NULL) {
+        node->rpl_info->joined_dodag->candidate_count = 0;
+    }
 }
 
 rpl_neighbor_t *rpl_node_find_neighbor_by_node(node_t *node, node_t *neighbor_node)
 {
     rs_assert(node != NULL);
 
-    int i;
-    for (i = 0; i < node->rpl_info->neighbor_count; i++) {
-        if (node->rpl_info->neighbor_list[i]->node == neighbor_node) {
-            return node->rpl_info->neighbor_list[i];
-        }
-    }
-
-    return NULL;
+    return node_map_get(&node->rpl_info->neighbor_map, neighbor_node);
 }
 
 void rpl_node_add_parent(node_t *node, rpl_neighbor_t *parent)
@@ -584,6 +765,9 @@ void rpl_node_add_parent(node_t *node, rpl_neighbor_t *parent)
 
     dodag->parent_list = realloc(dodag->parent_list, (dodag->parent_count + 1) * sizeof(rpl_neighbor_t *));
     dodag->parent_list[dodag->parent_count++] = parent;
+    node_map_put(&dodag->parent_map, parent->node, parent);
+
+    next_hop_list_invalidate(node);
 }
 
 bool rpl_node_remove_parent(node_t *node, rpl_neighbor_t *parent)
@@ -613,12 +797,18 @@ bool rpl_node_remove_parent(node_t *node, rpl_neighbor_t *parent)
         dodag->parent_list[i] = dodag->parent_list[i + 1];
     }
 
+    if (parent->node != NULL) {
+        node_map_remove(&dodag->parent_map, parent->node);
+    }
+
     dodag->parent_count--;
     dodag->parent_list = realloc(dodag->parent_list, dodag->parent_count * sizeof(rpl_neighbor_t *));
     if (dodag->parent_count == 0) {
         dodag->parent_list = NULL;
     }
 
+    next_hop_list_invalidate(node);
+
     return TRUE;
 }
 
@@ -635,6 +825,9 @@ void rpl_node_remove_all_parents(node_t *node)
     }
 
     dodag->parent_count = 0;
+    node_map_done(&dodag->parent_map);
+
+    next_hop_list_invalidate(node);
 }
 
 rpl_neighbor_t *rpl_node_find_parent_by_node(node_t *node, node_t *parent_node)
@@ -646,16 +839,7 @@ rpl_neighbor_t *rpl_node_find_parent_by_node(node_t *node, node_t *parent_node)
         return NULL;
     }
 
-    rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
-
-    int i;
-    for (i = 0; i < dodag->parent_count; i++) {
-        if (dodag->parent_list[i]->node == parent_node) {
-            return dodag->parent_list[i];
-        }
-    }
-
-    return NULL;
+    return node_map_get(&node->rpl_info->joined_dodag->parent_map, parent_node);
 }
 
 bool rpl_node_neighbor_is_parent(node_t *node, rpl_neighbor_t *neighbor)
@@ -667,16 +851,7 @@ bool rpl_node_neighbor_is_parent(node_t *node, rpl_neighbor_t *neighbor)
         return FALSE;
     }
 
-    rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
-
-    int i;
-    for (i = 0; i < dodag->parent_count; i++) {
-        if (dodag->parent_list[i] == neighbor) {
-            return TRUE;
-        }
-    }
-
-    return FALSE;
+    return neighbor->node != NULL && node_map_get(&node->rpl_info->joined_dodag->parent_map, neighbor->node) == neighbor;
 }
 
 void rpl_node_add_sibling(node_t *node, rpl_neighbor_t *sibling)
@@ -689,6 +864,9 @@ void rpl_node_add_sibling(node_t *node, rpl_neighbor_t *sibling)
 
     dodag->sibling_list = realloc(dodag->sibling_list, (dodag->sibling_count + 1) * sizeof(rpl_neighbor_t *));
     dodag->sibling_list[dodag->sibling_count++] = sibling;
+    node_map_put(&dodag->sibling_map, sibling->node, sibling);
+
+    next_hop_list_invalidate(node);
 }
 
 bool rpl_node_remove_sibling(node_t *node, rpl_neighbor_t *sibling)
@@ -718,12 +896,18 @@ bool rpl_node_remove_sibling(node_t *node, rpl_neighbor_t *sibling)
         dodag->sibling_list[i] = dodag->sibling_list[i + 1];
     }
 
+    if (sibling->node != NULL) {
+        node_map_remove(&dodag->sibling_map, sibling->node);
+    }
+
     dodag->sibling_count--;
     dodag->sibling_list = realloc(dodag->sibling_list, dodag->sibling_count * sizeof(rpl_neighbor_t *));
     if (dodag->sibling_count == 0) {
         dodag->sibling_list = NULL;
     }
 
+    next_hop_list_invalidate(node);
+
     return TRUE;
 }
 
@@ -740,6 +924,9 @@ void rpl_node_remove_all_siblings(node_t *node)
     }
 
     dodag->sibling_count = 0;
+    node_map_done(&dodag->sibling_map);
+
+    next_hop_list_invalidate(node);
 }
 
 rpl_neighbor_t *rpl_node_find_sibling_by_node(node_t *node, node_t *sibling_node)
@@ -751,16 +938,7 @@ rpl_neighbor_t *rpl_node_find_sibling_by_node(node_t *node, node_t *sibling_node
         return NULL;
     }
 
-    rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
-
-    int i;
-    for (i = 0; i < dodag->sibling_count; i++) {
-        if (dodag->sibling_list[i]->node == sibling_node) {
-            return dodag->sibling_list[i];
-        }
-    }
-
-    return NULL;
+    return node_map_get(&node->rpl_info->joined_dodag->sibling_map, sibling_node);
 }
 
 bool rpl_node_neighbor_is_sibling(node_t *node, rpl_neighbor_t *neighbor)
@@ -772,16 +950,7 @@ bool rpl_node_neighbor_is_sibling(node_t *node, rpl_neighbor_t *neighbor)
         return FALSE;
     }
 
-    rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
-
-    int i;
-    for (i = 0; i < dodag->sibling_count; i++) {
-        if (dodag->sibling_list[i] == neighbor) {
-            return TRUE;
-        }
-    }
-
-    return FALSE;
+    return neighbor->node != NULL && node_map_get(&node->rpl_info->joined_dodag->sibling_map, neighbor->node) == neighbor;
 }
 
 void rpl_node_start_as_root(node_t *node)
@@ -798,11 +967,13 @@ void rpl_node_isolate(node_t *node)
     if (rpl_node_is_joined(node)) {
         rpl_dodag_destroy(node->rpl_info->joined_dodag);
         node->rpl_info->joined_dodag = NULL;
+        next_hop_list_invalidate(node);
     }
 
     if (node->rpl_info->root_info->dodag_id != NULL) {
         free(node->rpl_info->root_info->dodag_id);
         node->rpl_info->root_info->dodag_id = NULL;
+        node->rpl_info->root_info->interned_dodag_id = ADDR_UNKNOWN;
     }
 
     if (node->rpl_info->root_info->configured_dodag_id != NULL) {
@@ -810,8 +981,10 @@ void rpl_node_isolate(node_t *node)
         node->rpl_info->root_info->configured_dodag_id = NULL;
     }
 
-    rs_system_cancel_event(node, rpl_event_trickle_i_timeout, NULL, NULL, 0);
-    rs_system_cancel_event(node, rpl_event_trickle_t_timeout, NULL, NULL, 0);
+    source_route_table_clear(node);
+    seq_num_mapping_sync(node);
+    trickle_schedule(node, RPL_TRICKLE_PHASE_IDLE, 0);
+    tree_update(node);
 }
 
 void rpl_node_reset_trickle_timer(node_t *node)
@@ -821,19 +994,54 @@ void rpl_node_reset_trickle_timer(node_t *node)
     reset_trickle_timer(node);
 }
 
-node_t **rpl_node_get_next_hop_list(node_t *node, uint16 *node_count)
+void rpl_node_update_tree(node_t *node)
 {
     rs_assert(node != NULL);
-    rs_assert(node_count != NULL);
 
-    if (rpl_node_is_joined(node)) {
-        events_lock();
+    tree_update(node);
+}
+
+uint32 rpl_node_get_route_state_size(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    uint32 size = 0;
+
+    /* the downward routes of storing mode */
+    ip_route_t *route;
+    for (route = node->ip_info->route_type_index[IP_ROUTE_TYPE_RPL_DAO].first; route != NULL; route = route->type_next) {
+        size += sizeof(ip_route_t) + strlen(route->dst) + 1;
+    }
 
+    /* the parent pointers and the path cache of a non-storing root */
+    rpl_source_route_table_t *table = node->rpl_info->source_route_table;
+    if (table != NULL) {
+        size += sizeof(rpl_source_route_table_t) + table->size * (sizeof(address_t) + sizeof(sim_time_t) + sizeof(int16));
+    }
+
+    return size;
+}
+
+rpl_next_hop_list_t *rpl_node_get_next_hop_list(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    if (!rpl_node_is_joined(node)) {
+        return NULL;
+    }
+
+    if (node->rpl_info->next_hop_list == NULL) { /* rebuild only after a change */
         rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
-        node_t **node_list = malloc((dodag->parent_count + dodag->sibling_count) * sizeof(node_t *));
+        rpl_next_hop_list_t *next_hop_list = malloc(sizeof(rpl_next_hop_list_t));
 
-        *node_count = 1;
-        node_list[0] = dodag->pref_parent->node;
+        next_hop_list->node_list = malloc((1 + dodag->parent_count + dodag->sibling_count) * sizeof(node_t *));
+        next_hop_list->node_count = 0;
+        next_hop_list->version = node->rpl_info->next_hop_version;
+        next_hop_list->ref_count = 1;
+
+        if (dodag->pref_parent != NULL) {
+            next_hop_list->node_list[next_hop_list->node_count++] = dodag->pref_parent->node;
+        }
 
         uint16 i;
         for (i = 0; i < dodag->parent_count; i++) {
@@ -843,26 +1051,48 @@ node_t **rpl_node_get_next_hop_list(node_t *node, uint16 *node_count)
                 continue;
             }
 
-            node_list[(*node_count)++] = neighbor->node;
+            next_hop_list->node_list[next_hop_list->node_count++] = neighbor->node;
         }
 
         for (i = 0; i < dodag->sibling_count; i++) {
             rpl_neighbor_t *neighbor = dodag->sibling_list[i];
 
-            node_list[(*node_count)++] = neighbor->node;
+            next_hop_list->node_list[next_hop_list->node_count++] = neighbor->node;
         }
 
-        events_unlock();
-
-        return node_list;
+        node->rpl_info->next_hop_list = next_hop_list;
     }
-    else {
-        *node_count = 0;
-        return NULL;
+
+    return node->rpl_info->next_hop_list;
+}
+
+void rpl_next_hop_list_hold(rpl_next_hop_list_t *next_hop_list)
+{
+    rs_assert(next_hop_list != NULL);
+
+    next_hop_list->ref_count++;
+}
+
+void rpl_next_hop_list_release(rpl_next_hop_list_t *next_hop_list)
+{
+    rs_assert(next_hop_list != NULL);
+    rs_assert(next_hop_list->ref_count > 0);
+
+    if (--next_hop_list->ref_count == 0) {
+        free(next_hop_list->node_list);
+        free(next_hop_list);
     }
 }
 
-bool rpl_node_process_incoming_flow_label(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu)
+bool rpl_next_hop_list_is_current(node_t *node, rpl_next_hop_list_t *next_hop_list)
+{
+    rs_assert(node != NULL);
+    rs_assert(next_hop_list != NULL);
+
+    return next_hop_list->version == node->rpl_info->next_hop_version;
+}
+
+uint8 rpl_node_process_incoming_flow_label(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu)
 {
     rs_assert(node != NULL);
     rs_assert(ip_pdu != NULL);
@@ -879,16 +1109,14 @@ bool rpl_node_process_incoming_flow_label(node_t *node, node_t *incoming_node, i
         }
         ip_node_rem_route(node, route);
 
-        /* retry to send the packet, now using a possibly different route */
-        ip_node_forward(node, incoming_node, ip_pdu);
-
         event_execute(rpl_event_forward_inconsistency, node, incoming_node, ip_pdu);
 
-        return FALSE;
+        /* the IP layer retries to send the packet, now using a possibly different route */
+        return RPL_FLOW_LABEL_REROUTE;
     }
 
     if (rpl_node_is_isolated(node) || rpl_node_is_poisoning(node)) { /* no special activity while isolated or poisoning */
-        return TRUE;
+        return RPL_FLOW_LABEL_ACCEPT;
     }
 
     uint16 rank = (rpl_node_is_joined(node) ? node->rpl_info->joined_dodag->rank : RPL_RANK_ROOT);
@@ -910,18 +1138,18 @@ bool rpl_node_process_incoming_flow_label(node_t *node, node_t *incoming_node, i
         if (flow_label->rank_error) { /* the second forwarding error along the path */
             rs_debug(DEBUG_RPL, "node '%s': a (second) forwarding inconsistency has been detected coming from '%s', with src = '%s' and dst = '%s'",
                     node->phy_info->name, incoming_node != NULL ? incoming_node->phy_info->name : "<<unknown>>",
-                    ip_pdu->src_address, ip_pdu->dst_address);
+                    addr_to_string(ip_pdu->src_address), addr_to_string(ip_pdu->dst_address));
 
             event_execute(rpl_event_forward_inconsistency, node, incoming_node, ip_pdu);
 
-            return FALSE;
+            return RPL_FLOW_LABEL_DROP;
         }
         else { /* the first forwarding error along the path */
             flow_label->rank_error = TRUE;
         }
     }
 
-    return TRUE;
+    return RPL_FLOW_LABEL_ACCEPT;
 }
 
 node_t *rpl_node_process_outgoing_flow_label(node_t *node, node_t *incoming_node, node_t *proposed_outgoing_node, ip_pdu_t *ip_pdu)
@@ -952,15 +1180,15 @@ node_t *rpl_node_process_outgoing_flow_label(node_t *node, node_t *incoming_node
 
     flow_label->sender_rank = rank;
 
-    if (neighbor->last_dio_message == NULL || neighbor->last_dio_message->rank > rank) {
+    if (!neighbor->has_last_dio || neighbor->last_dio.rank > rank) {
         flow_label->going_down = TRUE;
         flow_label->from_sibling = FALSE;
     }
-    else if (neighbor->last_dio_message->rank < rank) {
+    else if (neighbor->last_dio.rank < rank) {
         flow_label->going_down = FALSE;
         flow_label->from_sibling = FALSE;
     }
-    else { /* if (neighbor->last_dio_message == rank) */
+    else { /* if (neighbor->last_dio.rank == rank) */
         flow_label->going_down = FALSE;
 
         if (!flow_label->from_sibling) { /* the first sibling forwarding */
@@ -975,11 +1203,66 @@ node_t *rpl_node_process_outgoing_flow_label(node_t *node, node_t *incoming_node
     return proposed_outgoing_node;
 }
 
-bool rpl_node_send_dis(node_t *node, char *dst_ip_address)
+void rpl_node_set_source_route(node_t *node, ip_pdu_t *ip_pdu)
+{
+    rs_assert(node != NULL);
+    rs_assert(ip_pdu != NULL);
+
+    if (ip_pdu->source_route != NULL) { /* already on its way down */
+        return;
+    }
+
+    if (node->rpl_info->source_route_table == NULL || !rpl_node_is_root(node) || node->rpl_info->storing) {
+        return;
+    }
+
+    rpl_source_route_t *source_route = source_route_lookup(node, ip_pdu->dst_address);
+    if (source_route == NULL || source_route->hop_count == 0) { /* unknown, or one of our neighbors */
+        return;
+    }
+
+    ip_pdu->source_route = malloc(source_route->hop_count * sizeof(address_t));
+    memcpy(ip_pdu->source_route, source_route->hop_list, source_route->hop_count * sizeof(address_t));
+    ip_pdu->source_route_count = source_route->hop_count;
+    ip_pdu->source_route_index = 0;
+}
+
+void rpl_node_add_link_sample(node_t *node, node_t *neighbor_node, uint8 transmission_count, bool acknowledged)
+{
+    rs_assert(node != NULL);
+    rs_assert(neighbor_node != NULL);
+
+    rpl_neighbor_t *neighbor = rpl_node_find_neighbor_by_node(node, neighbor_node);
+    if (neighbor == NULL) { /* not heard from at the RPL layer yet */
+        return;
+    }
+
+    uint32 sample = acknowledged ? transmission_count * RPL_ETX_DIVISOR : RPL_ETX_NOACK_PENALTY;
+    if (sample > RPL_ETX_NOACK_PENALTY) {
+        sample = RPL_ETX_NOACK_PENALTY;
+    }
+
+    neighbor->etx = (neighbor->etx * RPL_ETX_ALPHA + sample * (100 - RPL_ETX_ALPHA)) / 100;
+
+    /* a steady parent keeps sending the same DIO, so a degrading link must be reevaluated right away,
+     * but only when the rounded rank increase actually moved */
+    if (!rpl_node_is_joined(node) || !candidate_heap_contains(node->rpl_info->joined_dodag, neighbor)) {
+        return;
+    }
+
+    if (compute_candidate_rank(node, neighbor) != neighbor->candidate_rank) {
+        rs_debug(DEBUG_RPL, "node '%s': link to '%s' changed its etx to %d/%d, reevaluating it",
+                node->phy_info->name, neighbor_node->phy_info->name, neighbor->etx, RPL_ETX_DIVISOR);
+
+        update_parents_and_siblings(node, neighbor);
+    }
+}
+
+bool rpl_node_send_dis(node_t *node, address_t dst_address)
 {
     rs_assert(node != NULL);
 
-    return event_execute(rpl_event_dis_pdu_send, node, dst_ip_address, NULL);
+    return event_execute(rpl_event_dis_pdu_send, node, GUINT_TO_POINTER(dst_address), NULL);
 }
 
 bool rpl_node_receive_dis(node_t *node, node_t *src_node)
@@ -991,11 +1274,11 @@ bool rpl_node_receive_dis(node_t *node, node_t *src_node)
     return all_ok;
 }
 
-bool rpl_node_send_dio(node_t *node, char *dst_ip_address, rpl_dio_pdu_t *pdu)
+bool rpl_node_send_dio(node_t *node, address_t dst_address, rpl_dio_pdu_t *pdu)
 {
     rs_assert(node != NULL);
 
-    return event_execute(rpl_event_dio_pdu_send, node, dst_ip_address, pdu);
+    return event_execute(rpl_event_dio_pdu_send, node, GUINT_TO_POINTER(dst_address), pdu);
 }
 
 bool rpl_node_receive_dio(node_t *node, node_t *src_node, rpl_dio_pdu_t *pdu)
@@ -1009,11 +1292,11 @@ bool rpl_node_receive_dio(node_t *node, node_t *src_node, rpl_dio_pdu_t *pdu)
     return all_ok;
 }
 
-bool rpl_node_send_dao(node_t *node, char *dst_ip_address, rpl_dao_pdu_t *pdu)
+bool rpl_node_send_dao(node_t *node, address_t dst_address, rpl_dao_pdu_t *pdu)
 {
     rs_assert(node != NULL);
 
-    return event_execute(rpl_event_dao_pdu_send, node, dst_ip_address, pdu);
+    return event_execute(rpl_event_dao_pdu_send, node, GUINT_TO_POINTER(dst_address), pdu);
 }
 
 bool rpl_node_receive_dao(node_t *node, node_t *src_node, rpl_dao_pdu_t *pdu)
@@ -1037,7 +1320,7 @@ static bool event_handler_node_wake(node_t *node)
     }
     else { /* preconfigured as normal node */
         if (rs_system->rpl_startup_probe_for_dodags) {
-            rpl_node_send_dis(node, NULL);
+            rpl_node_send_dis(node, ADDR_BROADCAST);
         }
         else {
             start_as_root(node);
@@ -1055,17 +1338,23 @@ static bool event_handler_node_kill(node_t *node)
     if (node->rpl_info->root_info->dodag_id != NULL) {
         free(node->rpl_info->root_info->dodag_id);
         node->rpl_info->root_info->dodag_id = NULL;
+        node->rpl_info->root_info->interned_dodag_id = ADDR_UNKNOWN;
     }
 
     if (node->rpl_info->joined_dodag != NULL) {
         rpl_dodag_destroy(node->rpl_info->joined_dodag);
         node->rpl_info->joined_dodag = NULL;
+        next_hop_list_invalidate(node);
     }
 
     rs_system_cancel_event(node, rpl_event_dao_timeout_check, NULL, NULL, 0);
+    trickle_schedule(node, RPL_TRICKLE_PHASE_IDLE, 0);
+    seq_num_mapping_sync(node);
+    tree_update(node);
 
     ip_node_rem_routes(node, NULL, -1, NULL, IP_ROUTE_TYPE_RPL_DIO);
     ip_node_rem_routes(node, NULL, -1, NULL, IP_ROUTE_TYPE_RPL_DAO);
+    source_route_table_clear(node);
     /* the IP layer should trigger the removal of all our neighbors */
 
     node->rpl_info->last_dio_send_time = -1;
@@ -1075,11 +1364,11 @@ static bool event_handler_node_kill(node_t *node)
     return TRUE;
 }
 
-static bool event_handler_dis_pdu_send(node_t *node, char *dst_ip_address)
+static bool event_handler_dis_pdu_send(node_t *node, address_t dst_address)
 {
     measure_node_add_rpl_dis_message(node, TRUE);
 
-    if (!icmp_node_send(node, dst_ip_address, ICMP_TYPE_RPL, ICMP_RPL_CODE_DIS, NULL)) {
+    if (!icmp_node_send(node, dst_address, ICMP_TYPE_RPL, ICMP_RPL_CODE_DIS, NULL)) {
         return FALSE;
     }
 
@@ -1093,7 +1382,7 @@ static bool event_handler_dis_pdu_receive(node_t *node, node_t *incoming_node)
     rpl_dio_pdu_t *dio_pdu = create_current_dio_message(node, TRUE);
 
     if (dio_pdu != NULL) {
-        if (!rpl_node_send_dio(node, incoming_node->ip_info->address, dio_pdu)) {
+        if (!rpl_node_send_dio(node, incoming_node->ip_info->address_id, dio_pdu)) {
             rpl_dio_pdu_destroy(dio_pdu);
         }
     }
@@ -1101,11 +1390,11 @@ static bool event_handler_dis_pdu_receive(node_t *node, node_t *incoming_node)
     return TRUE;
 }
 
-static bool event_handler_dio_pdu_send(node_t *node, char *dst_ip_address, rpl_dio_pdu_t *pdu)
+static bool event_handler_dio_pdu_send(node_t *node, address_t dst_address, rpl_dio_pdu_t *pdu)
 {
     measure_node_add_rpl_dio_message(node, TRUE);
 
-    if (!icmp_node_send(node, dst_ip_address, ICMP_TYPE_RPL, ICMP_RPL_CODE_DIO, pdu)) {
+    if (!icmp_node_send(node, dst_address, ICMP_TYPE_RPL, ICMP_RPL_CODE_DIO, pdu)) {
         return FALSE;
     }
 
@@ -1118,8 +1407,8 @@ static bool event_handler_dio_pdu_receive(node_t *node, node_t *incoming_node, r
 {
     measure_node_add_rpl_dio_message(node, FALSE);
 
-    /* simulate the risk window */
-    if (rs_system->now - node->rpl_info->last_dio_send_time <= 2 * rs_system->transmission_time) {
+    /* simulate the risk window, unless the PHY layer models collisions itself */
+    if (!rs_system->collisions && rs_system->now - node->rpl_info->last_dio_send_time <= 2 * rs_system->transmission_time) {
         return TRUE;
     }
 
@@ -1130,23 +1419,28 @@ static bool event_handler_dio_pdu_receive(node_t *node, node_t *incoming_node, r
         return FALSE;
     }
 
+    /* trickle counter, consulted when the t timer fires */
+    if (dio_pdu_consistent(node, pdu) && node->rpl_info->trickle_c < 0xFF) {
+        node->rpl_info->trickle_c++;
+    }
+
     if (dio_pdu_changed(neighbor, pdu)) {
 
         /* ignore messages from members of our DODAG which are neither parents nor siblings and emit a greater rank than us */
         if (rpl_node_is_joined(node)) {
-            if (strcmp(node->rpl_info->joined_dodag->dodag_id, pdu->dodag_id) == 0 &&
+            if (node->rpl_info->joined_dodag->interned_dodag_id == pdu->interned_dodag_id &&
                     node->rpl_info->joined_dodag->rank < pdu->rank &&
                     !rpl_node_has_parent(node, incoming_node) &&
                     !rpl_node_has_sibling(node, incoming_node)) {
 
-                neighbor->last_dio_message = NULL; /* make sure we "forgot" the last message for this neighbor */
+                neighbor->has_last_dio = FALSE; /* make sure we "forgot" the last message for this neighbor */
                 return TRUE;
             }
         }
         else if (rpl_node_is_root(node)) {
-            if (strcmp(node->rpl_info->root_info->dodag_id, pdu->dodag_id) == 0) {
+            if (node->rpl_info->root_info->interned_dodag_id == pdu->interned_dodag_id) {
 
-                neighbor->last_dio_message = NULL; /* make sure we "forgot" the last message for this */
+                neighbor->has_last_dio = FALSE; /* make sure we "forgot" the last message for this */
                 return TRUE;
             }
         }
@@ -1164,7 +1458,7 @@ static bool event_handler_dio_pdu_receive(node_t *node, node_t *incoming_node, r
          * If we get poison from the preferred parent, we propagate the poisoning mechanism
 		 */
         if (rpl_node_is_joined(node)) {
-        	if ((node->rpl_info->joined_dodag->pref_parent == neighbor) && (neighbor->last_dio_message->rank == RPL_RANK_INFINITY)){
+        	if ((node->rpl_info->joined_dodag->pref_parent == neighbor) && (neighbor->last_dio.rank == RPL_RANK_INFINITY)){
         		rs_debug(DEBUG_RPL, "node '%s' : was member of dodag id '%s' but preferred parent started poisonning",
         				node->phy_info->name, node->rpl_info->joined_dodag->dodag_id);
 				start_dio_poisoning(node);
@@ -1175,14 +1469,14 @@ static bool event_handler_dio_pdu_receive(node_t *node, node_t *incoming_node, r
 
 
         bool same;
-        rpl_dio_pdu_t *preferred_dodag_pdu = get_preferred_dodag_dio_pdu(node, &same);
+        rpl_dio_record_t *preferred_dodag_record = get_preferred_dodag_dio_record(node, &same);
 
         if (rpl_node_is_isolated(node)) {
-            if (preferred_dodag_pdu != NULL) {
+            if (preferred_dodag_record != NULL) {
                 rs_debug(DEBUG_RPL, "node '%s': was isolated, now found dodag_id = '%s'",
-                        node->phy_info->name, preferred_dodag_pdu->dodag_id);
+                        node->phy_info->name, addr_to_string(preferred_dodag_record->dodag_id));
 
-                join_dodag_iteration(node, preferred_dodag_pdu);
+                join_dodag_iteration(node, preferred_dodag_record);
                 choose_parents_and_siblings(node);
             }
             else {
@@ -1190,11 +1484,11 @@ static bool event_handler_dio_pdu_receive(node_t *node, node_t *incoming_node, r
             }
         }
         else if (rpl_node_is_root(node)) {
-            if (preferred_dodag_pdu != NULL) {
+            if (preferred_dodag_record != NULL) {
                 rs_debug(DEBUG_RPL, "node '%s': was root of dodag_id = '%s', now found a better one with dodag_id = '%s'",
-                        node->phy_info->name, node->rpl_info->root_info->dodag_id, preferred_dodag_pdu->dodag_id);
+                        node->phy_info->name, node->rpl_info->root_info->dodag_id, addr_to_string(preferred_dodag_record->dodag_id));
 
-                join_dodag_iteration(node, preferred_dodag_pdu);
+                join_dodag_iteration(node, preferred_dodag_record);
                 choose_parents_and_siblings(node);
             }
             else {
@@ -1206,11 +1500,11 @@ static bool event_handler_dio_pdu_receive(node_t *node, node_t *incoming_node, r
         }
         else if (rpl_node_is_joined(node)) {
             if (!same) {
-                if (preferred_dodag_pdu != NULL) {
+                if (preferred_dodag_record != NULL) {
                     rs_debug(DEBUG_RPL, "node '%s': was member of dodag_id = '%s', now found a better one with dodag_id = '%s'",
-                            node->phy_info->name, node->rpl_info->joined_dodag->dodag_id, preferred_dodag_pdu->dodag_id);
+                            node->phy_info->name, node->rpl_info->joined_dodag->dodag_id, addr_to_string(preferred_dodag_record->dodag_id));
 
-                    join_dodag_iteration(node, preferred_dodag_pdu);
+                    join_dodag_iteration(node, preferred_dodag_record);
                     choose_parents_and_siblings(node);
                 }
                 else {
@@ -1222,11 +1516,11 @@ static bool event_handler_dio_pdu_receive(node_t *node, node_t *incoming_node, r
             }
             else {
                 /* a new member of our DODAG is a potential parent/sibling, need to reevaluate our neighbors */
-                if (strcmp(neighbor->last_dio_message->dodag_id, node->rpl_info->joined_dodag->dodag_id) == 0) {
-                    rs_debug(DEBUG_RPL, "node '%s': '%s' sent a modified DIO message and is a member of dodag_id = '%s', reevaluating our neighbors",
+                if (neighbor->last_dio.dodag_id == node->rpl_info->joined_dodag->interned_dodag_id) {
+                    rs_debug(DEBUG_RPL, "node '%s': '%s' sent a modified DIO message and is a member of dodag_id = '%s', reevaluating it",
                             node->phy_info->name, neighbor->node->phy_info->name, node->rpl_info->joined_dodag->dodag_id);
 
-                    choose_parents_and_siblings(node);
+                    update_parents_and_siblings(node, neighbor);
                 }
                 else {
                     rs_debug(DEBUG_RPL, "node '%s': remaining in dodag_id = '%s'", node->phy_info->name, node->rpl_info->joined_dodag->dodag_id);
@@ -1243,17 +1537,16 @@ static bool event_handler_dio_pdu_receive(node_t *node, node_t *incoming_node, r
         }
 
         measure_connect_update();
-        measure_converg_update();
     }
 
     return TRUE;
 }
 
-static bool event_handler_dao_pdu_send(node_t *node, char *dst_ip_address, rpl_dao_pdu_t *pdu)
+static bool event_handler_dao_pdu_send(node_t *node, address_t dst_address, rpl_dao_pdu_t *pdu)
 {
     measure_node_add_rpl_dao_message(node, TRUE);
 
-    if (!icmp_node_send(node, dst_ip_address, ICMP_TYPE_RPL, ICMP_RPL_CODE_DAO, pdu)) {
+    if (!icmp_node_send(node, dst_address, ICMP_TYPE_RPL, ICMP_RPL_CODE_DAO, pdu)) {
         return FALSE;
     }
 
@@ -1264,27 +1557,61 @@ static bool event_handler_dao_pdu_receive(node_t *node, node_t *incoming_node, r
 {
     measure_node_add_rpl_dao_message(node, FALSE);
 
-    /* check if the route already exists */
-    uint16 i, route_count;
-    ip_route_t **route_list = ip_node_get_routes(node, &route_count, pdu->dest, pdu->prefix_len, incoming_node, IP_ROUTE_TYPE_RPL_DAO);
+    if (pdu->target_count == 0) {
+        return TRUE;
+    }
+
+    if (!node_is_storing(node)) {
+        return dao_pdu_receive_non_storing(node, incoming_node, pdu);
+    }
+
+    /* sorted targets, so that each existing route is looked up with a binary search */
+    qsort(pdu->target_list, pdu->target_count, sizeof(rpl_dao_target_t), dao_target_compare);
+
+    uint16 i, j;
+    for (i = 1, j = 1; i < pdu->target_count; i++) { /* drop duplicate targets */
+        if (dao_target_compare(&pdu->target_list[j - 1], &pdu->target_list[i]) != 0) {
+            pdu->target_list[j++] = pdu->target_list[i];
+        }
+    }
+    pdu->target_count = j;
+
+    bool *target_found = malloc(pdu->target_count * sizeof(bool));
+    memset(target_found, 0, pdu->target_count * sizeof(bool));
+
+    /* mark the existing routes via this neighbor as updated, in a single pass */
+    uint16 route_count;
+    ip_route_t **route_list = ip_node_get_routes(node, &route_count, NULL, -1, incoming_node, IP_ROUTE_TYPE_RPL_DAO);
 
-    /* mark routes as updated, if they exist */
     for (i = 0; i < route_count; i++) {
         ip_route_t *route = route_list[i];
-        route->update_time = rs_system->now;
+        rpl_dao_target_t key = { route->dst_id, route->prefix_len, ADDR_UNKNOWN };
+
+        rpl_dao_target_t *target = bsearch(&key, pdu->target_list, pdu->target_count, sizeof(rpl_dao_target_t), dao_target_compare);
+        if (target != NULL) {
+            route->update_time = rs_system->now;
+            target_found[target - pdu->target_list] = TRUE;
+        }
     }
 
     if (route_list != NULL) {
         free(route_list);
     }
 
-    if (route_count == 0) { /* the route doesn't exist */
-        ip_route_t *route = ip_node_add_route(node, pdu->dest, pdu->prefix_len, incoming_node, IP_ROUTE_TYPE_RPL_DAO, NULL);
+    /* add the routes that don't exist yet */
+    for (i = 0; i < pdu->target_count; i++) {
+        if (target_found[i]) {
+            continue;
+        }
+
+        ip_route_t *route = ip_node_add_route(node, addr_to_string(pdu->target_list[i].dest), pdu->target_list[i].prefix_len, incoming_node, IP_ROUTE_TYPE_RPL_DAO, NULL);
 
         /* schedule a timeout to remove this route */
         rs_system_schedule_event(node, rpl_event_dao_timeout_check, route, NULL, rs_system->rpl_dao_remove_timeout);
     }
 
+    free(target_found);
+
     return TRUE;
 }
 
@@ -1331,7 +1658,9 @@ static bool event_handler_neighbor_detach(node_t *node, node_t *neighbor_node)
 
         if (lost_pref_parent) {
             node->rpl_info->joined_dodag->pref_parent = NULL;
+            next_hop_list_invalidate(node);
             choose_parents_and_siblings(node);
+            tree_update(node);
         }
     }
     else {
@@ -1374,12 +1703,13 @@ static bool event_handler_neighbor_detach(node_t *node, node_t *neighbor_node)
 
         if (lost_pref_parent) {
             node->rpl_info->joined_dodag->pref_parent = NULL;
+            next_hop_list_invalidate(node);
             choose_parents_and_siblings(node);
+            tree_update(node);
         }
     }
 
     measure_connect_update();
-    measure_converg_update();
 
     return TRUE;
 }
@@ -1388,6 +1718,44 @@ static bool event_handler_new_pref_parent(node_t *node, node_t *pref_parent){
 	return TRUE;
 }
 
+static bool event_handler_loop_detected(node_t *node, node_t *pref_parent)
+{
+#ifdef DEBUG_RPL
+    if (node->rpl_info->tree_root != NULL) { /* the loop was broken in the meantime */
+        return TRUE;
+    }
+
+    /* walk the loop once, it is reachable from the node through the preferred parents */
+    char loop_str[256];
+    loop_str[0] = '\0';
+
+    uint32 stamp = ++tree_stamp;
+    node_t *loop_node = node;
+    while (loop_node != NULL && loop_node->rpl_info->tree_stamp != stamp) {
+        loop_node->rpl_info->tree_stamp = stamp;
+        loop_node = loop_node->rpl_info->tree_parent;
+    }
+
+    node_t *start_node = loop_node;
+    while (loop_node != NULL) {
+        if (strlen(loop_str) + strlen(loop_node->phy_info->name) + 2 < sizeof(loop_str)) {
+            strcat(loop_str, loop_node->phy_info->name);
+            strcat(loop_str, " ");
+        }
+
+        loop_node = loop_node->rpl_info->tree_parent;
+        if (loop_node == start_node) {
+            break;
+        }
+    }
+
+    rs_debug(DEBUG_RPL, "node '%s': preferring '%s' closed a loop [%s]",
+            node->phy_info->name, pref_parent->phy_info->name, loop_str);
+#endif /* DEBUG_RPL */
+
+    return TRUE;
+}
+
 static bool event_handler_forward_failure(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu)
 {
     measure_node_add_forward_failure(node);
@@ -1416,12 +1784,16 @@ static bool event_handler_forward_inconsistency(node_t *node, node_t *incoming_n
 
 static bool event_handler_trickle_t_timeout(node_t *node)
 {
-    // todo implement DIO message redundancy detection
+    /* the interval goes on until its end, whatever we decide to do at t */
+    node->rpl_info->trickle_phase = RPL_TRICKLE_PHASE_IDLE;
+    trickle_schedule(node, RPL_TRICKLE_PHASE_I, node->rpl_info->trickle_i - node->rpl_info->trickle_t);
 
+    /* suppress our DIO if enough consistent ones were heard in this interval (RFC 6206, section 4.2) */
     if (rpl_node_is_root(node)) {
         if ((node->rpl_info->trickle_c >= node->rpl_info->root_info->dio_redundancy_constant) &&
                 (node->rpl_info->root_info->dio_redundancy_constant != 0xFF)) {
 
+            measure_node_add_rpl_dio_suppressed(node);
             return TRUE;
         }
     }
@@ -1429,6 +1801,7 @@ static bool event_handler_trickle_t_timeout(node_t *node)
         if ((node->rpl_info->trickle_c >= node->rpl_info->joined_dodag->dio_redundancy_constant) &&
                 (node->rpl_info->joined_dodag->dio_redundancy_constant != 0xFF)) {
 
+            measure_node_add_rpl_dio_suppressed(node);
             return TRUE;
         }
     }
@@ -1441,7 +1814,7 @@ static bool event_handler_trickle_t_timeout(node_t *node)
 
     rpl_dio_pdu_t *dio_pdu = create_current_dio_message(node, TRUE);
     if (dio_pdu != NULL) {
-        if (!rpl_node_send_dio(node, NULL, dio_pdu)) {
+        if (!rpl_node_send_dio(node, ADDR_BROADCAST, dio_pdu)) {
             rpl_dio_pdu_destroy(dio_pdu);
             return FALSE;
         }
@@ -1452,6 +1825,8 @@ static bool event_handler_trickle_t_timeout(node_t *node)
 
 static bool event_handler_trickle_i_timeout(node_t *node)
 {
+    node->rpl_info->trickle_phase = RPL_TRICKLE_PHASE_IDLE;
+
     if (rpl_node_is_root(node)) {
         if (node->rpl_info->trickle_i_doublings_so_far < node->rpl_info->root_info->dio_interval_doublings) {
             node->rpl_info->trickle_i_doublings_so_far++;
@@ -1470,10 +1845,10 @@ static bool event_handler_trickle_i_timeout(node_t *node)
         }
         else { /* enough with poisoning */
             bool same;
-            rpl_dio_pdu_t *preferred_dodag_pdu = get_preferred_dodag_dio_pdu(node, &same);
+            rpl_dio_record_t *preferred_dodag_record = get_preferred_dodag_dio_record(node, &same);
 
-            if (preferred_dodag_pdu != NULL) {
-                join_dodag_iteration(node, preferred_dodag_pdu);
+            if (preferred_dodag_record != NULL) {
+                join_dodag_iteration(node, preferred_dodag_record);
                 choose_parents_and_siblings(node);
             }
             else {
@@ -1487,13 +1862,7 @@ static bool event_handler_trickle_i_timeout(node_t *node)
         return FALSE; /* this should never happen */
     }
 
-    uint32 t = (rs_system_random() % (node->rpl_info->trickle_i / 2)) + node->rpl_info->trickle_i / 2;
-
-    rs_system_schedule_event(node, rpl_event_trickle_t_timeout, NULL, NULL, t);
-    rs_system_schedule_event(node, rpl_event_trickle_i_timeout, NULL, NULL, node->rpl_info->trickle_i);
-
-    node->rpl_info->last_trickle_t_schedule_time = rs_system->now + t;;
-    node->rpl_info->last_trickle_i_schedule_time = rs_system->now + node->rpl_info->trickle_i;
+    trickle_start_interval(node);
 
     measure_converg_update();
 
@@ -1508,32 +1877,37 @@ static bool event_handler_dao_send(node_t *node)
         return TRUE;
     }
 
-    /* for every DAO unicast route send a DAO message to the preferred parent */
-    uint16 i, route_count;
-    ip_route_t **route_list = ip_node_get_routes(node, &route_count, NULL, -1, NULL, IP_ROUTE_TYPE_RPL_DAO);
+    /* advertise ourselves and every DAO unicast route to the preferred parent,
+     * packing as many targets in a DAO message as allowed */
+    address_t parent_address = node->rpl_info->joined_dodag->pref_parent->node->ip_info->address_id;
+    uint16 max_targets = rs_system->rpl_dao_max_targets;
+    bool storing = node->rpl_info->joined_dodag->storing;
 
-    for (i = 0; i < route_count; i++) {
-        ip_route_t *route = route_list[i];
-        rpl_dao_pdu_t *dao_pdu = rpl_dao_pdu_create();
+    /* in non-storing mode we have no routes to advertise, the root only learns our parent */
+    rpl_dao_pdu_t *dao_pdu = rpl_dao_pdu_create();
+    rpl_dao_pdu_add_target(dao_pdu, node->ip_info->address_id, strlen(node->ip_info->address) * 4, storing ? ADDR_UNKNOWN : parent_address);
+    /* the other dao_pdu fields are ignored for now */
+
+    uint16 i, route_count = 0;
+    ip_route_t **route_list = NULL;
+    if (storing) {
+        route_list = ip_node_get_routes(node, &route_count, NULL, -1, NULL, IP_ROUTE_TYPE_RPL_DAO);
+    }
 
-        dao_pdu->dest = strdup(route->dst);
-        dao_pdu->prefix_len = route->prefix_len;
-        /* the other dao_pdu fields are ignored for now */
+    for (i = 0; i < route_count; i++) {
+        if (max_targets > 0 && dao_pdu->target_count >= max_targets) {
+            rpl_node_send_dao(node, parent_address, dao_pdu);
+            dao_pdu = rpl_dao_pdu_create();
+        }
 
-        rpl_node_send_dao(node, node->rpl_info->joined_dodag->pref_parent->node->ip_info->address, dao_pdu);
+        rpl_dao_pdu_add_target(dao_pdu, route_list[i]->dst_id, route_list[i]->prefix_len, ADDR_UNKNOWN);
     }
 
     if (route_list != NULL) {
         free(route_list);
     }
 
-    /* send a DAO message for ourselves */
-    rpl_dao_pdu_t *dao_pdu = rpl_dao_pdu_create();
-
-    dao_pdu->dest = strdup(node->ip_info->address);
-    dao_pdu->prefix_len = strlen(node->ip_info->address) * 4;
-
-    rpl_node_send_dao(node, node->rpl_info->joined_dodag->pref_parent->node->ip_info->address, dao_pdu);
+    rpl_node_send_dao(node, parent_address, dao_pdu);
 
     /* reschedule the "Delay DAO timer" */
     rs_system_schedule_event(node, rpl_event_dao_send, NULL, NULL, compute_dao_delay(node));
@@ -1556,10 +1930,11 @@ static bool event_handler_dao_timeout_check(node_t *node, ip_route_t *route)
 
 static bool event_handler_seq_num_autoinc()
 {
-    uint16 i;
-    for (i = 0; i < seq_num_mapping_count; i++) {
-        seq_num_mapping_t *mapping = seq_num_mapping_list[i];
-        mapping->seq_num++;
+    uint32 i;
+    for (i = 0; i < seq_num_mapping_size; i++) {
+        if (seq_num_mapping_table[i].key != 0) {
+            seq_num_mapping_table[i].seq_num++;
+        }
     }
 
     uint16 node_count;
@@ -1586,61 +1961,117 @@ static bool event_handler_seq_num_autoinc()
     return TRUE;
 }
 
-static seq_num_mapping_t *seq_num_mapping_get(char *dodag_id)
+static seq_num_mapping_t *seq_num_mapping_find(address_t dodag_id)
 {
-    uint16 i;
-    for (i = 0; i < seq_num_mapping_count; i++) {
-        seq_num_mapping_t *mapping = seq_num_mapping_list[i];
-
-        if (strcmp(mapping->dodag_id, dodag_id) == 0) {
-            return mapping;
-        }
+    if (seq_num_mapping_count == 0 || dodag_id == ADDR_UNKNOWN) {
+        return NULL;
     }
 
-    seq_num_mapping_list = realloc(seq_num_mapping_list, (seq_num_mapping_count + 1) * sizeof(seq_num_mapping_t *));
-
-    seq_num_mapping_list[seq_num_mapping_count] = malloc(sizeof(seq_num_mapping_t));
-    seq_num_mapping_list[seq_num_mapping_count]->dodag_id = strdup(dodag_id);
-    seq_num_mapping_list[seq_num_mapping_count]->seq_num = 0;
+    uint32 slot = seq_num_mapping_slot(dodag_id + 1);
+    if (seq_num_mapping_table[slot].key == 0) {
+        return NULL;
+    }
 
-    return seq_num_mapping_list[seq_num_mapping_count++];
+    return &seq_num_mapping_table[slot];
 }
 
-static void seq_num_mapping_cleanup()
+static void seq_num_mapping_acquire(address_t dodag_id)
 {
-    uint16 i;
-    for (i = 0; i < seq_num_mapping_count; i++) {
-        seq_num_mapping_t *mapping = seq_num_mapping_list[i];
+    if (2 * (seq_num_mapping_count + 1) > seq_num_mapping_size) {
+        seq_num_mapping_grow();
+    }
 
-        bool in_use = FALSE;
+    seq_num_mapping_t *mapping = &seq_num_mapping_table[seq_num_mapping_slot(dodag_id + 1)];
+    if (mapping->key == 0) {
+        mapping->key = dodag_id + 1;
+        mapping->seq_num = 0;
+        mapping->ref_count = 0;
+        seq_num_mapping_count++;
+    }
 
-        nodes_lock();
-        uint16 j;
-        for (j = 0; j < rs_system->node_count; j++) {
-            node_t *node = rs_system->node_list[j];
+    mapping->ref_count++;
+}
 
-            if (!rpl_node_is_root(node)) { /* only root nodes modify sequence numbers */
-                continue;
-            }
+static void seq_num_mapping_release(address_t dodag_id)
+{
+    seq_num_mapping_t *mapping = seq_num_mapping_find(dodag_id);
+    if (mapping == NULL) { /* dropped by a reset */
+        return;
+    }
 
-            if (strcmp(node->rpl_info->root_info->dodag_id, mapping->dodag_id) == 0) {
-                in_use = TRUE;
-                break;
-            }
-        }
-        nodes_unlock();
+    if (--mapping->ref_count > 0) {
+        return;
+    }
 
-        if (in_use) {
-            continue;
+    /* no root left for this dodag id, shift the following entries of the cluster back */
+    uint32 mask = seq_num_mapping_size - 1;
+    uint32 slot = mapping - seq_num_mapping_table;
+    uint32 next = slot;
+    while (TRUE) {
+        next = (next + 1) & mask;
+        if (seq_num_mapping_table[next].key == 0) {
+            break;
         }
 
-        for (j = i; j < seq_num_mapping_count - 1; j++) {
-            seq_num_mapping_list[j] = seq_num_mapping_list[j + 1];
+        uint32 home = (seq_num_mapping_table[next].key * 2654435761u) & mask;
+        if (((next - home) & mask) >= ((next - slot) & mask)) { /* the entry may fill the hole */
+            seq_num_mapping_table[slot] = seq_num_mapping_table[next];
+            slot = next;
         }
+    }
+
+    seq_num_mapping_table[slot].key = 0;
+    seq_num_mapping_count--;
+}
+
+static void seq_num_mapping_sync(node_t *node)
+{
+    /* a node holds a reference on the mapping of its dodag id for as long as it is root */
+    address_t dodag_id = rpl_node_is_root(node) ? node->rpl_info->root_info->interned_dodag_id : ADDR_UNKNOWN;
+
+    if (node->rpl_info->seq_num_dodag_id == dodag_id) {
+        return;
+    }
+
+    if (node->rpl_info->seq_num_dodag_id != ADDR_UNKNOWN) {
+        seq_num_mapping_release(node->rpl_info->seq_num_dodag_id);
+    }
+    if (dodag_id != ADDR_UNKNOWN) {
+        seq_num_mapping_acquire(dodag_id);
+    }
+
+    node->rpl_info->seq_num_dodag_id = dodag_id;
+}
 
-        free(mapping);
+static uint32 seq_num_mapping_slot(uint32 key)
+{
+    uint32 mask = seq_num_mapping_size - 1;
+    uint32 slot = (key * 2654435761u) & mask;
+
+    while (seq_num_mapping_table[slot].key != 0 && seq_num_mapping_table[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void seq_num_mapping_grow()
+{
+    seq_num_mapping_t *old_table = seq_num_mapping_table;
+    uint32 old_size = seq_num_mapping_size;
 
-        seq_num_mapping_count--;
+    seq_num_mapping_size = (old_size > 0) ? 2 * old_size : RPL_SEQ_NUM_MAPPING_INITIAL_SIZE;
+    seq_num_mapping_table = calloc(seq_num_mapping_size, sizeof(seq_num_mapping_t));
+
+    uint32 i;
+    for (i = 0; i < old_size; i++) {
+        if (old_table[i].key != 0) {
+            seq_num_mapping_table[seq_num_mapping_slot(old_table[i].key)] = old_table[i];
+        }
+    }
+
+    if (old_table != NULL) {
+        free(old_table);
     }
 }
 
@@ -1649,19 +2080,20 @@ static bool dio_pdu_changed(rpl_neighbor_t *neighbor, rpl_dio_pdu_t *dio_pdu)
     rs_assert(neighbor != NULL);
     rs_assert(dio_pdu != NULL);
 
-    if (neighbor->last_dio_message == NULL) {
+    if (!neighbor->has_last_dio) {
         return TRUE;
     }
-    else { /* neighbor->last_dio_message not NULL */
-        bool base_changed = (strcmp(neighbor->last_dio_message->dodag_id, dio_pdu->dodag_id) != 0) ||
-                (neighbor->last_dio_message->dodag_pref != dio_pdu->dodag_pref) ||
-                (neighbor->last_dio_message->seq_num != dio_pdu->seq_num) ||
-                (neighbor->last_dio_message->rank != dio_pdu->rank) ||
-                (neighbor->last_dio_message->dstn != dio_pdu->dstn) ||
-                (neighbor->last_dio_message->dao_stored != dio_pdu->dao_stored) ||
-                (neighbor->last_dio_message->grounded != dio_pdu->grounded) ||
-                (neighbor->last_dio_message->dao_supported != dio_pdu->dao_supported) ||
-                (neighbor->last_dio_message->dao_trigger != dio_pdu->dao_trigger);
+    else {
+        bool base_changed = (neighbor->last_dio.dodag_id != dio_pdu->interned_dodag_id) ||
+                (neighbor->last_dio.dodag_pref != dio_pdu->dodag_pref) ||
+                (neighbor->last_dio.seq_num != dio_pdu->seq_num) ||
+                (neighbor->last_dio.rank != dio_pdu->rank) ||
+                (neighbor->last_dio.dstn != dio_pdu->dstn) ||
+                (neighbor->last_dio.dao_stored != dio_pdu->dao_stored) ||
+                (neighbor->last_dio.grounded != dio_pdu->grounded) ||
+                (neighbor->last_dio.dao_supported != dio_pdu->dao_supported) ||
+                (neighbor->last_dio.dao_trigger != dio_pdu->dao_trigger) ||
+                (neighbor->last_dio.storing != dio_pdu->storing);
 
         bool dodag_config_changed = dio_pdu_dodag_config_changed(neighbor, dio_pdu);
 
@@ -1669,17 +2101,37 @@ static bool dio_pdu_changed(rpl_neighbor_t *neighbor, rpl_dio_pdu_t *dio_pdu)
     }
 }
 
+static bool dio_pdu_consistent(node_t *node, rpl_dio_pdu_t *dio_pdu)
+{
+    /* a DIO is consistent when it advertises the DODAG iteration we are part of */
+    if (dio_pdu->rank >= RPL_RANK_INFINITY) {
+        return FALSE;
+    }
+
+    if (rpl_node_is_root(node)) {
+        return dio_pdu->interned_dodag_id == node->rpl_info->root_info->interned_dodag_id &&
+                dio_pdu->seq_num == rpl_seq_num_get(node->rpl_info->root_info->interned_dodag_id);
+    }
+    else if (rpl_node_is_joined(node)) {
+        return dio_pdu->interned_dodag_id == node->rpl_info->joined_dodag->interned_dodag_id &&
+                dio_pdu->seq_num == node->rpl_info->joined_dodag->seq_num;
+    }
+    else {
+        return FALSE;
+    }
+}
+
 /*
 static bool dio_pdu_dodag_id_changed(rpl_neighbor_t *neighbor, rpl_dio_pdu_t *dio_pdu)
 {
     rs_assert(neighbor != NULL);
     rs_assert(dio_pdu != NULL);
 
-    if (neighbor->last_dio_message == NULL) {
+    if (!neighbor->has_last_dio) {
         return TRUE;
     }
     else {
-        return (strcmp(neighbor->last_dio_message->dodag_id, dio_pdu->dodag_id) != 0);
+        return (neighbor->last_dio.dodag_id != dio_pdu->interned_dodag_id);
     }
 }
 
@@ -1688,11 +2140,11 @@ static bool dio_pdu_dodag_seq_num_changed(rpl_neighbor_t *neighbor, rpl_dio_pdu_
     rs_assert(neighbor != NULL);
     rs_assert(dio_pdu != NULL);
 
-    if (neighbor->last_dio_message == NULL) {
+    if (!neighbor->has_last_dio) {
         return TRUE;
     }
     else {
-        return (neighbor->last_dio_message->seq_num != dio_pdu->seq_num);
+        return (neighbor->last_dio.seq_num != dio_pdu->seq_num);
     }
 }
 
@@ -1701,11 +2153,11 @@ static bool dio_pdu_dodag_rank_increased(rpl_neighbor_t *neighbor, rpl_dio_pdu_t
     rs_assert(neighbor != NULL);
     rs_assert(dio_pdu != NULL);
 
-    if (neighbor->last_dio_message == NULL) {
+    if (!neighbor->has_last_dio) {
         return TRUE;
     }
     else {
-        return (neighbor->last_dio_message->rank > dio_pdu->rank);
+        return (neighbor->last_dio.rank > dio_pdu->rank);
     }
 }
 */
@@ -1719,15 +2171,16 @@ static bool dio_pdu_dodag_config_changed(rpl_neighbor_t *neighbor, rpl_dio_pdu_t
         return FALSE;
     }
 
-    if (neighbor->last_dio_message == NULL || neighbor->last_dio_message->dodag_config_suboption == NULL) {
+    if (!neighbor->has_last_dio || !neighbor->last_dio.has_dodag_config) {
         return TRUE;
     }
     else {
-        return (neighbor->last_dio_message->dodag_config_suboption->dio_interval_doublings != dio_pdu->dodag_config_suboption->dio_interval_doublings) ||
-                (neighbor->last_dio_message->dodag_config_suboption->dio_interval_min != dio_pdu->dodag_config_suboption->dio_interval_min) ||
-                (neighbor->last_dio_message->dodag_config_suboption->dio_redundancy_constant != dio_pdu->dodag_config_suboption->dio_redundancy_constant) ||
-                (neighbor->last_dio_message->dodag_config_suboption->max_rank_inc != dio_pdu->dodag_config_suboption->max_rank_inc) ||
-                (neighbor->last_dio_message->dodag_config_suboption->min_hop_rank_inc != dio_pdu->dodag_config_suboption->min_hop_rank_inc);
+        return (neighbor->last_dio.dio_interval_doublings != dio_pdu->dodag_config_suboption->dio_interval_doublings) ||
+                (neighbor->last_dio.dio_interval_min != dio_pdu->dodag_config_suboption->dio_interval_min) ||
+                (neighbor->last_dio.dio_redundancy_constant != dio_pdu->dodag_config_suboption->dio_redundancy_constant) ||
+                (neighbor->last_dio.max_rank_inc != dio_pdu->dodag_config_suboption->max_rank_inc) ||
+                (neighbor->last_dio.min_hop_rank_inc != dio_pdu->dodag_config_suboption->min_hop_rank_inc) ||
+                (neighbor->last_dio.ocp != dio_pdu->dodag_config_suboption->ocp);
     }
 }
 
@@ -1744,12 +2197,15 @@ static void start_dio_poisoning(node_t *node)
 
     rpl_node_remove_all_parents(node);
     rpl_node_remove_all_siblings(node);
+    node->rpl_info->joined_dodag->candidate_count = 0;
     node->rpl_info->joined_dodag->pref_parent = NULL;
+    next_hop_list_invalidate(node);
     forget_neighbor_messages(node);
 
     node->rpl_info->joined_dodag->rank = RPL_RANK_INFINITY;
     node->rpl_info->joined_dodag->lowest_rank = RPL_RANK_INFINITY;
     node->rpl_info->poison_count_so_far = 0;
+    tree_update(node);
 
     reset_trickle_timer(node);
 }
@@ -1766,6 +2222,7 @@ static void start_as_root(node_t *node)
     if (node->rpl_info->joined_dodag != NULL) {
         rpl_dodag_destroy(node->rpl_info->joined_dodag);
         node->rpl_info->joined_dodag = NULL;
+        next_hop_list_invalidate(node);
     }
 
     if (node->rpl_info->root_info->dodag_id == NULL) {
@@ -1776,21 +2233,26 @@ static void start_as_root(node_t *node)
             node->rpl_info->root_info->dodag_id = strdup(node->rpl_info->root_info->configured_dodag_id);
         }
     }
+    node->rpl_info->root_info->interned_dodag_id = addr_intern(node->rpl_info->root_info->dodag_id); /* the id may have been set from outside */
+
+    source_route_table_clear(node); /* relearned from the DAOs of this dodag */
+    seq_num_mapping_sync(node);
 
     rs_debug(DEBUG_RPL, "node '%s': starting as root (dodag_id = '%s', grounded = %s, pref = %d)",
             node->phy_info->name, node->rpl_info->root_info->dodag_id,
             (node->rpl_info->root_info->grounded ? "yes" : "no"), node->rpl_info->root_info->dodag_pref);
 
+    tree_update(node);
     reset_trickle_timer(node);
 }
 
-static void join_dodag_iteration(node_t *node, rpl_dio_pdu_t *dio_pdu)
+static void join_dodag_iteration(node_t *node, rpl_dio_record_t *dio_record)
 {
     rs_assert(node != NULL);
-    rs_assert(dio_pdu != NULL);
+    rs_assert(dio_record != NULL);
 
     rs_debug(DEBUG_RPL, "node '%s': joining DODAG iteration dodag_id = '%s', grounded = %s, pref = %d, seq_num = %d",
-            node->phy_info->name, dio_pdu->dodag_id, (dio_pdu->grounded ? "yes" : "no"), dio_pdu->dodag_pref, dio_pdu->seq_num);
+            node->phy_info->name, addr_to_string(dio_record->dodag_id), (dio_record->grounded ? "yes" : "no"), dio_record->dodag_pref, dio_record->seq_num);
 
     if (node->rpl_info->joined_dodag != NULL) {
         /* forget about previously learned DIO routes */
@@ -1801,17 +2263,20 @@ static void join_dodag_iteration(node_t *node, rpl_dio_pdu_t *dio_pdu)
     if (node->rpl_info->root_info->dodag_id != NULL) { /* if we were previously a root */
         free(node->rpl_info->root_info->dodag_id);
         node->rpl_info->root_info->dodag_id = NULL;
+        node->rpl_info->root_info->interned_dodag_id = ADDR_UNKNOWN;
+        source_route_table_clear(node);
     }
 
-    node->rpl_info->joined_dodag = rpl_dodag_create(dio_pdu);
+    node->rpl_info->joined_dodag = rpl_dodag_create(dio_record);
+    next_hop_list_invalidate(node);
+    seq_num_mapping_sync(node);
+    tree_update(node);
 
     rs_system_cancel_event(node, rpl_event_dao_send, NULL, NULL, 0);
     if (node->rpl_info->joined_dodag->dao_supported) {
         rs_system_schedule_event(node, rpl_event_dao_send, NULL, NULL, 0);
     }
 
-    seq_num_mapping_cleanup();
-
     reset_trickle_timer(node);
 }
 
@@ -1830,13 +2295,17 @@ static void update_dodag_config(node_t *node, rpl_dio_pdu_t *dio_pdu)
     dodag->max_rank_inc = dio_pdu->dodag_config_suboption->max_rank_inc;
     dodag->min_hop_rank_inc = dio_pdu->dodag_config_suboption->min_hop_rank_inc;
 
-    rs_debug(DEBUG_RPL, "node '%s': in dodag_id = '%s', updated dodag config (i_min = %d, i_doublings = %d, c_treshold = %d, max_rank_inc = %d, min_hop_rank_inc = %d)",
+    bool ocp_changed = (dodag->ocp != dio_pdu->dodag_config_suboption->ocp);
+    dodag->ocp = dio_pdu->dodag_config_suboption->ocp;
+
+    rs_debug(DEBUG_RPL, "node '%s': in dodag_id = '%s', updated dodag config (i_min = %d, i_doublings = %d, c_treshold = %d, max_rank_inc = %d, min_hop_rank_inc = %d, of = %s)",
             node->phy_info->name, dodag->dodag_id,
             dodag->dio_interval_min,
             dodag->dio_interval_doublings,
             dodag->dio_redundancy_constant,
             dodag->max_rank_inc,
-            dodag->min_hop_rank_inc);
+            dodag->min_hop_rank_inc,
+            rpl_of_get_name(dodag->ocp));
 
     rs_system_cancel_event(node, rpl_event_dao_send, NULL, NULL, 0);
     if (node->rpl_info->joined_dodag->dao_supported) {
@@ -1844,66 +2313,11 @@ static void update_dodag_config(node_t *node, rpl_dio_pdu_t *dio_pdu)
     }
 
     reset_trickle_timer(node);
-}
 
-/*
- *
- * Measure connectivity with pref parent and root
- *
- */
-
-bool check_node(node_t* node, node_t** path_list, int list_count){
-	int i;
-	for(i = 0; i < list_count; i++) if(node == path_list[i]) return TRUE;
-	return FALSE;
-}
-
-int is_connected_rec(node_t* node, node_t** path_list, int list_count){
-	if( rpl_node_is_root(node) )
-		if(node->rpl_info->root_info->grounded)
-			return 1;
-		else
-			return 0;
-	else // check for loop
-		if(check_node(node,path_list, list_count)){
-			printf("loop detected :");
-			int i;
-			for(i = 0; i < list_count; i++) printf(" %s ", path_list[i]->phy_info->name);
-			printf("%s\n", node->phy_info->name);
-			free(path_list);
-			return 0;
-		}
-	else
-		if( rpl_node_is_joined(node) ){
-			path_list = realloc(path_list, (list_count + 1) * sizeof(node_t*));
-			path_list[list_count] = node;
-			return is_connected_rec(node->rpl_info->joined_dodag->pref_parent->node, path_list, list_count+1);
-		}
-		else
-			return 0;
-}
-
-int is_connected(node_t* node){
-	if( rpl_node_is_root(node) )
-			if(node->rpl_info->root_info->grounded)
-				return 1;
-			else
-				return 0;
-	else
-		if( rpl_node_is_joined(node) ){
-			node_t** path_list = malloc(sizeof(node_t*));
-			path_list[0] = node;
-			return is_connected_rec(node->rpl_info->joined_dodag->pref_parent->node, path_list, 1);
-		}
-		else
-			return 0;
+    if (ocp_changed) { /* every cached candidate rank is now stale */
+        choose_parents_and_siblings(node);
+    }
 }
-/*
- *
- * End Measure
- *
- */
-
 
 static void choose_parents_and_siblings(node_t *node)
 {
@@ -1912,64 +2326,98 @@ static void choose_parents_and_siblings(node_t *node)
 
     rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
 
-    /* forget about previous DIO routes */
-    ip_node_rem_routes(node, NULL, -1, NULL, IP_ROUTE_TYPE_RPL_DIO);
+    /* reevaluate every neighbor, refreshing the cached candidate ranks */
+    uint16 i;
+    for (i = 0; i < node->rpl_info->neighbor_count; i++) {
+        rpl_neighbor_t *neighbor = node->rpl_info->neighbor_list[i];
 
-    rpl_node_remove_all_parents(node);
-    rpl_node_remove_all_siblings(node);
+        if (neighbor_is_candidate(node, neighbor)) {
+            candidate_heap_update(dodag, neighbor, compute_candidate_rank(node, neighbor));
+        }
+        else {
+            candidate_heap_remove(dodag, neighbor);
+        }
+    }
 
-    int16 best_rank_index = -1;
+    if (!choose_pref_parent(node)) {
+        return;
+    }
 
-    uint8 matching_ranks[node->rpl_info->neighbor_count];
+    classify_candidates(node, TRUE);
 
-    uint16 i;
-    for (i = 0; i < node->rpl_info->neighbor_count; i++) {
-        rpl_neighbor_t *neighbor = node->rpl_info->neighbor_list[i];
+    print_parents_and_siblings(node);
+}
 
-        matching_ranks[i] = RPL_RANK_INFINITY;
+static void update_parents_and_siblings(node_t *node, rpl_neighbor_t *neighbor)
+{
+    rs_assert(node != NULL);
+    rs_assert(node->rpl_info->joined_dodag != NULL);
 
-        if (neighbor->last_dio_message == NULL) { /* ignore neighbors who haven't sent any DIO */
-            continue;
-        }
+    rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
+    uint16 old_rank = dodag->rank;
 
-        if (strcmp(neighbor->last_dio_message->dodag_id, dodag->dodag_id) != 0) { /* ignore neighbors from different DODAGs */
-            continue;
-        }
+    /* only the given neighbor (a new DIO or link sample) is reevaluated, the others keep their cached candidate ranks */
+    if (neighbor_is_candidate(node, neighbor)) {
+        candidate_heap_update(dodag, neighbor, compute_candidate_rank(node, neighbor));
+    }
+    else {
+        candidate_heap_remove(dodag, neighbor);
+    }
 
-        if (neighbor->last_dio_message->seq_num != dodag->seq_num) { /* ignore neighbors from different DODAG iterations */
-            continue;
-        }
+    if (!choose_pref_parent(node)) {
+        return;
+    }
 
-        if (neighbor->last_dio_message->rank >= RPL_RANK_INFINITY) { /* ignore neighbors that started poisoning */
-            continue;
-        }
+    if (dodag->rank != old_rank) { /* the parent/sibling boundary moved, every candidate may change its role */
+        classify_candidates(node, FALSE);
+    }
+    else {
+        classify_candidate(node, neighbor);
+    }
 
-        if (neighbor->last_dio_message->rank > dodag->rank) { /* ignore and forget neighbors that aren't our parents or siblings */
-            rpl_dio_pdu_destroy(neighbor->last_dio_message);
-            neighbor->last_dio_message = NULL;
-            continue;
-        }
+    print_parents_and_siblings(node);
+}
 
-        matching_ranks[i] = compute_candidate_rank(node, neighbor);
+static bool neighbor_is_candidate(node_t *node, rpl_neighbor_t *neighbor)
+{
+    rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
 
-        if (best_rank_index == -1) {
-            best_rank_index = i;
-            continue;
-        }
+    if (!neighbor->has_last_dio) { /* ignore neighbors who haven't sent any DIO */
+        return FALSE;
+    }
 
-        if (matching_ranks[i] < matching_ranks[best_rank_index]) {
-            best_rank_index = i;
-        }
+    if (neighbor->last_dio.dodag_id != dodag->interned_dodag_id) { /* ignore neighbors from different DODAGs */
+        return FALSE;
+    }
+
+    if (neighbor->last_dio.seq_num != dodag->seq_num) { /* ignore neighbors from different DODAG iterations */
+        return FALSE;
+    }
+
+    if (neighbor->last_dio.rank >= RPL_RANK_INFINITY) { /* ignore neighbors that started poisoning */
+        return FALSE;
     }
 
-    if (best_rank_index == -1) { /* no valid neighbors found for this current DODAG iteration */
+    if (neighbor->last_dio.rank > dodag->rank) { /* ignore and forget neighbors that aren't our parents or siblings */
+        neighbor->has_last_dio = FALSE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static bool choose_pref_parent(node_t *node)
+{
+    rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
+
+    if (dodag->candidate_count == 0) { /* no valid neighbors found for this current DODAG iteration */
         rs_debug(DEBUG_RPL, "node '%s': no valid neighbors left in dodag_id = '%s'", node->phy_info->name, dodag->dodag_id);
 
         bool same;
-        rpl_dio_pdu_t *preferred_dodag_pdu = get_preferred_dodag_dio_pdu(node, &same);
+        rpl_dio_record_t *preferred_dodag_record = get_preferred_dodag_dio_record(node, &same);
 
-        if (preferred_dodag_pdu != NULL && !same) { /* found something interesting around */
-            join_dodag_iteration(node, preferred_dodag_pdu);
+        if (preferred_dodag_record != NULL && !same) { /* found something interesting around */
+            join_dodag_iteration(node, preferred_dodag_record);
             choose_parents_and_siblings(node);
         }
         else { /* didn't find anything interesting, we're the best, start floating or poisoning */
@@ -1981,10 +2429,19 @@ static void choose_parents_and_siblings(node_t *node)
             }
         }
 
-        return;
+        return FALSE;
+    }
+
+    rpl_neighbor_t *best = dodag->candidate_heap[0];
+
+    /* stick to the current preferred parent, unless the best candidate is better by more than the threshold */
+    if (dodag->pref_parent != NULL && candidate_heap_contains(dodag, dodag->pref_parent) &&
+            dodag->pref_parent->candidate_rank <= best->candidate_rank + rs_system->rpl_parent_switch_threshold &&
+            dodag->pref_parent->candidate_rank - dodag->lowest_rank <= dodag->max_rank_inc) {
+        best = dodag->pref_parent;
     }
 
-    uint8 best_rank = matching_ranks[best_rank_index];
+    uint16 best_rank = best->candidate_rank;
     if (best_rank - dodag->lowest_rank > dodag->max_rank_inc || best_rank >= RPL_RANK_INFINITY) { /* rank would increase too much */
         rs_debug(DEBUG_RPL, "node '%s': in dodag_id = '%s', new rank (%d) would exceed the limit (%d + %d)",
                 node->phy_info->name, dodag->dodag_id, best_rank, dodag->lowest_rank, dodag->max_rank_inc);
@@ -1992,14 +2449,14 @@ static void choose_parents_and_siblings(node_t *node)
         /* try to follow the former preferred parent */
 
         if (rs_system->rpl_prefer_floating &&
-                node->rpl_info->joined_dodag->pref_parent != NULL &&
-                node->rpl_info->joined_dodag->pref_parent->last_dio_message != NULL &&
-                node->rpl_info->joined_dodag->pref_parent->last_dio_message->rank < RPL_RANK_INFINITY) {
+                dodag->pref_parent != NULL &&
+                dodag->pref_parent->has_last_dio &&
+                dodag->pref_parent->last_dio.rank < RPL_RANK_INFINITY) {
 
             rs_debug(DEBUG_RPL, "node '%s': following parent on dodag_id = '%s'",
-                    node->phy_info->name, node->rpl_info->joined_dodag->pref_parent->last_dio_message->dodag_id);
+                    node->phy_info->name, addr_to_string(dodag->pref_parent->last_dio.dodag_id));
 
-            join_dodag_iteration(node, node->rpl_info->joined_dodag->pref_parent->last_dio_message);
+            join_dodag_iteration(node, &dodag->pref_parent->last_dio);
             choose_parents_and_siblings(node);
         }
         else {
@@ -2008,7 +2465,7 @@ static void choose_parents_and_siblings(node_t *node)
             start_dio_poisoning(node);
         }
 
-        return;
+        return FALSE;
     }
 
     dodag->rank = best_rank;
@@ -2016,46 +2473,93 @@ static void choose_parents_and_siblings(node_t *node)
         dodag->lowest_rank = best_rank;
     }
 
+    /* the default route is replaced only when the preferred parent actually changes */
+    if (best != dodag->pref_parent) {
+        node_t* old_pref_parent = ((dodag->pref_parent==NULL)?(NULL):(dodag->pref_parent->node));
+        dodag->pref_parent = best;
+        next_hop_list_invalidate(node);
+        if(dodag->pref_parent->node != old_pref_parent){
+        	rs_system_schedule_event(node, rpl_event_new_pref_parent, NULL, NULL, 0);
+        }
+        tree_update(node);
+
+        rs_debug(DEBUG_RPL, "node '%s': new preferred parent '%s', rank = %d, connected = %s",
+                node->phy_info->name, dodag->pref_parent->node != NULL ? dodag->pref_parent->node->phy_info->name : "<<removed>>",
+                dodag->rank, rpl_node_is_connected(node) ? "yes" : "no");
 
-    node_t* old_pref_parent = ((dodag->pref_parent==NULL)?(NULL):(dodag->pref_parent->node));
-    dodag->pref_parent = node->rpl_info->neighbor_list[best_rank_index];
-    if(dodag->pref_parent->node != old_pref_parent){
-    	rs_system_schedule_event(node, rpl_event_new_pref_parent, NULL, NULL, 0);
-    	printf("%d %s %s %i %i\n", rs_system->now, node->phy_info->name, dodag->pref_parent->node->mac_info->address, dodag->rank, is_connected(node));
+        ip_node_rem_routes(node, NULL, -1, NULL, IP_ROUTE_TYPE_RPL_DIO);
+        ip_node_add_route(node, "0", 0, dodag->pref_parent->node, IP_ROUTE_TYPE_RPL_DIO, NULL);
     }
-    ip_node_add_route(node, "0", 0, dodag->pref_parent->node, IP_ROUTE_TYPE_RPL_DIO, NULL);
 
+    return TRUE;
+}
+
+static void classify_candidates(node_t *node, bool forget_others)
+{
+    uint16 i;
     for (i = 0; i < node->rpl_info->neighbor_count; i++) {
         rpl_neighbor_t *neighbor = node->rpl_info->neighbor_list[i];
 
-        if (matching_ranks[i] >= RPL_RANK_INFINITY) {
-            if (neighbor->last_dio_message != NULL) { /* forget messages from other DODAG iterations */
-                rpl_dio_pdu_destroy(neighbor->last_dio_message);
-                neighbor->last_dio_message = NULL;
-            }
-            continue;
+        if (candidate_heap_contains(node->rpl_info->joined_dodag, neighbor)) {
+            classify_candidate(node, neighbor);
         }
+        else {
+            if (rpl_node_neighbor_is_parent(node, neighbor)) {
+                rpl_node_remove_parent(node, neighbor);
+            }
+            if (rpl_node_neighbor_is_sibling(node, neighbor)) {
+                rpl_node_remove_sibling(node, neighbor);
+            }
 
-        if (neighbor->last_dio_message->rank < best_rank) { /* a parent */
-            rpl_node_add_parent(node, neighbor);
-        }
-        else if (neighbor->last_dio_message->rank == best_rank) { /* a sibling */
-            rpl_node_add_sibling(node, neighbor);
-        }
-        else { /* forget messages from higher ranked nodes */
-            if (neighbor->last_dio_message != NULL) {
-                rpl_dio_pdu_destroy(neighbor->last_dio_message);
-                neighbor->last_dio_message = NULL;
+            if (forget_others && neighbor->has_last_dio) { /* forget messages from other DODAG iterations */
+                neighbor->has_last_dio = FALSE;
             }
         }
     }
+}
+
+static void classify_candidate(node_t *node, rpl_neighbor_t *neighbor)
+{
+    rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
+
+    bool member = candidate_heap_contains(dodag, neighbor);
+    bool want_parent = member && neighbor->last_dio.rank < dodag->rank;
+    bool want_sibling = member && neighbor->last_dio.rank == dodag->rank;
+    bool is_parent = rpl_node_neighbor_is_parent(node, neighbor);
+    bool is_sibling = rpl_node_neighbor_is_sibling(node, neighbor);
+
+    /* the lists are only touched when the role actually changes */
+    if (is_parent && !want_parent) {
+        rpl_node_remove_parent(node, neighbor);
+    }
+    if (is_sibling && !want_sibling) {
+        rpl_node_remove_sibling(node, neighbor);
+    }
+    if (want_parent && !is_parent) {
+        rpl_node_add_parent(node, neighbor);
+    }
+    if (want_sibling && !is_sibling) {
+        rpl_node_add_sibling(node, neighbor);
+    }
+
+    if (!want_parent && !want_sibling) { /* forget messages from higher ranked nodes */
+        candidate_heap_remove(dodag, neighbor);
+
+        if (neighbor->has_last_dio) {
+            neighbor->has_last_dio = FALSE;
+        }
+    }
+}
 
+static void print_parents_and_siblings(node_t *node)
+{
 #ifdef DEBUG_RPL
 
+    uint16 i;
     char parent_list_str[256];
     char sibling_list_str[256];
 
-    dodag = node->rpl_info->joined_dodag;
+    rpl_dodag_t *dodag = node->rpl_info->joined_dodag;
 
     parent_list_str[0] = '\0';
     for (i = 0; i < dodag->parent_count; i++) {
@@ -2091,13 +2595,18 @@ static void choose_parents_and_siblings(node_t *node)
 #endif /* DEBUG_RPL */
 }
 
-static rpl_dio_pdu_t *get_preferred_dodag_dio_pdu(node_t *node, bool *same)
+static rpl_dio_record_t *get_preferred_dodag_dio_record(node_t *node, bool *same)
 {
     rs_assert(node != NULL);
     rs_assert(same != NULL);
 
-    rpl_dio_pdu_t *root_dio_pdu = create_root_dio_message(node, FALSE, FALSE);
-    rpl_dio_pdu_t *best_dio_pdu = root_dio_pdu;
+    /* what we would advertise as root; only grounded, pref and seq_num are compared */
+    rpl_dio_record_t root_dio_record;
+    root_dio_record.grounded = node->rpl_info->root_info->grounded ? 1 : 0;
+    root_dio_record.dodag_pref = node->rpl_info->root_info->dodag_pref;
+    root_dio_record.seq_num = 0xFF;
+
+    rpl_dio_record_t *best_dio_record = &root_dio_record;
 
     rpl_neighbor_t *old_pref_parent = rpl_node_is_joined(node) && rs_system->rpl_prefer_floating ? node->rpl_info->joined_dodag->pref_parent : NULL;
 
@@ -2105,53 +2614,51 @@ static rpl_dio_pdu_t *get_preferred_dodag_dio_pdu(node_t *node, bool *same)
     for (i = 0; i < node->rpl_info->neighbor_count; i++) {
         rpl_neighbor_t *neighbor = node->rpl_info->neighbor_list[i];
 
-        if (neighbor->last_dio_message == NULL) { /* ignore neighbors who haven't sent any DIO */
+        if (!neighbor->has_last_dio) { /* ignore neighbors who haven't sent any DIO */
             continue;
         }
 
-        if (neighbor->last_dio_message->dodag_config_suboption == NULL) { /* ignore neighbors for whom no DODAG config info is available */
+        if (!neighbor->last_dio.has_dodag_config) { /* ignore neighbors for whom no DODAG config info is available */
             continue;
         }
 
-        if (neighbor->last_dio_message->rank >= RPL_RANK_INFINITY) { /* ignore neighbors that started poisoning */
+        if (neighbor->last_dio.rank >= RPL_RANK_INFINITY) { /* ignore neighbors that started poisoning */
             //TODO : no !
         	continue;
         }
 
         if (rpl_node_is_joined(node) &&
-                strcmp(neighbor->last_dio_message->dodag_id, node->rpl_info->joined_dodag->dodag_id) == 0 &&
-                neighbor->last_dio_message->rank >= node->rpl_info->joined_dodag->rank) { /* ignore neighbors of our DODAG with greater or equal rank */
+                neighbor->last_dio.dodag_id == node->rpl_info->joined_dodag->interned_dodag_id &&
+                neighbor->last_dio.rank >= node->rpl_info->joined_dodag->rank) { /* ignore neighbors of our DODAG with greater or equal rank */
 
             continue;
         }
 
-        if (!best_dio_pdu->grounded && neighbor->last_dio_message->grounded) {
-            best_dio_pdu = neighbor->last_dio_message;
+        if (!best_dio_record->grounded && neighbor->last_dio.grounded) {
+            best_dio_record = &neighbor->last_dio;
         }
-        else if (best_dio_pdu->grounded == neighbor->last_dio_message->grounded) {
-            if (best_dio_pdu->dodag_pref < neighbor->last_dio_message->dodag_pref) {
-                best_dio_pdu = neighbor->last_dio_message;
+        else if (best_dio_record->grounded == neighbor->last_dio.grounded) {
+            if (best_dio_record->dodag_pref < neighbor->last_dio.dodag_pref) {
+                best_dio_record = &neighbor->last_dio;
             }
-            else if (best_dio_pdu->dodag_pref == neighbor->last_dio_message->dodag_pref) {
-                if (best_dio_pdu->seq_num < neighbor->last_dio_message->seq_num) {
-                    best_dio_pdu = neighbor->last_dio_message;
+            else if (best_dio_record->dodag_pref == neighbor->last_dio.dodag_pref) {
+                if (best_dio_record->seq_num < neighbor->last_dio.seq_num) {
+                    best_dio_record = &neighbor->last_dio;
                 }
             }
         }
     }
 
-    if (best_dio_pdu != root_dio_pdu) {
-        rpl_dio_pdu_destroy(root_dio_pdu);
-
+    if (best_dio_record != &root_dio_record) {
         if (rpl_node_is_joined(node) || rpl_node_is_poisoning(node)) {
-            *same = (strcmp(node->rpl_info->joined_dodag->dodag_id, best_dio_pdu->dodag_id) == 0) &&
-                    (node->rpl_info->joined_dodag->seq_num == best_dio_pdu->seq_num);
+            *same = (node->rpl_info->joined_dodag->interned_dodag_id == best_dio_record->dodag_id) &&
+                    (node->rpl_info->joined_dodag->seq_num == best_dio_record->seq_num);
         }
         else {
             *same = FALSE;
         }
 
-        return best_dio_pdu;
+        return best_dio_record;
     }
     else {
         rs_debug(DEBUG_RPL, "node '%s': no preferable DODAG iterations around", node->phy_info->name);
@@ -2159,27 +2666,23 @@ static rpl_dio_pdu_t *get_preferred_dodag_dio_pdu(node_t *node, bool *same)
         /* give priority to the former parent, to follow him if necessary */
 
         if (old_pref_parent != NULL &&
-                old_pref_parent->last_dio_message != NULL &&
-                old_pref_parent->last_dio_message->grounded == best_dio_pdu->grounded &&
-                old_pref_parent->last_dio_message->dodag_pref == best_dio_pdu->dodag_pref) {
+                old_pref_parent->has_last_dio &&
+                old_pref_parent->last_dio.grounded == best_dio_record->grounded &&
+                old_pref_parent->last_dio.dodag_pref == best_dio_record->dodag_pref) {
 
-            *same = (strcmp(node->rpl_info->joined_dodag->dodag_id, old_pref_parent->last_dio_message->dodag_id) == 0) &&
-                    (node->rpl_info->joined_dodag->seq_num == old_pref_parent->last_dio_message->seq_num);
+            *same = (node->rpl_info->joined_dodag->interned_dodag_id == old_pref_parent->last_dio.dodag_id) &&
+                    (node->rpl_info->joined_dodag->seq_num == old_pref_parent->last_dio.seq_num);
 
             if (!(*same)) {
                 rs_debug(DEBUG_RPL, "node '%s': former preferred parent '%s' should be followed on dodag_id = '%s'",
-                        node->phy_info->name, old_pref_parent->node->phy_info->name, old_pref_parent->last_dio_message->dodag_id);
+                        node->phy_info->name, old_pref_parent->node->phy_info->name, addr_to_string(old_pref_parent->last_dio.dodag_id));
             }
 
-            best_dio_pdu = old_pref_parent->last_dio_message;
-
-            rpl_dio_pdu_destroy(root_dio_pdu);
+            best_dio_record = &old_pref_parent->last_dio;
 
-            return best_dio_pdu;
+            return best_dio_record;
         }
         else {
-            rpl_dio_pdu_destroy(root_dio_pdu);
-
             rs_debug(DEBUG_RPL, "node '%s': should start own DODAG", node->phy_info->name);
 
             *same = rpl_node_is_root(node);
@@ -2206,18 +2709,180 @@ static void reset_trickle_timer(node_t *node)
     }
 
     node->rpl_info->trickle_i_doublings_so_far = 0;
+
+    trickle_start_interval(node);
+}
+
+static void trickle_start_interval(node_t *node)
+{
     node->rpl_info->trickle_c = 0;
+    node->rpl_info->trickle_interval_start = rs_system->now;
+    node->rpl_info->trickle_t = (rs_system_random() % (node->rpl_info->trickle_i / 2)) + node->rpl_info->trickle_i / 2;
+
+    trickle_schedule(node, RPL_TRICKLE_PHASE_T, node->rpl_info->trickle_t);
+}
+
+static void trickle_schedule(node_t *node, uint8 phase, sim_time_t delay)
+{
+    /* move the single pending event, its exact time is known so the cancel goes straight to its bucket */
+    if (node->rpl_info->trickle_phase == RPL_TRICKLE_PHASE_T) {
+        rs_system_cancel_event(node, rpl_event_trickle_t_timeout, NULL, NULL, node->rpl_info->trickle_next_time);
+    }
+    else if (node->rpl_info->trickle_phase == RPL_TRICKLE_PHASE_I) {
+        rs_system_cancel_event(node, rpl_event_trickle_i_timeout, NULL, NULL, node->rpl_info->trickle_next_time);
+    }
+
+    node->rpl_info->trickle_phase = phase;
+
+    if (phase == RPL_TRICKLE_PHASE_T) {
+        rs_system_schedule_event(node, rpl_event_trickle_t_timeout, NULL, NULL, delay);
+    }
+    else if (phase == RPL_TRICKLE_PHASE_I) {
+        rs_system_schedule_event(node, rpl_event_trickle_i_timeout, NULL, NULL, delay);
+    }
+
+    node->rpl_info->trickle_next_time = rs_system->now + delay;
+}
+
+static void next_hop_list_invalidate(node_t *node)
+{
+    /* sends in progress keep their own reference to the old snapshot */
+    if (node->rpl_info->next_hop_list != NULL) {
+        rpl_next_hop_list_release(node->rpl_info->next_hop_list);
+        node->rpl_info->next_hop_list = NULL;
+    }
+
+    node->rpl_info->next_hop_version++;
+}
+
+static void tree_update(node_t *node)
+{
+    rs_assert(node != NULL);
 
-    uint32 t = (rs_system_random() % (node->rpl_info->trickle_i / 2)) + node->rpl_info->trickle_i / 2;
+    rpl_node_info_t *info = node->rpl_info;
+    node_t *parent = NULL;
+
+    if (rpl_node_is_joined(node) && info->joined_dodag->pref_parent != NULL) {
+        parent = info->joined_dodag->pref_parent->node;
+    }
+
+    if (parent == info->tree_parent) {
+        if (parent != NULL) { /* the label of a child follows its parent, nothing changed */
+            return;
+        }
+
+        node_t *root = rpl_node_is_root(node) ? node : NULL;
+        bool grounded = (root != NULL && info->root_info->grounded);
+        if (root == info->tree_root && grounded == info->tree_grounded) {
+            return;
+        }
+    }
+
+    if (info->tree_parent != NULL) {
+        tree_unlink(node);
+    }
+    if (parent != NULL) {
+        tree_link(node, parent);
+    }
+
+    tree_relabel(node);
+}
+
+static void tree_link(node_t *node, node_t *parent)
+{
+    rpl_node_info_t *parent_info = parent->rpl_info;
+
+    parent_info->tree_child_list = realloc(parent_info->tree_child_list, (parent_info->tree_child_count + 1) * sizeof(node_t *));
+    parent_info->tree_child_list[parent_info->tree_child_count] = node;
+
+    node->rpl_info->tree_child_pos = parent_info->tree_child_count;
+    node->rpl_info->tree_parent = parent;
+
+    parent_info->tree_child_count++;
+}
+
+static void tree_unlink(node_t *node)
+{
+    rpl_node_info_t *parent_info = node->rpl_info->tree_parent->rpl_info;
+    uint16 pos = node->rpl_info->tree_child_pos;
 
-    rs_system_cancel_event(node, rpl_event_trickle_t_timeout, NULL, NULL, node->rpl_info->last_trickle_t_schedule_time);
-    rs_system_cancel_event(node, rpl_event_trickle_i_timeout, NULL, NULL, node->rpl_info->last_trickle_i_schedule_time);
+    rs_assert(parent_info->tree_child_list[pos] == node);
 
-    rs_system_schedule_event(node, rpl_event_trickle_t_timeout, NULL, NULL, t);
-    rs_system_schedule_event(node, rpl_event_trickle_i_timeout, NULL, NULL, node->rpl_info->trickle_i);
+    /* the last child takes the place of the removed one */
+    parent_info->tree_child_count--;
+    node_t *last_child = parent_info->tree_child_list[parent_info->tree_child_count];
+    parent_info->tree_child_list[pos] = last_child;
+    last_child->rpl_info->tree_child_pos = pos;
 
-    node->rpl_info->last_trickle_t_schedule_time = rs_system->now + t;;
-    node->rpl_info->last_trickle_i_schedule_time = rs_system->now + node->rpl_info->trickle_i;
+    node->rpl_info->tree_parent = NULL;
+}
+
+static void tree_relabel(node_t *node)
+{
+    /* collect everything hanging from this node, parents always come before their children */
+    uint32 stamp = ++tree_stamp;
+    uint16 count = 0;
+    uint16 i, j;
+
+    if (tree_queue_size == 0) {
+        tree_queue_size = 16;
+        tree_queue = malloc(tree_queue_size * sizeof(node_t *));
+    }
+
+    tree_queue[count++] = node;
+    node->rpl_info->tree_stamp = stamp;
+
+    for (i = 0; i < count; i++) {
+        rpl_node_info_t *info = tree_queue[i]->rpl_info;
+
+        for (j = 0; j < info->tree_child_count; j++) {
+            node_t *child = info->tree_child_list[j];
+            if (child->rpl_info->tree_stamp == stamp) {
+                continue;
+            }
+
+            if (count == tree_queue_size) {
+                tree_queue_size *= 2;
+                tree_queue = realloc(tree_queue, tree_queue_size * sizeof(node_t *));
+            }
+
+            tree_queue[count++] = child;
+            child->rpl_info->tree_stamp = stamp;
+        }
+    }
+
+    node_t *parent = node->rpl_info->tree_parent;
+    if (parent != NULL && parent->rpl_info->tree_stamp == stamp) { /* the parent hangs from us, we closed a loop */
+        for (i = 0; i < count; i++) {
+            tree_queue[i]->rpl_info->tree_root = NULL;
+            tree_queue[i]->rpl_info->tree_grounded = FALSE;
+            tree_queue[i]->rpl_info->tree_depth = 0;
+        }
+
+        rs_system_schedule_event(node, rpl_event_loop_detected, parent, NULL, 0);
+
+        return;
+    }
+
+    if (parent == NULL) {
+        node->rpl_info->tree_root = rpl_node_is_root(node) ? node : NULL;
+        node->rpl_info->tree_grounded = (node->rpl_info->tree_root != NULL && node->rpl_info->root_info->grounded);
+        node->rpl_info->tree_depth = 0;
+    }
+    else {
+        node->rpl_info->tree_root = parent->rpl_info->tree_root;
+        node->rpl_info->tree_grounded = parent->rpl_info->tree_grounded;
+        node->rpl_info->tree_depth = parent->rpl_info->tree_depth + 1;
+    }
+
+    for (i = 1; i < count; i++) {
+        rpl_node_info_t *info = tree_queue[i]->rpl_info;
+        rpl_node_info_t *parent_info = info->tree_parent->rpl_info;
+
+        info->tree_root = parent_info->tree_root;
+        info->tree_grounded = parent_info->tree_grounded;
+        info->tree_depth = parent_info->tree_depth + 1;
+    }
 }
 
 static void forget_neighbor_messages(node_t *node)
@@ -2228,9 +2893,8 @@ static void forget_neighbor_messages(node_t *node)
     for (i = 0; i < node->rpl_info->neighbor_count; i++) {
         rpl_neighbor_t *neighbor = node->rpl_info->neighbor_list[i];
 
-        if (neighbor->last_dio_message != NULL) {
-            rpl_dio_pdu_destroy(neighbor->last_dio_message);
-            neighbor->last_dio_message = NULL;
+        if (neighbor->has_last_dio) {
+            neighbor->has_last_dio = FALSE;
         }
     }
 }
@@ -2264,14 +2928,17 @@ static rpl_dio_pdu_t *create_root_dio_message(node_t *node, bool include_dodag_c
 
     if (root_info->dodag_id != NULL) {
         dio_pdu->dodag_id = strdup(root_info->dodag_id);
+        dio_pdu->interned_dodag_id = root_info->interned_dodag_id;
     }
     else {
         dio_pdu->dodag_id = strdup(node->ip_info->address);
+        dio_pdu->interned_dodag_id = node->ip_info->address_id;
     }
     dio_pdu->dodag_pref = root_info->dodag_pref;
 
     if (include_seq_num) {
-        dio_pdu->seq_num = seq_num_mapping_get(dio_pdu->dodag_id)->seq_num;
+        seq_num_mapping_sync(node); /* the dodag id may have been changed from outside */
+        dio_pdu->seq_num = rpl_seq_num_get(dio_pdu->interned_dodag_id);
     }
     else {
         dio_pdu->seq_num = -1;
@@ -2284,6 +2951,7 @@ static rpl_dio_pdu_t *create_root_dio_message(node_t *node, bool include_dodag_c
     dio_pdu->grounded = root_info->grounded;
     dio_pdu->dao_supported = root_info->dao_supported;
     dio_pdu->dao_trigger = root_info->dao_trigger;
+    dio_pdu->storing = node->rpl_info->storing;
 
     if (include_dodag_config) {
         dio_pdu->dodag_config_suboption = rpl_dio_suboption_dodag_config_create();
@@ -2293,6 +2961,7 @@ static rpl_dio_pdu_t *create_root_dio_message(node_t *node, bool include_dodag_c
         dio_pdu->dodag_config_suboption->dio_redundancy_constant = root_info->dio_redundancy_constant;
         dio_pdu->dodag_config_suboption->max_rank_inc = root_info->max_rank_inc;
         dio_pdu->dodag_config_suboption->min_hop_rank_inc = root_info->min_hop_rank_inc;
+        dio_pdu->dodag_config_suboption->ocp = root_info->ocp;
     }
 
     return dio_pdu;
@@ -2309,6 +2978,7 @@ static rpl_dio_pdu_t *create_joined_dio_message(node_t *node, bool include_dodag
     dio_pdu = rpl_dio_pdu_create();
 
     dio_pdu->dodag_id = strdup(dodag->dodag_id);
+    dio_pdu->interned_dodag_id = dodag->interned_dodag_id;
     dio_pdu->dodag_pref = dodag->dodag_pref;
     dio_pdu->seq_num = dodag->seq_num;
 
@@ -2319,6 +2989,7 @@ static rpl_dio_pdu_t *create_joined_dio_message(node_t *node, bool include_dodag
     dio_pdu->grounded = dodag->grounded;
     dio_pdu->dao_supported = dodag->dao_supported;
     dio_pdu->dao_trigger = dodag->dao_trigger;
+    dio_pdu->storing = dodag->storing;
 
     if (include_dodag_config) {
         dio_pdu->dodag_config_suboption = rpl_dio_suboption_dodag_config_create();
@@ -2328,6 +2999,7 @@ static rpl_dio_pdu_t *create_joined_dio_message(node_t *node, bool include_dodag
         dio_pdu->dodag_config_suboption->dio_redundancy_constant = dodag->dio_redundancy_constant;
         dio_pdu->dodag_config_suboption->max_rank_inc = dodag->max_rank_inc;
         dio_pdu->dodag_config_suboption->min_hop_rank_inc = dodag->min_hop_rank_inc;
+        dio_pdu->dodag_config_suboption->ocp = dodag->ocp;
     }
 
     return dio_pdu;
@@ -2338,36 +3010,35 @@ static void update_neighbor_dio_message(rpl_neighbor_t *neighbor, rpl_dio_pdu_t
     rs_assert(neighbor != NULL);
     rs_assert(dio_pdu != NULL);
 
-    if (neighbor->last_dio_message == NULL) {
-        neighbor->last_dio_message = rpl_dio_pdu_duplicate(dio_pdu);
+    rpl_dio_record_t *record = &neighbor->last_dio;
+
+    if (!neighbor->has_last_dio) {
+        record->has_dodag_config = 0;
+        neighbor->has_last_dio = TRUE;
     }
-    else {
-        if (neighbor->last_dio_message->dodag_id != NULL)
-            free(neighbor->last_dio_message->dodag_id);
 
-        neighbor->last_dio_message->dodag_id = strdup(dio_pdu->dodag_id);
-        neighbor->last_dio_message->dodag_pref = dio_pdu->dodag_pref;
-        neighbor->last_dio_message->seq_num = dio_pdu->seq_num;
+    record->dodag_id = dio_pdu->interned_dodag_id;
+    record->dodag_pref = dio_pdu->dodag_pref;
+    record->seq_num = dio_pdu->seq_num;
 
-        neighbor->last_dio_message->rank = dio_pdu->rank;
-        neighbor->last_dio_message->dstn = dio_pdu->dstn;
-        neighbor->last_dio_message->dao_stored = dio_pdu->dao_stored;
+    record->rank = dio_pdu->rank;
+    record->dstn = dio_pdu->dstn;
+    record->dao_stored = dio_pdu->dao_stored ? 1 : 0;
 
-        neighbor->last_dio_message->grounded = dio_pdu->grounded;
-        neighbor->last_dio_message->dao_supported = dio_pdu->dao_supported;
-        neighbor->last_dio_message->dao_trigger = dio_pdu->dao_trigger;
+    record->grounded = dio_pdu->grounded ? 1 : 0;
+    record->dao_supported = dio_pdu->dao_supported ? 1 : 0;
+    record->dao_trigger = dio_pdu->dao_trigger ? 1 : 0;
+    record->storing = dio_pdu->storing ? 1 : 0;
 
-        if (dio_pdu->dodag_config_suboption != NULL) {
-            if (neighbor->last_dio_message->dodag_config_suboption == NULL) {
-                neighbor->last_dio_message->dodag_config_suboption = rpl_dio_suboption_dodag_config_create();
-            }
+    if (dio_pdu->dodag_config_suboption != NULL) {
+        record->has_dodag_config = 1;
 
-            neighbor->last_dio_message->dodag_config_suboption->dio_interval_min = dio_pdu->dodag_config_suboption->dio_interval_min;
-            neighbor->last_dio_message->dodag_config_suboption->dio_interval_doublings = dio_pdu->dodag_config_suboption->dio_interval_doublings;
-            neighbor->last_dio_message->dodag_config_suboption->dio_redundancy_constant = dio_pdu->dodag_config_suboption->dio_redundancy_constant;
-            neighbor->last_dio_message->dodag_config_suboption->min_hop_rank_inc = dio_pdu->dodag_config_suboption->min_hop_rank_inc;
-            neighbor->last_dio_message->dodag_config_suboption->max_rank_inc = dio_pdu->dodag_config_suboption->max_rank_inc;
-        }
+        record->dio_interval_min = dio_pdu->dodag_config_suboption->dio_interval_min;
+        record->dio_interval_doublings = dio_pdu->dodag_config_suboption->dio_interval_doublings;
+        record->dio_redundancy_constant = dio_pdu->dodag_config_suboption->dio_redundancy_constant;
+        record->min_hop_rank_inc = dio_pdu->dodag_config_suboption->min_hop_rank_inc;
+        record->max_rank_inc = dio_pdu->dodag_config_suboption->max_rank_inc;
+        record->ocp = dio_pdu->dodag_config_suboption->ocp;
     }
 }
 
@@ -2377,20 +3048,134 @@ static uint16 compute_candidate_rank(node_t *node, rpl_neighbor_t *neighbor)
         return RPL_RANK_INFINITY;
     }
 
+    uint16 rank = neighbor->last_dio.rank + of_list[node->rpl_info->joined_dodag->ocp].rank_increase(node, neighbor);
+
+    if (rank > RPL_RANK_INFINITY) {
+        return RPL_RANK_INFINITY;
+    }
+    else {
+        return rank;
+    }
+}
+
+static uint16 of0_rank_increase(node_t *node, rpl_neighbor_t *neighbor)
+{
+    /* the step of rank grows with the square of the loss of the link, in both directions */
     percent_t send_link_quality = rs_system_get_link_quality(node, neighbor->node);
     percent_t receive_link_quality = rs_system_get_link_quality(neighbor->node, node);
-    percent_t link_quality = (send_link_quality + receive_link_quality) / 2;
+    percent_t link_loss = 1 - (send_link_quality + receive_link_quality) / 2;
 
-    uint16 rank = (RPL_MAXIMUM_RANK_INCREMENT - RPL_MINIMUM_RANK_INCREMENT) * pow((1 - link_quality), 2) + RPL_MINIMUM_RANK_INCREMENT;
+    return (RPL_MAXIMUM_RANK_INCREMENT - RPL_MINIMUM_RANK_INCREMENT) * link_loss * link_loss + RPL_MINIMUM_RANK_INCREMENT;
+}
 
-    rank += neighbor->last_dio_message->rank;
+static uint16 mrhof_rank_increase(node_t *node, rpl_neighbor_t *neighbor)
+{
+    /* the ETX of the link, rounded to whole rank increments */
+    uint16 rank_increase = (neighbor->etx * RPL_MINIMUM_RANK_INCREMENT + RPL_ETX_DIVISOR / 2) / RPL_ETX_DIVISOR;
 
-    if (rank > RPL_RANK_INFINITY) {
-        return RPL_RANK_INFINITY;
+    if (rank_increase < RPL_MINIMUM_RANK_INCREMENT) {
+        return RPL_MINIMUM_RANK_INCREMENT;
+    }
+    else if (rank_increase > RPL_MAXIMUM_RANK_INCREMENT) {
+        return RPL_MAXIMUM_RANK_INCREMENT;
     }
     else {
-        return rank;
+        return rank_increase;
+    }
+}
+
+static bool candidate_heap_contains(rpl_dodag_t *dodag, rpl_neighbor_t *neighbor)
+{
+    /* a stale position, left over from a previous dodag, never points back to the neighbor */
+    return neighbor->candidate_pos < dodag->candidate_count && dodag->candidate_heap[neighbor->candidate_pos] == neighbor;
+}
+
+static void candidate_heap_update(rpl_dodag_t *dodag, rpl_neighbor_t *neighbor, uint16 candidate_rank)
+{
+    if (!candidate_heap_contains(dodag, neighbor)) {
+        dodag->candidate_heap = realloc(dodag->candidate_heap, (dodag->candidate_count + 1) * sizeof(rpl_neighbor_t *));
+        dodag->candidate_heap[dodag->candidate_count] = neighbor;
+        neighbor->candidate_pos = dodag->candidate_count++;
+        neighbor->candidate_rank = candidate_rank;
+
+        candidate_heap_sift_up(dodag, neighbor->candidate_pos);
+    }
+    else if (candidate_rank < neighbor->candidate_rank) {
+        neighbor->candidate_rank = candidate_rank;
+        candidate_heap_sift_up(dodag, neighbor->candidate_pos);
+    }
+    else if (candidate_rank > neighbor->candidate_rank) {
+        neighbor->candidate_rank = candidate_rank;
+        candidate_heap_sift_down(dodag, neighbor->candidate_pos);
+    }
+}
+
+static void candidate_heap_remove(rpl_dodag_t *dodag, rpl_neighbor_t *neighbor)
+{
+    if (!candidate_heap_contains(dodag, neighbor)) {
+        return;
+    }
+
+    uint16 pos = neighbor->candidate_pos;
+    rpl_neighbor_t *last = dodag->candidate_heap[--dodag->candidate_count];
+
+    if (last != neighbor) {
+        dodag->candidate_heap[pos] = last;
+        last->candidate_pos = pos;
+
+        candidate_heap_sift_up(dodag, pos);
+        candidate_heap_sift_down(dodag, last->candidate_pos);
+    }
+}
+
+static void candidate_heap_sift_up(rpl_dodag_t *dodag, uint16 pos)
+{
+    rpl_neighbor_t *neighbor = dodag->candidate_heap[pos];
+
+    while (pos > 0) {
+        uint16 parent_pos = (pos - 1) / 2;
+        rpl_neighbor_t *parent = dodag->candidate_heap[parent_pos];
+
+        if (parent->candidate_rank <= neighbor->candidate_rank) {
+            break;
+        }
+
+        dodag->candidate_heap[pos] = parent;
+        parent->candidate_pos = pos;
+        pos = parent_pos;
+    }
+
+    dodag->candidate_heap[pos] = neighbor;
+    neighbor->candidate_pos = pos;
+}
+
+static void candidate_heap_sift_down(rpl_dodag_t *dodag, uint16 pos)
+{
+    rpl_neighbor_t *neighbor = dodag->candidate_heap[pos];
+
+    for (;;) {
+        uint16 child_pos = 2 * pos + 1;
+        if (child_pos >= dodag->candidate_count) {
+            break;
+        }
+
+        if (child_pos + 1 < dodag->candidate_count &&
+                dodag->candidate_heap[child_pos + 1]->candidate_rank < dodag->candidate_heap[child_pos]->candidate_rank) {
+            child_pos++;
+        }
+
+        rpl_neighbor_t *child = dodag->candidate_heap[child_pos];
+        if (neighbor->candidate_rank <= child->candidate_rank) {
+            break;
+        }
+
+        dodag->candidate_heap[pos] = child;
+        child->candidate_pos = pos;
+        pos = child_pos;
     }
+
+    dodag->candidate_heap[pos] = neighbor;
+    neighbor->candidate_pos = pos;
 }
 
 static sim_time_t compute_dao_delay(node_t *node)
@@ -2412,15 +3197,266 @@ static sim_time_t compute_dao_delay(node_t *node)
     }
 }
 
+static int dao_target_compare(const void *a, const void *b)
+{
+    const rpl_dao_target_t *target1 = a;
+    const rpl_dao_target_t *target2 = b;
+
+    if (target1->dest != target2->dest) { /* any order will do, the targets are only matched */
+        return target1->dest < target2->dest ? -1 : 1;
+    }
+
+    return (int) target1->prefix_len - (int) target2->prefix_len;
+}
+
+static bool node_is_storing(node_t *node)
+{
+    if (node->rpl_info->joined_dodag != NULL) { /* the mode of operation is set by the root */
+        return node->rpl_info->joined_dodag->storing;
+    }
+
+    return node->rpl_info->storing;
+}
+
+static bool dao_pdu_receive_non_storing(node_t *node, node_t *incoming_node, rpl_dao_pdu_t *pdu)
+{
+    if (rpl_node_is_joined(node)) { /* pass it on towards the root, without storing anything */
+        if (pdu->rr_count >= RPL_SOURCE_ROUTE_MAX_HOPS) {
+            rs_debug(DEBUG_RPL, "node '%s': dropping DAO from '%s', relayed too many times",
+                    node->phy_info->name, incoming_node->phy_info->name);
+
+            return TRUE;
+        }
+
+        rpl_dao_pdu_t *relayed_pdu = rpl_dao_pdu_duplicate(pdu);
+        rpl_dao_pdu_add_rr(relayed_pdu, node->ip_info->address);
+
+        return rpl_node_send_dao(node, node->rpl_info->joined_dodag->pref_parent->node->ip_info->address_id, relayed_pdu);
+    }
+
+    if (!rpl_node_is_root(node)) {
+        rs_debug(DEBUG_RPL, "node '%s': dropping DAO from '%s', not part of a dodag",
+                node->phy_info->name, incoming_node->phy_info->name);
+
+        return TRUE;
+    }
+
+    uint16 i;
+    for (i = 0; i < pdu->target_count; i++) {
+        rpl_dao_target_t *target = &pdu->target_list[i];
+
+        if (target->parent == ADDR_UNKNOWN) { /* sent before the sender learned the mode of operation */
+            continue;
+        }
+
+        source_route_table_update(node, target->dest, target->parent);
+    }
+
+    return TRUE;
+}
+
+static void source_route_table_update(node_t *node, address_t target, address_t parent)
+{
+    rpl_source_route_table_t *table = node->rpl_info->source_route_table;
+
+    if (table == NULL) {
+        table = malloc(sizeof(rpl_source_route_table_t));
+
+        table->parent_list = NULL;
+        table->update_time_list = NULL;
+        table->cache_slot_list = NULL;
+        table->size = 0;
+        table->version = 0;
+
+        table->cache_count = 0;
+        table->lru_first = -1;
+        table->lru_last = -1;
+
+        node->rpl_info->source_route_table = table;
+    }
+
+    if (target >= table->size) { /* the address ids are dense, grow to cover this one */
+        uint32 i, size = table->size * 2;
+        if (size <= target) {
+            size = target + 1;
+        }
+
+        table->parent_list = realloc(table->parent_list, size * sizeof(address_t));
+        table->update_time_list = realloc(table->update_time_list, size * sizeof(sim_time_t));
+        table->cache_slot_list = realloc(table->cache_slot_list, size * sizeof(int16));
+
+        for (i = table->size; i < size; i++) {
+            table->parent_list[i] = ADDR_UNKNOWN;
+            table->update_time_list[i] = 0;
+            table->cache_slot_list[i] = -1;
+        }
+
+        table->size = size;
+    }
+
+    if (table->parent_list[target] != parent) { /* any cached path may go through the old pointer */
+        table->parent_list[target] = parent;
+        table->version++;
+    }
+
+    /* expired pointers are not removed, they are just no longer followed */
+    table->update_time_list[target] = rs_system->now;
+}
+
+static void source_route_table_clear(node_t *node)
+{
+    rpl_source_route_table_t *table = node->rpl_info->source_route_table;
+
+    if (table == NULL) {
+        return;
+    }
+
+    if (table->parent_list != NULL) {
+        free(table->parent_list);
+        free(table->update_time_list);
+        free(table->cache_slot_list);
+    }
+
+    free(table);
+    node->rpl_info->source_route_table = NULL;
+}
+
+static rpl_source_route_t *source_route_lookup(node_t *node, address_t dst)
+{
+    rpl_source_route_table_t *table = node->rpl_info->source_route_table;
+
+    if (dst >= table->size) {
+        return NULL;
+    }
+
+    int16 slot = table->cache_slot_list[dst];
+    if (slot >= 0) {
+        rpl_source_route_t *source_route = &table->cache[slot];
+
+        if (source_route->version == table->version && source_route->expire_time > rs_system->now) {
+            source_route_cache_unlink(table, slot);
+            source_route_cache_push(table, slot);
+            measure_node_add_rpl_source_route(node, TRUE, 0);
+
+            return source_route;
+        }
+    }
+
+    /* follow the parent pointers up to us, collecting the hops in reverse order */
+    address_t hop_list[RPL_SOURCE_ROUTE_MAX_HOPS];
+    uint8 hop_count = 0;
+    uint16 step_count = 0;
+    sim_time_t expire_time = rs_system->now + rs_system->rpl_dao_remove_timeout;
+    address_t address = dst;
+
+    while (TRUE) {
+        step_count++;
+
+        if (address >= table->size || table->parent_list[address] == ADDR_UNKNOWN) {
+            break;
+        }
+
+        sim_time_t entry_expire_time = table->update_time_list[address] + rs_system->rpl_dao_remove_timeout;
+        if (entry_expire_time <= rs_system->now) {
+            break;
+        }
+        if (entry_expire_time < expire_time) {
+            expire_time = entry_expire_time;
+        }
+
+        address = table->parent_list[address];
+        if (address == node->ip_info->address_id || hop_count == RPL_SOURCE_ROUTE_MAX_HOPS) {
+            break;
+        }
+
+        hop_list[hop_count++] = address;
+    }
+
+    measure_node_add_rpl_source_route(node, FALSE, step_count);
+
+    if (address != node->ip_info->address_id) {
+        rs_debug(DEBUG_RPL, "node '%s': no source route to '%s', stopped at '%s' after %d hops",
+                node->phy_info->name, addr_to_string(dst), addr_to_string(address), hop_count);
+
+        return NULL;
+    }
+
+    /* reuse the stale entry of this destination, a free slot or the least recently used one */
+    if (slot >= 0) {
+        source_route_cache_unlink(table, slot);
+    }
+    else if (table->cache_count < RPL_SOURCE_ROUTE_CACHE_SIZE) {
+        slot = table->cache_count++;
+    }
+    else {
+        slot = table->lru_last;
+        source_route_cache_unlink(table, slot);
+        table->cache_slot_list[table->cache[slot].dst] = -1;
+    }
+
+    rpl_source_route_t *source_route = &table->cache[slot];
+
+    source_route->dst = dst;
+    source_route->hop_count = hop_count;
+    source_route->version = table->version;
+    source_route->expire_time = expire_time;
+
+    uint8 i;
+    for (i = 0; i < hop_count; i++) {
+        source_route->hop_list[i] = hop_list[hop_count - 1 - i];
+    }
+
+    table->cache_slot_list[dst] = slot;
+    source_route_cache_push(table, slot);
+
+    return source_route;
+}
+
+static void source_route_cache_unlink(rpl_source_route_table_t *table, int16 slot)
+{
+    rpl_source_route_t *source_route = &table->cache[slot];
+
+    if (source_route->lru_prev >= 0) {
+        table->cache[source_route->lru_prev].lru_next = source_route->lru_next;
+    }
+    else {
+        table->lru_first = source_route->lru_next;
+    }
+
+    if (source_route->lru_next >= 0) {
+        table->cache[source_route->lru_next].lru_prev = source_route->lru_prev;
+    }
+    else {
+        table->lru_last = source_route->lru_prev;
+    }
+}
+
+static void source_route_cache_push(rpl_source_route_table_t *table, int16 slot)
+{
+    rpl_source_route_t *source_route = &table->cache[slot];
+
+    source_route->lru_prev = -1;
+    source_route->lru_next = table->lru_first;
+
+    if (table->lru_first >= 0) {
+        table->cache[table->lru_first].lru_prev = slot;
+    }
+    else {
+        table->lru_last = slot;
+    }
+
+    table->lru_first = slot;
+}
+
 static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1, char *str2, uint16 len)
 {
     str1[0] = '\0';
     str2[0] = '\0';
 
     if (event_id == rpl_event_dis_pdu_send) {
-        char *dst_ip_address = data1;
+        address_t dst_address = GPOINTER_TO_UINT(data1);
 
-        snprintf(str1, len, "dst = '%s'", dst_ip_address != NULL ? dst_ip_address : "<<broadcast>>");
+        snprintf(str1, len, "dst = '%s'", dst_address != ADDR_BROADCAST ? addr_to_string(dst_address) : "<<broadcast>>");
     }
     else if (event_id == rpl_event_dis_pdu_receive) {
         node_t *node = data1;
@@ -2428,9 +3464,9 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
         snprintf(str1, len, "incoming_node = '%s'", (node != NULL ? node->phy_info->name : "<<unknown>>"));
     }
     else if (event_id == rpl_event_dio_pdu_send) {
-        char *dst_ip_address = data1;
+        address_t dst_address = GPOINTER_TO_UINT(data1);
 
-        snprintf(str1, len, "dst = '%s'", dst_ip_address != NULL ? dst_ip_address : "<<broadcast>>");
+        snprintf(str1, len, "dst = '%s'", dst_address != ADDR_BROADCAST ? addr_to_string(dst_address) : "<<broadcast>>");
     }
     else if (event_id == rpl_event_dio_pdu_receive) {
         node_t *node = data1;
@@ -2438,9 +3474,9 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
         snprintf(str1, len, "incoming_node = '%s'", (node != NULL ? node->phy_info->name : "<<unknown>>"));
     }
     else if (event_id == rpl_event_dao_pdu_send) {
-        char *dst_ip_address = data1;
+        address_t dst_address = GPOINTER_TO_UINT(data1);
 
-        snprintf(str1, len, "dst = '%s'", dst_ip_address != NULL ? dst_ip_address : "<<broadcast>>");
+        snprintf(str1, len, "dst = '%s'", dst_address != ADDR_BROADCAST ? addr_to_string(dst_address) : "<<broadcast>>");
     }
     else if (event_id == rpl_event_dao_pdu_receive) {
         node_t *node = data1;
@@ -2457,19 +3493,24 @@ static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1,
 
         snprintf(str1, len, "neighbor = '%s'", node != NULL ? node->phy_info->name : "<<unknown>>");
     }
+    else if (event_id == rpl_event_loop_detected) {
+        node_t *node = data1;
+
+        snprintf(str1, len, "pref_parent = '%s'", node != NULL ? node->phy_info->name : "<<unknown>>");
+    }
     else if (event_id == rpl_event_forward_failure) {
         node_t *node = data1;
         ip_pdu_t *ip_pdu = data2;
 
         snprintf(str1, len, "incoming_node = '%s'", node != NULL ? node->phy_info->name : "<<unknown>>");
-        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", ip_pdu->src_address, ip_pdu->dst_address);
+        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", addr_to_string(ip_pdu->src_address), addr_to_string(ip_pdu->dst_address));
     }
     else if (event_id == rpl_event_forward_inconsistency) {
         node_t *node = data1;
         ip_pdu_t *ip_pdu = data2;
 
         snprintf(str1, len, "incoming_node = '%s'", node != NULL ? node->phy_info->name : "<<unknown>>");
-        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", ip_pdu->src_address, ip_pdu->dst_address);
+        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", addr_to_string(ip_pdu->src_address), addr_to_string(ip_pdu->dst_address));
     }
     else if (event_id == rpl_event_dao_timeout_check) {
         ip_route_t *route = data1;
@@ -37,12 +37,35 @@
 
 #define RPL_DEFAULT_NODE_STORING                TRUE
 
+#define RPL_FLOW_LABEL_ACCEPT                   0
+#define RPL_FLOW_LABEL_DROP                     1
+#define RPL_FLOW_LABEL_REROUTE                  2   /* handed back after a forwarding error, send it again */
+
 #define RPL_RANK_ROOT                           1
 #define RPL_RANK_INFINITY                       0xFF
 
 #define RPL_MINIMUM_RANK_INCREMENT              1
 #define RPL_MAXIMUM_RANK_INCREMENT              16
 
+#define RPL_OF_OF0                              0   /* the objective code points */
+#define RPL_OF_MRHOF                            1
+
+#define RPL_OF_COUNT                            2
+
+#define RPL_ETX_DIVISOR                         128 /* the fixed point unit of an ETX */
+#define RPL_ETX_INIT                            (2 * RPL_ETX_DIVISOR)   /* assumed for a link without samples */
+#define RPL_ETX_NOACK_PENALTY                   (16 * RPL_ETX_DIVISOR)  /* the sample of a frame never acknowledged */
+#define RPL_ETX_ALPHA                           90  /* the percentage kept from the previous estimate */
+
+#define RPL_TRICKLE_PHASE_IDLE                  0   /* no trickle event pending */
+#define RPL_TRICKLE_PHASE_T                     1   /* waiting for t, the transmission point */
+#define RPL_TRICKLE_PHASE_I                     2   /* waiting for the end of the interval */
+
+#define RPL_SOURCE_ROUTE_MAX_HOPS               32  /* longer paths are treated as loops */
+#define RPL_SOURCE_ROUTE_CACHE_SIZE             32  /* computed paths kept by a non-storing root */
+
+#define RPL_SEQ_NUM_MAPPING_INITIAL_SIZE        8
+
 
 #define rpl_node_has_parent(node, parent)       (rpl_node_find_parent_by_node(node, parent) != NULL)
 #define rpl_node_has_sibling(node, sibling)     (rpl_node_find_sibling_by_node(node, sibling) != NULL)
@@ -54,7 +77,33 @@
 #define rpl_node_is_root(node)                  ((node)->rpl_info->joined_dodag == NULL && (node)->rpl_info->root_info->dodag_id != NULL)
 #define rpl_node_is_joined(node)                ((node)->rpl_info->joined_dodag != NULL && (node)->rpl_info->joined_dodag->rank < RPL_RANK_INFINITY)
 #define rpl_node_is_poisoning(node)             ((node)->rpl_info->joined_dodag != NULL && (node)->rpl_info->joined_dodag->rank == RPL_RANK_INFINITY)
+#define rpl_node_is_connected(node)             ((node)->rpl_info->tree_grounded)
+
+
+    /* the last DIO heard from a neighbor, kept inline in a fixed layout */
+typedef struct rpl_dio_record_t {
+
+    address_t               dodag_id;               /* interned */
+    uint16                  rank;
+    uint8                   dodag_pref;
+    uint8                   seq_num;
+    uint8                   dstn;
+
+    uint8                   dao_stored : 1;
+    uint8                   grounded : 1;
+    uint8                   dao_supported : 1;
+    uint8                   dao_trigger : 1;
+    uint8                   storing : 1;
+    uint8                   has_dodag_config : 1;   /* the fields below are valid */
+
+    uint8                   dio_interval_doublings;
+    uint8                   dio_interval_min;
+    uint8                   dio_redundancy_constant;
+    uint8                   max_rank_inc;
+    uint8                   min_hop_rank_inc;
+    uint8                   ocp;
 
+} rpl_dio_record_t;
 
 /* data structure that holds remote RPL node information, for avoiding a node_t * reference */
 typedef struct rpl_neighbor_t {
@@ -62,13 +111,20 @@ typedef struct rpl_neighbor_t {
     node_t *                node;
     bool                    is_dao_parent;
 
-    struct rpl_dio_pdu_t *  last_dio_message;
+    bool                    has_last_dio;
+    rpl_dio_record_t        last_dio;
+
+    uint16                  etx;                /* EWMA of the transmissions per acknowledged frame, in RPL_ETX_DIVISOR units */
+
+    uint16                  candidate_rank;     /* the rank we would get through this neighbor, cached */
+    uint16                  candidate_pos;      /* position in the candidate heap of the joined dodag */
 
 } rpl_neighbor_t;
 
 typedef struct rpl_root_info_t {
 
     char *                  dodag_id;
+    address_t               interned_dodag_id;
     char *                  configured_dodag_id;
     uint8                   dodag_pref;
     bool                    grounded;
@@ -81,16 +137,19 @@ typedef struct rpl_root_info_t {
 
     uint8                   max_rank_inc;
     uint8                   min_hop_rank_inc;
+    uint8                   ocp;
 
 } rpl_root_info_t;
 
 typedef struct rpl_dodag_t {
 
     char *                  dodag_id;
+    address_t               interned_dodag_id;
     uint8                   dodag_pref;
     bool                    grounded;
     bool                    dao_supported;
     bool                    dao_trigger;
+    bool                    storing;                /* the mode of operation, as advertised by the root */
 
     uint8                   dio_interval_doublings;
     uint8                   dio_interval_min;
@@ -98,6 +157,7 @@ typedef struct rpl_dodag_t {
 
     uint8                   max_rank_inc;
     uint8                   min_hop_rank_inc;
+    uint8                   ocp;                    /* the objective function of the dodag */
 
     uint8                   seq_num;
     uint16                  lowest_rank;
@@ -105,12 +165,60 @@ typedef struct rpl_dodag_t {
 
     rpl_neighbor_t**        parent_list;
     uint16                  parent_count;
+    node_map_t              parent_map;
     rpl_neighbor_t**        sibling_list;
     uint16                  sibling_count;
+    node_map_t              sibling_map;
     rpl_neighbor_t*         pref_parent;
 
+        /* min-heap of the parents and siblings, keyed by candidate rank */
+    rpl_neighbor_t**        candidate_heap;
+    uint16                  candidate_count;
+
 } rpl_dodag_t;
 
+    /* an immutable snapshot of the forwarding candidates (preferred parent, parents, siblings);
+     * a send in progress holds a reference, so a rebuild never disturbs it */
+typedef struct rpl_next_hop_list_t {
+
+    node_t **               node_list;
+    uint16                  node_count;
+    uint32                  version;
+    uint16                  ref_count;
+
+} rpl_next_hop_list_t;
+
+    /* a path computed by a non-storing root, listing the hops between the root and the destination */
+typedef struct rpl_source_route_t {
+
+    address_t               dst;
+    address_t               hop_list[RPL_SOURCE_ROUTE_MAX_HOPS];    /* from the root side towards the destination */
+    uint8                   hop_count;
+    uint32                  version;            /* valid only while equal to the table version */
+    sim_time_t              expire_time;        /* the earliest expiry among the parent pointers followed */
+
+    int16                   lru_prev;
+    int16                   lru_next;
+
+} rpl_source_route_t;
+
+    /* the parent pointers that a non-storing root learns from the DAO transit info */
+typedef struct rpl_source_route_table_t {
+
+    address_t *             parent_list;        /* indexed by the address id of the target */
+    sim_time_t *            update_time_list;
+    int16 *                 cache_slot_list;    /* indexed by the address id of the destination, -1 when not cached */
+    uint32                  size;
+    uint32                  version;            /* bumped whenever a parent pointer changes */
+
+        /* LRU list of the computed paths, the most recently used first */
+    rpl_source_route_t      cache[RPL_SOURCE_ROUTE_CACHE_SIZE];
+    uint16                  cache_count;
+    int16                   lru_first;
+    int16                   lru_last;
+
+} rpl_source_route_table_t;
+
     /* info that a node supporting RPL should store */
 typedef struct rpl_node_info_t {
 
@@ -121,17 +229,38 @@ typedef struct rpl_node_info_t {
 
     uint8                   trickle_i_doublings_so_far;
     sim_time_t              trickle_i;
+    sim_time_t              trickle_t;              /* offset of the transmission point in the current interval */
     uint8                   trickle_c;
-    sim_time_t              last_trickle_i_schedule_time; /* scheduler performance boost */
-    sim_time_t              last_trickle_t_schedule_time;
+    uint8                   trickle_phase;          /* exactly one trickle event is pending, for the next phase boundary */
+    sim_time_t              trickle_interval_start;
+    sim_time_t              trickle_next_time;      /* when the pending event fires, for a direct cancel */
 
     rpl_neighbor_t**        neighbor_list;
     uint16                  neighbor_count;
+    node_map_t              neighbor_map;
 
     uint8                   poison_count_so_far;
 
     sim_time_t              last_dio_send_time; /* used for detecting collisions by simulating a risk window */
 
+    rpl_next_hop_list_t *   next_hop_list;  /* built on demand, dropped whenever the parents or siblings change */
+    uint32                  next_hop_version;
+
+        /* place in the tree formed by the preferred parents, relabeled whenever a parent changes */
+    node_t *                tree_parent;
+    node_t **               tree_child_list;
+    uint16                  tree_child_count;
+    uint16                  tree_child_pos;     /* index in the child list of the tree parent */
+    node_t *                tree_root;          /* the root reached through the preferred parents, NULL if none */
+    bool                    tree_grounded;
+    uint16                  tree_depth;
+    uint32                  tree_stamp;
+
+    rpl_source_route_table_t *
+                            source_route_table; /* only while root of a non-storing dodag */
+
+    address_t               seq_num_dodag_id;   /* the sequence number mapping we hold a reference on, while root */
+
 } rpl_node_info_t;
 
 
@@ -144,6 +273,7 @@ typedef struct rpl_dio_suboption_dodag_config_t {
 
     uint8                   max_rank_inc;
     uint8                   min_hop_rank_inc;
+    uint8                   ocp;
 
 } rpl_dio_suboption_dodag_config_t;
 
@@ -151,6 +281,7 @@ typedef struct rpl_dio_suboption_dodag_config_t {
 typedef struct rpl_dio_pdu_t {
 
     char *                  dodag_id;
+    address_t               interned_dodag_id;
     uint8                   dodag_pref;
     uint8                   seq_num;
 
@@ -161,20 +292,30 @@ typedef struct rpl_dio_pdu_t {
     bool                    grounded;
     bool                    dao_supported;
     bool                    dao_trigger;
+    bool                    storing;
 
     rpl_dio_suboption_dodag_config_t *
                             dodag_config_suboption;
 
 } rpl_dio_pdu_t;
 
+    /* a destination advertised by a DAO message */
+typedef struct rpl_dao_target_t {
+
+    address_t               dest;
+    uint8                   prefix_len;
+    address_t               parent;     /* the transit info, only in non-storing mode, ADDR_UNKNOWN otherwise */
+
+} rpl_dao_target_t;
+
     /* fields contained in a RPL DAO message */
 typedef struct rpl_dao_pdu_t {
 
     uint16                  seq_num;
     uint16                  rank;
 
-    char *                  dest;
-    uint8                   prefix_len;
+    rpl_dao_target_t *      target_list;
+    uint16                  target_count;
     uint32                  life_time;
     char **                 rr_stack;
     uint16                  rr_count;
@@ -195,6 +336,7 @@ extern uint16               rpl_event_dao_pdu_receive;
 extern uint16               rpl_event_neighbor_attach;
 extern uint16               rpl_event_neighbor_detach;
 extern uint16               rpl_event_new_pref_parent;
+extern uint16               rpl_event_loop_detected;
 
 extern uint16               rpl_event_forward_failure;
 extern uint16               rpl_event_forward_inconsistency;
@@ -210,13 +352,16 @@ extern uint16               rpl_event_seq_num_autoinc;
 bool                        rpl_init();
 bool                        rpl_done();
 
+char *                      rpl_of_get_name(uint8 ocp);
+int8                        rpl_of_find_by_name(char *name);
+
 rpl_neighbor_t *            rpl_neighbor_create(node_t *node);
 void                        rpl_neighbor_destroy(rpl_neighbor_t* neighbor);
 
 rpl_root_info_t *           rpl_root_info_create();
 void                        rpl_root_info_destroy(rpl_root_info_t *root_info);
 
-rpl_dodag_t *               rpl_dodag_create(rpl_dio_pdu_t *dio_pdu);
+rpl_dodag_t *               rpl_dodag_create(rpl_dio_record_t *dio_record);
 void                        rpl_dodag_destroy(rpl_dodag_t *dodag);
 
 rpl_dio_pdu_t *             rpl_dio_pdu_create();
@@ -231,8 +376,9 @@ rpl_dao_pdu_t *             rpl_dao_pdu_create();
 void                        rpl_dao_pdu_destroy(rpl_dao_pdu_t *pdu);
 rpl_dao_pdu_t *             rpl_dao_pdu_duplicate(rpl_dao_pdu_t *pdu);
 void                        rpl_dao_pdu_add_rr(rpl_dao_pdu_t *pdu, char *ip_address);
+void                        rpl_dao_pdu_add_target(rpl_dao_pdu_t *pdu, address_t dest, uint8 prefix_len, address_t parent);
 
-uint8                       rpl_seq_num_get(char *dodag_id);
+uint8                       rpl_seq_num_get(address_t dodag_id);
 void                        rpl_seq_num_reset();
 
 void                        rpl_node_init(node_t *node);
@@ -258,16 +404,23 @@ bool                        rpl_node_neighbor_is_sibling(node_t *node, rpl_neigh
 void                        rpl_node_start_as_root(node_t *node);
 void                        rpl_node_isolate(node_t *node);
 void                        rpl_node_reset_trickle_timer(node_t *node);
-
-node_t **                   rpl_node_get_next_hop_list(node_t *node, uint16 *node_count);
-bool                        rpl_node_process_incoming_flow_label(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu);
+void                        rpl_node_update_tree(node_t *node);
+uint32                      rpl_node_get_route_state_size(node_t *node);
+
+rpl_next_hop_list_t *       rpl_node_get_next_hop_list(node_t *node);
+void                        rpl_next_hop_list_hold(rpl_next_hop_list_t *next_hop_list);
+void                        rpl_next_hop_list_release(rpl_next_hop_list_t *next_hop_list);
+bool                        rpl_next_hop_list_is_current(node_t *node, rpl_next_hop_list_t *next_hop_list);
+uint8                       rpl_node_process_incoming_flow_label(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu);
 node_t *                    rpl_node_process_outgoing_flow_label(node_t *node, node_t *incoming_node, node_t *proposed_dst_node, ip_pdu_t *ip_pdu);
+void                        rpl_node_set_source_route(node_t *node, ip_pdu_t *ip_pdu);
+void                        rpl_node_add_link_sample(node_t *node, node_t *neighbor_node, uint8 transmission_count, bool acknowledged);
 
-bool                        rpl_node_send_dis(node_t *node, char *dst_ip_address);
+bool                        rpl_node_send_dis(node_t *node, address_t dst_address);
 bool                        rpl_node_receive_dis(node_t *node, node_t *incoming_node);
-bool                        rpl_node_send_dio(node_t *node, char *dst_ip_address, rpl_dio_pdu_t *pdu);
+bool                        rpl_node_send_dio(node_t *node, address_t dst_address, rpl_dio_pdu_t *pdu);
 bool                        rpl_node_receive_dio(node_t *node, node_t *incoming_node, rpl_dio_pdu_t *pdu);
-bool                        rpl_node_send_dao(node_t *node, char *dst_ip_address, rpl_dao_pdu_t *pdu);
+bool                        rpl_node_send_dao(node_t *node, address_t dst_address, rpl_dao_pdu_t *pdu);
 bool                        rpl_node_receive_dao(node_t *node, node_t *incoming_node, rpl_dao_pdu_t *pdu);
 
 
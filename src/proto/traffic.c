@@ -0,0 +1,429 @@
+/*
+   RPL Simulator.
+
+   Copyright (c) Calin Crisan 2010
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <math.h>
+
+#include "traffic.h"
+#include "../system.h"
+
+
+    /**** global variables ****/
+
+uint16                  traffic_event_node_wake;
+uint16                  traffic_event_node_kill;
+
+uint16                  traffic_event_pdu_send;
+uint16                  traffic_event_pdu_receive;
+
+uint16                  traffic_event_flow_burst;
+
+static char *           flow_type_name_list[TRAFFIC_FLOW_TYPE_COUNT] = {
+                            "cbr",
+                            "poisson",
+                            "on_off"
+                        };
+
+    /* released pdus are kept for reuse instead of being freed */
+static traffic_pdu_t *  pdu_pool_first = NULL;
+
+
+    /**** local function prototypes ****/
+
+static bool             event_handler_node_wake(node_t *node);
+static bool             event_handler_node_kill(node_t *node);
+
+static bool             event_handler_pdu_send(node_t *node, address_t dst_address, traffic_pdu_t *pdu);
+static bool             event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu);
+
+static bool             event_handler_flow_burst(node_t *node, traffic_flow_t *flow);
+
+static void             event_arg_str(uint16 event_id, void *data1, void *data2, char *str1, char *str2, uint16 len);
+
+static address_t        flow_get_dst_address(node_t *node, traffic_flow_t *flow);
+static sim_time_t       flow_get_next_delay(traffic_flow_t *flow);
+static sim_time_t       random_exponential(sim_time_t mean);
+
+
+    /**** exported functions ****/
+
+bool traffic_init()
+{
+    traffic_event_node_wake = event_register("node_wake", "traffic", (event_handler_t) event_handler_node_wake, NULL);
+    traffic_event_node_kill = event_register("node_kill", "traffic", (event_handler_t) event_handler_node_kill, NULL);
+
+    traffic_event_pdu_send = event_register("pdu_send", "traffic", (event_handler_t) event_handler_pdu_send, event_arg_str);
+    traffic_event_pdu_receive = event_register("pdu_receive", "traffic", (event_handler_t) event_handler_pdu_receive, event_arg_str);
+
+    traffic_event_flow_burst = event_register("flow_burst", "traffic", (event_handler_t) event_handler_flow_burst, event_arg_str);
+
+    return TRUE;
+}
+
+bool traffic_done()
+{
+    while (pdu_pool_first != NULL) {
+        traffic_pdu_t *pdu = pdu_pool_first;
+        pdu_pool_first = pdu->pool_next;
+
+        free(pdu);
+    }
+
+    return TRUE;
+}
+
+char *traffic_flow_type_get_name(uint8 type)
+{
+    rs_assert(type < TRAFFIC_FLOW_TYPE_COUNT);
+
+    return flow_type_name_list[type];
+}
+
+int8 traffic_flow_type_find_by_name(char *name)
+{
+    rs_assert(name != NULL);
+
+    uint8 i;
+    for (i = 0; i < TRAFFIC_FLOW_TYPE_COUNT; i++) {
+        if (!strcmp(flow_type_name_list[i], name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+traffic_pdu_t *traffic_pdu_create(uint32 seq_num, uint16 payload_size)
+{
+    traffic_pdu_t *pdu = pdu_pool_first;
+
+    if (pdu != NULL) {
+        pdu_pool_first = pdu->pool_next;
+    }
+    else {
+        pdu = malloc(sizeof(traffic_pdu_t));
+    }
+
+    pdu->seq_num = seq_num;
+    pdu->send_time = rs_system->now;
+    pdu->payload_size = payload_size < TRAFFIC_MAX_PAYLOAD_SIZE ? payload_size : TRAFFIC_MAX_PAYLOAD_SIZE;
+    memset(pdu->payload, 0, pdu->payload_size);
+    pdu->pool_next = NULL;
+
+    return pdu;
+}
+
+void traffic_pdu_destroy(traffic_pdu_t *pdu)
+{
+    rs_assert(pdu != NULL);
+
+    pdu->pool_next = pdu_pool_first;
+    pdu_pool_first = pdu;
+}
+
+traffic_pdu_t *traffic_pdu_duplicate(traffic_pdu_t *pdu)
+{
+    rs_assert(pdu != NULL);
+
+    traffic_pdu_t *new_pdu = traffic_pdu_create(pdu->seq_num, pdu->payload_size);
+
+    new_pdu->send_time = pdu->send_time;
+    memcpy(new_pdu->payload, pdu->payload, pdu->payload_size);
+
+    return new_pdu;
+}
+
+void traffic_node_init(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    node->traffic_info = malloc(sizeof(traffic_node_info_t));
+
+    node->traffic_info->flow_list = NULL;
+    node->traffic_info->flow_count = 0;
+}
+
+void traffic_node_done(node_t *node)
+{
+    rs_assert(node != NULL);
+
+    if (node->traffic_info != NULL) {
+        while (node->traffic_info->flow_count > 0) {
+            traffic_node_rem_flow(node, node->traffic_info->flow_count - 1);
+        }
+
+        free(node->traffic_info);
+        node->traffic_info = NULL;
+    }
+}
+
+traffic_flow_t *traffic_node_add_flow(node_t *node, uint8 type, char *dst)
+{
+    rs_assert(node != NULL);
+    rs_assert(dst != NULL);
+
+    traffic_flow_t *flow = malloc(sizeof(traffic_flow_t));
+
+    flow->type = type;
+    flow->dst = strdup(dst);
+    flow->start_time = 0;
+    flow->interval = TRAFFIC_DEFAULT_INTERVAL;
+    flow->burst_size = TRAFFIC_DEFAULT_BURST_SIZE;
+    flow->off_time = TRAFFIC_DEFAULT_OFF_TIME;
+    flow->payload_size = TRAFFIC_DEFAULT_PAYLOAD_SIZE;
+    flow->seq_num = 0;
+
+    flow->dst_address = ADDR_UNKNOWN;
+    flow->dst_version = 0;
+    flow->dst_resolved = FALSE;
+
+    node->traffic_info->flow_list = realloc(node->traffic_info->flow_list, (node->traffic_info->flow_count + 1) * sizeof(traffic_flow_t *));
+    node->traffic_info->flow_list[node->traffic_info->flow_count++] = flow;
+
+    return flow;
+}
+
+void traffic_node_rem_flow(node_t *node, uint16 index)
+{
+    rs_assert(node != NULL);
+    rs_assert(index < node->traffic_info->flow_count);
+
+    traffic_flow_t *flow = node->traffic_info->flow_list[index];
+
+    rs_system_cancel_event(node, traffic_event_flow_burst, flow, NULL, 0);
+
+    uint16 i;
+    for (i = index; i < node->traffic_info->flow_count - 1; i++) {
+        node->traffic_info->flow_list[i] = node->traffic_info->flow_list[i + 1];
+    }
+
+    node->traffic_info->flow_count--;
+    if (node->traffic_info->flow_count == 0) {
+        free(node->traffic_info->flow_list);
+        node->traffic_info->flow_list = NULL;
+    }
+
+    free(flow->dst);
+    free(flow);
+}
+
+bool traffic_node_send(node_t *node, address_t dst_address, traffic_pdu_t *pdu)
+{
+    rs_assert(node != NULL);
+    rs_assert(pdu != NULL);
+
+    if (!event_execute(traffic_event_pdu_send, node, GUINT_TO_POINTER(dst_address), pdu)) {
+        traffic_pdu_destroy(pdu);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+bool traffic_node_receive(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu)
+{
+    rs_assert(node != NULL);
+    rs_assert(ip_pdu != NULL);
+
+    bool all_ok = event_execute(traffic_event_pdu_receive, node, incoming_node, ip_pdu);
+
+    traffic_pdu_destroy(ip_pdu->sdu);
+
+    return all_ok;
+}
+
+
+    /**** local functions ****/
+
+static bool event_handler_node_wake(node_t *node)
+{
+    uint16 i;
+    for (i = 0; i < node->traffic_info->flow_count; i++) {
+        traffic_flow_t *flow = node->traffic_info->flow_list[i];
+
+        /* flows already due start at a random moment, so the nodes don't all send together */
+        sim_time_t delay = flow->start_time - rs_system->now;
+        if (delay < 0) {
+            delay = rs_system_random() % (flow_get_next_delay(flow) + 1);
+        }
+
+        rs_system_schedule_event(node, traffic_event_flow_burst, flow, NULL, delay);
+    }
+
+    return TRUE;
+}
+
+static bool event_handler_node_kill(node_t *node)
+{
+    rs_system_cancel_event(node, traffic_event_flow_burst, NULL, NULL, 0);
+
+    uint16 i;
+    for (i = 0; i < node->traffic_info->flow_count; i++) {
+        node->traffic_info->flow_list[i]->seq_num = 0;
+    }
+
+    return TRUE;
+}
+
+static bool event_handler_pdu_send(node_t *node, address_t dst_address, traffic_pdu_t *pdu)
+{
+    if (!ip_node_send(node, dst_address, IP_NEXT_HEADER_TRAFFIC, pdu)) {
+        return FALSE;
+    }
+
+    measure_node_add_traffic_packet(node, FALSE, 0);
+
+    return TRUE;
+}
+
+static bool event_handler_pdu_receive(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu)
+{
+    traffic_pdu_t *pdu = ip_pdu->sdu;
+    rs_assert(pdu != NULL);
+
+    rs_debug(DEBUG_TRAFFIC, "node '%s': received packet %d from '%s' after %d ms",
+            node->phy_info->name, pdu->seq_num, addr_to_string(ip_pdu->src_address), rs_system->now - pdu->send_time);
+
+    measure_node_add_traffic_packet(node, TRUE, rs_system->now - pdu->send_time);
+
+    return TRUE;
+}
+
+static bool event_handler_flow_burst(node_t *node, traffic_flow_t *flow)
+{
+    address_t dst_address = flow_get_dst_address(node, flow);
+
+    if (dst_address != ADDR_UNKNOWN) {
+        /* the whole burst is handed to IP at once, its queue spaces the packets out */
+        uint16 count = (flow->type == TRAFFIC_FLOW_TYPE_ON_OFF) ? flow->burst_size : 1;
+        uint16 i;
+        for (i = 0; i < count; i++) {
+            traffic_pdu_t *pdu = traffic_pdu_create(flow->seq_num++, flow->payload_size);
+
+            if (!traffic_node_send(node, dst_address, pdu)) {
+                rs_debug(DEBUG_TRAFFIC, "node '%s': failed to send packet to '%s'", node->phy_info->name, addr_to_string(dst_address));
+            }
+        }
+    }
+    else {
+        rs_debug(DEBUG_TRAFFIC, "node '%s': no destination for flow to '%s'", node->phy_info->name, flow->dst);
+    }
+
+    rs_system_schedule_event(node, traffic_event_flow_burst, flow, NULL, flow_get_next_delay(flow));
+
+    return TRUE;
+}
+
+static void event_arg_str(uint16 event_id, void *data1, void *data2, char *str1, char *str2, uint16 len)
+{
+    str1[0] = '\0';
+    str2[0] = '\0';
+
+    if (event_id == traffic_event_pdu_send) {
+        address_t dst_address = GPOINTER_TO_UINT(data1);
+        traffic_pdu_t *pdu = data2;
+
+        snprintf(str1, len, "dst = '%s'", dst_address != ADDR_BROADCAST ? addr_to_string(dst_address) : "<<broadcast>>");
+        snprintf(str2, len, "traffic_pdu = {seq_num = %d, payload_size = %d}", pdu->seq_num, pdu->payload_size);
+    }
+    else if (event_id == traffic_event_pdu_receive) {
+        node_t *node = data1;
+        ip_pdu_t *pdu = data2;
+
+        snprintf(str1, len, "incoming_node = '%s'", (node != NULL ? node->phy_info->name : "<<unknown>>"));
+        snprintf(str2, len, "ip_pdu = {src = '%s', dst = '%s'}", addr_to_string(pdu->src_address), addr_to_string(pdu->dst_address));
+    }
+    else if (event_id == traffic_event_flow_burst) {
+        traffic_flow_t *flow = data1;
+
+        snprintf(str1, len, "flow = {type = '%s', dst = '%s'}", traffic_flow_type_get_name(flow->type), flow->dst);
+        snprintf(str2, len, "seq_num = %d", flow->seq_num);
+    }
+}
+
+static address_t flow_get_dst_address(node_t *node, traffic_flow_t *flow)
+{
+    if (strcmp(flow->dst, TRAFFIC_DST_ROOT) == 0) {
+        if (!rpl_node_is_joined(node)) { /* a root, or not part of any dodag yet */
+            return ADDR_UNKNOWN;
+        }
+
+        return node->rpl_info->joined_dodag->interned_dodag_id;
+    }
+    else if (strcmp(flow->dst, TRAFFIC_DST_ALL) == 0) {
+        address_t dst_address = ADDR_UNKNOWN;
+
+        nodes_lock();
+
+        if (rs_system->node_count > 1) {
+            /* any node but this one */
+            uint16 pos = rs_system_random() % (rs_system->node_count - 1);
+            node_t *dst_node = rs_system->node_list[pos];
+            if (dst_node == node) {
+                dst_node = rs_system->node_list[rs_system->node_count - 1];
+            }
+
+            dst_address = dst_node->ip_info->address_id;
+        }
+
+        nodes_unlock();
+
+        return dst_address;
+    }
+    else {
+        if (!flow->dst_resolved || flow->dst_version != rs_system->node_version) { /* not on every burst */
+            node_t *dst_node = rs_system_find_node_by_name(flow->dst);
+
+            flow->dst_address = (dst_node != NULL && dst_node != node) ? dst_node->ip_info->address_id : ADDR_UNKNOWN;
+            flow->dst_version = rs_system->node_version;
+            flow->dst_resolved = TRUE;
+        }
+
+        return flow->dst_address;
+    }
+}
+
+static sim_time_t flow_get_next_delay(traffic_flow_t *flow)
+{
+    sim_time_t delay;
+
+    switch (flow->type) {
+        case TRAFFIC_FLOW_TYPE_POISSON:
+            delay = random_exponential(flow->interval);
+            break;
+
+        case TRAFFIC_FLOW_TYPE_ON_OFF:
+            delay = random_exponential(flow->off_time);
+            break;
+
+        default: /* TRAFFIC_FLOW_TYPE_CBR */
+            delay = flow->interval;
+    }
+
+    /* a flow rescheduled at the same time over and over would never let the clock advance */
+    return delay > 0 ? delay : 1;
+}
+
+static sim_time_t random_exponential(sim_time_t mean)
+{
+    /* inverse transform sampling, u is never 0 */
+    double u = ((rs_system_random() % 1000000) + 1) / 1000000.0;
+
+    return (sim_time_t) (-log(u) * mean);
+}
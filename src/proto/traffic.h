@@ -0,0 +1,117 @@
+/*
+   RPL Simulator.
+
+   Copyright (c) Calin Crisan 2010
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef TRAFFIC_H_
+#define TRAFFIC_H_
+
+#include "../base.h"
+#include "../node.h"
+#include "ip.h"
+
+#define IP_NEXT_HEADER_TRAFFIC              0x11
+
+#define TRAFFIC_FLOW_TYPE_CBR               0
+#define TRAFFIC_FLOW_TYPE_POISSON           1
+#define TRAFFIC_FLOW_TYPE_ON_OFF            2
+
+#define TRAFFIC_FLOW_TYPE_COUNT             3
+
+#define TRAFFIC_DST_ROOT                    "root"  /* the root of the joined dodag */
+#define TRAFFIC_DST_ALL                     "*"     /* a random node for each burst */
+
+#define TRAFFIC_DEFAULT_INTERVAL            1000
+#define TRAFFIC_DEFAULT_BURST_SIZE          1
+#define TRAFFIC_DEFAULT_OFF_TIME            5000
+#define TRAFFIC_DEFAULT_PAYLOAD_SIZE        32
+
+#define TRAFFIC_MAX_PAYLOAD_SIZE            128
+
+
+    /* a traffic flow originating at a node */
+typedef struct traffic_flow_t {
+
+    uint8                   type;
+    char *                  dst;            /* a node name, TRAFFIC_DST_ROOT or TRAFFIC_DST_ALL */
+    sim_time_t              start_time;
+    sim_time_t              interval;       /* the (mean) time between packets, for CBR and Poisson flows */
+    uint16                  burst_size;     /* packets per burst, for on/off flows */
+    sim_time_t              off_time;       /* the mean silence between bursts, for on/off flows */
+    uint16                  payload_size;
+
+    uint32                  seq_num;
+
+        /* a named destination, resolved once per change of the node list */
+    address_t               dst_address;
+    uint32                  dst_version;
+    bool                    dst_resolved;
+
+} traffic_flow_t;
+
+    /* info that a node generating traffic should store */
+typedef struct traffic_node_info_t {
+
+    traffic_flow_t **       flow_list;
+    uint16                  flow_count;
+
+} traffic_node_info_t;
+
+    /* fields contained in a traffic packet */
+typedef struct traffic_pdu_t {
+
+    uint32                  seq_num;
+    sim_time_t              send_time;
+    uint16                  payload_size;
+    uint8                   payload[TRAFFIC_MAX_PAYLOAD_SIZE];
+
+    struct traffic_pdu_t *  pool_next;      /* link in the free pool, while not in use */
+
+} traffic_pdu_t;
+
+
+extern uint16               traffic_event_node_wake;
+extern uint16               traffic_event_node_kill;
+
+extern uint16               traffic_event_pdu_send;
+extern uint16               traffic_event_pdu_receive;
+
+extern uint16               traffic_event_flow_burst;
+
+
+bool                        traffic_init();
+bool                        traffic_done();
+
+char *                      traffic_flow_type_get_name(uint8 type);
+int8                        traffic_flow_type_find_by_name(char *name);
+
+traffic_pdu_t *             traffic_pdu_create(uint32 seq_num, uint16 payload_size);
+void                        traffic_pdu_destroy(traffic_pdu_t *pdu);
+traffic_pdu_t *             traffic_pdu_duplicate(traffic_pdu_t *pdu);
+
+void                        traffic_node_init(node_t *node);
+void                        traffic_node_done(node_t *node);
+
+traffic_flow_t *            traffic_node_add_flow(node_t *node, uint8 type, char *dst);
+void                        traffic_node_rem_flow(node_t *node, uint16 index);
+
+bool                        traffic_node_send(node_t *node, address_t dst_address, traffic_pdu_t *pdu);
+bool                        traffic_node_receive(node_t *node, node_t *incoming_node, ip_pdu_t *ip_pdu); /* yes, ip_pdu_t */
+
+
+#endif /* TRAFFIC_H_ */
@@ -62,6 +62,7 @@ bool                        apply_events_setting(char *path, char *name, char *v
 
 bool                        apply_phy_setting(char *path, phy_node_info_t *phy_node_info, char *name, char *value);
 bool                        apply_mobility_setting(char *path, phy_mobility_t *mobility, char *name, char *value);
+bool                        apply_mobility_model_setting(char *path, phy_mobility_model_t *model, char *name, char *value);
 
 bool                        apply_mac_setting(char *path, mac_node_info_t *mac_node_info, char *name, char *value);
 
@@ -74,6 +75,8 @@ bool                        apply_rpl_setting(char *path, rpl_node_info_t *rpl_n
 
 bool                        apply_measure_setting(char *path, measure_node_info_t *measure_node_info, char *name, char *value);
 
+bool                        apply_flow_setting(char *path, traffic_flow_t *flow, char *name, char *value);
+
 
     /**** exported functions ****/
 
@@ -342,11 +345,11 @@ bool load_post_process()
                 route->next_hop = rs_system_find_node_by_name((char *) route->further_info);
                 free(route->further_info);
             }
-
-            free(route->dst_bit_expanded);
-            route->dst_bit_expanded = NULL;
         }
 
+        /* the routes were edited in place while loading */
+        ip_node_reindex_routes(node);
+
         if (node->measure_info->connect_dst_node != NULL) {
             char *node_name = (char *) node->measure_info->connect_dst_node;
 
@@ -360,6 +363,9 @@ bool load_post_process()
         free(node_list);
     }
 
+    /* node coords and system params were set directly */
+    phy_update_gains();
+
     return TRUE;
 }
 
@@ -387,6 +393,9 @@ bool parse_setting_tree(setting_t *setting, char *path, node_t *node)
         else if (strcmp(setting->parent_setting->name, "mobility") == 0) {
             return apply_mobility_setting(path, node->phy_info->mobility_list[node->phy_info->mobility_count - 1], setting->name, setting->value);
         }
+        else if (strcmp(setting->parent_setting->name, "mobility_model") == 0) {
+            return apply_mobility_model_setting(path, node->phy_info->mobility_model, setting->name, setting->value);
+        }
         else if (strcmp(setting->parent_setting->name, "mac") == 0) {
             return apply_mac_setting(path, node->mac_info, setting->name, setting->value);
         }
@@ -405,6 +414,9 @@ bool parse_setting_tree(setting_t *setting, char *path, node_t *node)
         else if (strcmp(setting->parent_setting->name, "measure") == 0) {
             return apply_measure_setting(path, node->measure_info, setting->name, setting->value);
         }
+        else if (strcmp(setting->parent_setting->name, "flow") == 0) {
+            return apply_flow_setting(path, node->traffic_info->flow_list[node->traffic_info->flow_count - 1], setting->name, setting->value);
+        }
         else {
             sprintf(error_string, "unexpected setting '%s.%s'", path, setting->name);
             return FALSE;
@@ -420,15 +432,22 @@ bool parse_setting_tree(setting_t *setting, char *path, node_t *node)
             ip_node_init(node, "");
             icmp_node_init(node);
             rpl_node_init(node);
+            traffic_node_init(node);
 
             rs_system_add_node(node);
         }
         else if (strcmp(setting->name, "mobility") == 0) {
             phy_node_add_mobility(node, 0, 0, 0, 0);
         }
+        else if (strcmp(setting->name, "mobility_model") == 0) {
+            phy_node_set_mobility_model(node, PHY_MOBILITY_MODEL_RANDOM_WAYPOINT);
+        }
         else if (strcmp(setting->name, "route") == 0) {
             ip_node_add_route(node, "0", 0, NULL, IP_ROUTE_TYPE_MANUAL, NULL);
         }
+        else if (strcmp(setting->name, "flow") == 0) {
+            traffic_node_add_flow(node, TRAFFIC_FLOW_TYPE_CBR, TRAFFIC_DST_ROOT);
+        }
 
         char new_path[256];
         if (strlen(path) > 0) {
@@ -447,6 +466,16 @@ bool parse_setting_tree(setting_t *setting, char *path, node_t *node)
             }
         }
 
+        /* the speed bounds may come in any order, check them once the section is complete */
+        if (all_ok && strcmp(setting->name, "mobility_model") == 0) {
+            phy_mobility_model_t *model = node->phy_info->mobility_model;
+
+            if (model->speed_min > model->speed_max) {
+                sprintf(error_string, "invalid mobility model speeds '%s': %.2f > %.2f", new_path, model->speed_min, model->speed_max);
+                return FALSE;
+            }
+        }
+
         return all_ok;
     }
 }
@@ -491,10 +520,70 @@ setting_t *create_setting_tree()
     sprintf(text, "%d", rs_system->transmission_time);
     setting_set_value(setting, text);
 
+    setting = setting_create("propagation_model", system_setting);
+    setting_set_value(setting, phy_propagation_model_get_name(rs_system->propagation_model));
+
+    setting = setting_create("path_loss_exponent", system_setting);
+    sprintf(text, "%.02f", rs_system->path_loss_exponent);
+    setting_set_value(setting, text);
+
+    setting = setting_create("shadowing_deviation", system_setting);
+    sprintf(text, "%.02f", rs_system->shadowing_deviation);
+    setting_set_value(setting, text);
+
+    setting = setting_create("asymmetry_deviation", system_setting);
+    sprintf(text, "%.02f", rs_system->asymmetry_deviation);
+    setting_set_value(setting, text);
+
+    setting = setting_create("collisions", system_setting);
+    sprintf(text, "%s", rs_system->collisions ? "true" : "false");
+    setting_set_value(setting, text);
+
+    setting = setting_create("link_loss", system_setting);
+    sprintf(text, "%s", rs_system->link_loss ? "true" : "false");
+    setting_set_value(setting, text);
+
+    setting = setting_create("prr_steepness", system_setting);
+    sprintf(text, "%.02f", rs_system->prr_steepness);
+    setting_set_value(setting, text);
+
+    if (rs_system->link_trace_file_name != NULL) {
+        setting = setting_create("link_trace_file_name", system_setting);
+        setting_set_value(setting, rs_system->link_trace_file_name);
+    }
+
     setting = setting_create("mac_pdu_timeout", system_setting);
     sprintf(text, "%d", rs_system->mac_pdu_timeout);
     setting_set_value(setting, text);
 
+    setting = setting_create("mac_csma", system_setting);
+    sprintf(text, "%s", rs_system->mac_csma ? "true" : "false");
+    setting_set_value(setting, text);
+
+    setting = setting_create("mac_backoff_slot", system_setting);
+    sprintf(text, "%d", rs_system->mac_backoff_slot);
+    setting_set_value(setting, text);
+
+    setting = setting_create("mac_min_backoff_exponent", system_setting);
+    sprintf(text, "%d", rs_system->mac_min_backoff_exponent);
+    setting_set_value(setting, text);
+
+    setting = setting_create("mac_max_backoff_exponent", system_setting);
+    sprintf(text, "%d", rs_system->mac_max_backoff_exponent);
+    setting_set_value(setting, text);
+
+    setting = setting_create("mac_max_backoffs", system_setting);
+    sprintf(text, "%d", rs_system->mac_max_backoffs);
+    setting_set_value(setting, text);
+
+    setting = setting_create("mac_max_retries", system_setting);
+    sprintf(text, "%d", rs_system->mac_max_retries);
+    setting_set_value(setting, text);
+
+    setting = setting_create("mac_queue_size", system_setting);
+    sprintf(text, "%d", rs_system->mac_queue_size);
+    setting_set_value(setting, text);
+
     setting = setting_create("ip_pdu_timeout", system_setting);
     sprintf(text, "%d", rs_system->ip_pdu_timeout);
     setting_set_value(setting, text);
@@ -543,10 +632,21 @@ setting_t *create_setting_tree()
     sprintf(text, "%d", rs_system->rpl_dao_remove_timeout);
     setting_set_value(setting, text);
 
+    setting = setting_create("rpl_dao_max_targets", system_setting);
+    sprintf(text, "%d", rs_system->rpl_dao_max_targets);
+    setting_set_value(setting, text);
+
     setting = setting_create("rpl_max_inc_rank", system_setting);
     sprintf(text, "%d", rs_system->rpl_max_inc_rank);
     setting_set_value(setting, text);
 
+    setting = setting_create("rpl_objective_function", system_setting);
+    setting_set_value(setting, rpl_of_get_name(rs_system->rpl_ocp));
+
+    setting = setting_create("rpl_parent_switch_threshold", system_setting);
+    sprintf(text, "%d", rs_system->rpl_parent_switch_threshold);
+    setting_set_value(setting, text);
+
     setting = setting_create("rpl_poison_count", system_setting);
     sprintf(text, "%d", rs_system->rpl_poison_count);
     setting_set_value(setting, text);
@@ -629,10 +729,18 @@ setting_t *create_setting_tree()
     sprintf(text, "%s", event_get_logging(phy_event_neighbor_detach) ? "true" : "false");
     setting_set_value(setting, text);
 
+    setting = setting_create("phy_event_neighbors_update_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(phy_event_neighbors_update) ? "true" : "false");
+    setting_set_value(setting, text);
+
     setting = setting_create("phy_event_change_mobility_logging", events_setting);
     sprintf(text, "%s", event_get_logging(phy_event_change_mobility) ? "true" : "false");
     setting_set_value(setting, text);
 
+    setting = setting_create("phy_event_trace_advance_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(phy_event_trace_advance) ? "true" : "false");
+    setting_set_value(setting, text);
+
     setting = setting_create("mac_event_node_wake_logging", events_setting);
     sprintf(text, "%s", event_get_logging(mac_event_node_wake) ? "true" : "false");
     setting_set_value(setting, text);
@@ -649,6 +757,10 @@ setting_t *create_setting_tree()
     sprintf(text, "%s", event_get_logging(mac_event_pdu_send_timeout_check) ? "true" : "false");
     setting_set_value(setting, text);
 
+    setting = setting_create("mac_event_pdu_send_attempt_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(mac_event_pdu_send_attempt) ? "true" : "false");
+    setting_set_value(setting, text);
+
     setting = setting_create("mac_event_pdu_receive_logging", events_setting);
     sprintf(text, "%s", event_get_logging(mac_event_pdu_receive) ? "true" : "false");
     setting_set_value(setting, text);
@@ -745,6 +857,10 @@ setting_t *create_setting_tree()
     sprintf(text, "%s", event_get_logging(rpl_event_neighbor_detach) ? "true" : "false");
     setting_set_value(setting, text);
 
+    setting = setting_create("rpl_event_loop_detected_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(rpl_event_loop_detected) ? "true" : "false");
+    setting_set_value(setting, text);
+
     setting = setting_create("rpl_event_forward_failure_logging", events_setting);
     sprintf(text, "%s", event_get_logging(rpl_event_forward_failure) ? "true" : "false");
     setting_set_value(setting, text);
@@ -773,6 +889,26 @@ setting_t *create_setting_tree()
     sprintf(text, "%s", event_get_logging(rpl_event_seq_num_autoinc) ? "true" : "false");
     setting_set_value(setting, text);
 
+    setting = setting_create("traffic_event_node_wake_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(traffic_event_node_wake) ? "true" : "false");
+    setting_set_value(setting, text);
+
+    setting = setting_create("traffic_event_node_kill_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(traffic_event_node_kill) ? "true" : "false");
+    setting_set_value(setting, text);
+
+    setting = setting_create("traffic_event_pdu_send_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(traffic_event_pdu_send) ? "true" : "false");
+    setting_set_value(setting, text);
+
+    setting = setting_create("traffic_event_pdu_receive_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(traffic_event_pdu_receive) ? "true" : "false");
+    setting_set_value(setting, text);
+
+    setting = setting_create("traffic_event_flow_burst_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(traffic_event_flow_burst) ? "true" : "false");
+    setting_set_value(setting, text);
+
     setting = setting_create("measure_event_node_wake_logging", events_setting);
     sprintf(text, "%s", event_get_logging(measure_event_node_wake) ? "true" : "false");
     setting_set_value(setting, text);
@@ -793,6 +929,10 @@ setting_t *create_setting_tree()
     sprintf(text, "%s", event_get_logging(measure_event_connect_update) ? "true" : "false");
     setting_set_value(setting, text);
 
+    setting = setting_create("measure_event_connect_refresh_logging", events_setting);
+    sprintf(text, "%s", event_get_logging(measure_event_connect_refresh) ? "true" : "false");
+    setting_set_value(setting, text);
+
     setting = setting_create("measure_event_connect_hop_passed_logging", events_setting);
     sprintf(text, "%s", event_get_logging(measure_event_connect_hop_passed) ? "true" : "false");
     setting_set_value(setting, text);
@@ -868,6 +1008,39 @@ setting_t *create_setting_tree()
             setting_set_value(setting, text);
         }
 
+        if (node->phy_info->mobility_model != NULL) {
+            phy_mobility_model_t *model = node->phy_info->mobility_model;
+
+            setting_t *model_setting = setting_create("mobility_model", node_setting);
+
+            setting = setting_create("type", model_setting);
+            setting_set_value(setting, phy_mobility_model_get_name(model->type));
+
+            setting = setting_create("seed", model_setting);
+            sprintf(text, "%u", model->seed);
+            setting_set_value(setting, text);
+
+            setting = setting_create("speed_min", model_setting);
+            sprintf(text, "%.02f", model->speed_min);
+            setting_set_value(setting, text);
+
+            setting = setting_create("speed_max", model_setting);
+            sprintf(text, "%.02f", model->speed_max);
+            setting_set_value(setting, text);
+
+            setting = setting_create("pause_time", model_setting);
+            sprintf(text, "%d", model->pause_time);
+            setting_set_value(setting, text);
+
+            setting = setting_create("alpha", model_setting);
+            sprintf(text, "%.02f", model->alpha);
+            setting_set_value(setting, text);
+
+            setting = setting_create("interval", model_setting);
+            sprintf(text, "%d", model->interval);
+            setting_set_value(setting, text);
+        }
+
         setting_t *mac_setting = setting_create("mac", node_setting);
 
         setting = setting_create("address", mac_setting);
@@ -960,6 +1133,41 @@ setting_t *create_setting_tree()
         sprintf(text, "%d", node->rpl_info->root_info->min_hop_rank_inc);
         setting_set_value(setting, text);
 
+        setting = setting_create("objective_function", rpl_setting);
+        setting_set_value(setting, rpl_of_get_name(node->rpl_info->root_info->ocp));
+
+        for (j = 0; j < node->traffic_info->flow_count; j++) {
+            traffic_flow_t *flow = node->traffic_info->flow_list[j];
+
+            setting_t *flow_setting = setting_create("flow", node_setting);
+
+            setting = setting_create("type", flow_setting);
+            setting_set_value(setting, traffic_flow_type_get_name(flow->type));
+
+            setting = setting_create("dst", flow_setting);
+            setting_set_value(setting, flow->dst);
+
+            setting = setting_create("start_time", flow_setting);
+            sprintf(text, "%d", flow->start_time);
+            setting_set_value(setting, text);
+
+            setting = setting_create("interval", flow_setting);
+            sprintf(text, "%d", flow->interval);
+            setting_set_value(setting, text);
+
+            setting = setting_create("burst_size", flow_setting);
+            sprintf(text, "%d", flow->burst_size);
+            setting_set_value(setting, text);
+
+            setting = setting_create("off_time", flow_setting);
+            sprintf(text, "%d", flow->off_time);
+            setting_set_value(setting, text);
+
+            setting = setting_create("payload_size", flow_setting);
+            sprintf(text, "%d", flow->payload_size);
+            setting_set_value(setting, text);
+        }
+
         setting_t *measure_setting = setting_create("measure", node_setting);
 
         if (node->measure_info->connect_dst_node != NULL) {
@@ -1002,9 +1210,64 @@ bool apply_system_setting(char *path, char *name, char *value)
     else if (strcmp(name, "transmission_time") == 0) {
         rs_system->transmission_time = strtol(value, NULL, 10);
     }
+    else if (strcmp(name, "propagation_model") == 0) {
+        int8 model = phy_propagation_model_find_by_name(value);
+        if (model < 0) {
+            sprintf(error_string, "unknown propagation model '%s'", value);
+            return FALSE;
+        }
+
+        rs_system->propagation_model = model;
+    }
+    else if (strcmp(name, "path_loss_exponent") == 0) {
+        rs_system->path_loss_exponent = strtof(value, NULL);
+    }
+    else if (strcmp(name, "shadowing_deviation") == 0) {
+        rs_system->shadowing_deviation = strtof(value, NULL);
+    }
+    else if (strcmp(name, "asymmetry_deviation") == 0) {
+        rs_system->asymmetry_deviation = strtof(value, NULL);
+    }
+    else if (strcmp(name, "collisions") == 0) {
+        rs_system->collisions = (strcmp(value, "true") == 0);
+    }
+    else if (strcmp(name, "link_loss") == 0) {
+        rs_system->link_loss = (strcmp(value, "true") == 0);
+    }
+    else if (strcmp(name, "prr_steepness") == 0) {
+        rs_system->prr_steepness = strtof(value, NULL);
+    }
+    else if (strcmp(name, "link_trace_file_name") == 0) {
+        if (rs_system->link_trace_file_name != NULL) {
+            free(rs_system->link_trace_file_name);
+        }
+
+        rs_system->link_trace_file_name = strdup(value);
+    }
     else if (strcmp(name, "mac_pdu_timeout") == 0) {
         rs_system->mac_pdu_timeout = strtol(value, NULL, 10);
     }
+    else if (strcmp(name, "mac_csma") == 0) {
+        rs_system->mac_csma = (strcmp(value, "true") == 0);
+    }
+    else if (strcmp(name, "mac_backoff_slot") == 0) {
+        rs_system->mac_backoff_slot = strtol(value, NULL, 10);
+    }
+    else if (strcmp(name, "mac_min_backoff_exponent") == 0) {
+        rs_system->mac_min_backoff_exponent = strtol(value, NULL, 10);
+    }
+    else if (strcmp(name, "mac_max_backoff_exponent") == 0) {
+        rs_system->mac_max_backoff_exponent = strtol(value, NULL, 10);
+    }
+    else if (strcmp(name, "mac_max_backoffs") == 0) {
+        rs_system->mac_max_backoffs = strtol(value, NULL, 10);
+    }
+    else if (strcmp(name, "mac_max_retries") == 0) {
+        rs_system->mac_max_retries = strtol(value, NULL, 10);
+    }
+    else if (strcmp(name, "mac_queue_size") == 0) {
+        rs_system->mac_queue_size = strtol(value, NULL, 10);
+    }
     else if (strcmp(name, "ip_pdu_timeout") == 0) {
         rs_system->ip_pdu_timeout = strtol(value, NULL, 10);
     }
@@ -1041,9 +1304,24 @@ bool apply_system_setting(char *path, char *name, char *value)
     else if (strcmp(name, "rpl_dao_remove_timeout") == 0) {
         rs_system->rpl_dao_remove_timeout = strtol(value, NULL, 10);
     }
+    else if (strcmp(name, "rpl_dao_max_targets") == 0) {
+        rs_system->rpl_dao_max_targets = strtol(value, NULL, 10);
+    }
     else if (strcmp(name, "rpl_max_inc_rank") == 0) {
         rs_system->rpl_max_inc_rank = strtol(value, NULL, 10);
     }
+    else if (strcmp(name, "rpl_objective_function") == 0) {
+        int8 ocp = rpl_of_find_by_name(value);
+        if (ocp < 0) {
+            sprintf(error_string, "unknown objective function '%s'", value);
+            return FALSE;
+        }
+
+        rs_system->rpl_ocp = ocp;
+    }
+    else if (strcmp(name, "rpl_parent_switch_threshold") == 0) {
+        rs_system->rpl_parent_switch_threshold = strtol(value, NULL, 10);
+    }
     else if (strcmp(name, "rpl_poison_count") == 0) {
         rs_system->rpl_poison_count = strtol(value, NULL, 10);
     }
@@ -1121,9 +1399,15 @@ bool apply_events_setting(char *path, char *name, char *value)
     else if (strcmp(name, "phy_event_neighbor_detach_logging") == 0) {
         event_set_logging(phy_event_neighbor_detach, (strcmp(value, "true") == 0));
     }
+    else if (strcmp(name, "phy_event_neighbors_update_logging") == 0) {
+        event_set_logging(phy_event_neighbors_update, (strcmp(value, "true") == 0));
+    }
     else if (strcmp(name, "phy_event_change_mobility_logging") == 0) {
         event_set_logging(phy_event_change_mobility, (strcmp(value, "true") == 0));
     }
+    else if (strcmp(name, "phy_event_trace_advance_logging") == 0) {
+        event_set_logging(phy_event_trace_advance, (strcmp(value, "true") == 0));
+    }
     else if (strcmp(name, "mac_event_node_wake_logging") == 0) {
         event_set_logging(mac_event_node_wake, (strcmp(value, "true") == 0));
     }
@@ -1136,6 +1420,9 @@ bool apply_events_setting(char *path, char *name, char *value)
     else if (strcmp(name, "mac_event_pdu_send_timeout_check_logging") == 0) {
         event_set_logging(mac_event_pdu_send_timeout_check, (strcmp(value, "true") == 0));
     }
+    else if (strcmp(name, "mac_event_pdu_send_attempt_logging") == 0) {
+        event_set_logging(mac_event_pdu_send_attempt, (strcmp(value, "true") == 0));
+    }
     else if (strcmp(name, "mac_event_pdu_receive_logging") == 0) {
         event_set_logging(mac_event_pdu_receive, (strcmp(value, "true") == 0));
     }
@@ -1208,6 +1495,9 @@ bool apply_events_setting(char *path, char *name, char *value)
     else if (strcmp(name, "rpl_event_neighbor_detach_logging") == 0) {
         event_set_logging(rpl_event_neighbor_detach, (strcmp(value, "true") == 0));
     }
+    else if (strcmp(name, "rpl_event_loop_detected_logging") == 0) {
+        event_set_logging(rpl_event_loop_detected, (strcmp(value, "true") == 0));
+    }
     else if (strcmp(name, "rpl_event_forward_failure_logging") == 0) {
         event_set_logging(rpl_event_forward_failure, (strcmp(value, "true") == 0));
     }
@@ -1229,6 +1519,21 @@ bool apply_events_setting(char *path, char *name, char *value)
     else if (strcmp(name, "rpl_event_seq_num_autoinc_logging") == 0) {
         event_set_logging(rpl_event_seq_num_autoinc, (strcmp(value, "true") == 0));
     }
+    else if (strcmp(name, "traffic_event_node_wake_logging") == 0) {
+        event_set_logging(traffic_event_node_wake, (strcmp(value, "true") == 0));
+    }
+    else if (strcmp(name, "traffic_event_node_kill_logging") == 0) {
+        event_set_logging(traffic_event_node_kill, (strcmp(value, "true") == 0));
+    }
+    else if (strcmp(name, "traffic_event_pdu_send_logging") == 0) {
+        event_set_logging(traffic_event_pdu_send, (strcmp(value, "true") == 0));
+    }
+    else if (strcmp(name, "traffic_event_pdu_receive_logging") == 0) {
+        event_set_logging(traffic_event_pdu_receive, (strcmp(value, "true") == 0));
+    }
+    else if (strcmp(name, "traffic_event_flow_burst_logging") == 0) {
+        event_set_logging(traffic_event_flow_burst, (strcmp(value, "true") == 0));
+    }
     else if (strcmp(name, "measure_event_node_wake_logging") == 0) {
         event_set_logging(measure_event_node_wake, (strcmp(value, "true") == 0));
     }
@@ -1244,6 +1549,9 @@ bool apply_events_setting(char *path, char *name, char *value)
     else if (strcmp(name, "measure_event_connect_update_logging") == 0) {
         event_set_logging(measure_event_connect_update, (strcmp(value, "true") == 0));
     }
+    else if (strcmp(name, "measure_event_connect_refresh_logging") == 0) {
+        event_set_logging(measure_event_connect_refresh, (strcmp(value, "true") == 0));
+    }
     else if (strcmp(name, "measure_event_connect_hop_passed_logging") == 0) {
         event_set_logging(measure_event_connect_hop_passed, (strcmp(value, "true") == 0));
     }
@@ -1271,6 +1579,7 @@ bool apply_phy_setting(char *path, phy_node_info_t *phy_node_info, char *name, c
 {
     if (strcmp(name, "name") == 0) {
         phy_node_info->name = strdup(value);
+        rs_system_nodes_changed();
     }
     else if (strcmp(name, "cx") == 0) {
         phy_node_info->cx = strtof(value, NULL);
@@ -1317,10 +1626,62 @@ bool apply_mobility_setting(char *path, phy_mobility_t *mobility, char *name, ch
     return TRUE;
 }
 
+bool apply_mobility_model_setting(char *path, phy_mobility_model_t *model, char *name, char *value)
+{
+    if (strcmp(name, "type") == 0) {
+        int8 type = phy_mobility_model_find_by_name(value);
+        if (type < 0) {
+            sprintf(error_string, "unknown mobility model '%s'", value);
+            return FALSE;
+        }
+
+        if (type == PHY_MOBILITY_MODEL_NONE) { /* a model section without a model */
+            sprintf(error_string, "invalid mobility model '%s'", value);
+            return FALSE;
+        }
+
+        model->type = type;
+    }
+    else if (strcmp(name, "seed") == 0) {
+        model->seed = strtoul(value, NULL, 10);
+    }
+    else if (strcmp(name, "speed_min") == 0) {
+        model->speed_min = strtof(value, NULL);
+    }
+    else if (strcmp(name, "speed_max") == 0) {
+        model->speed_max = strtof(value, NULL);
+    }
+    else if (strcmp(name, "pause_time") == 0) {
+        model->pause_time = strtol(value, NULL, 10);
+    }
+    else if (strcmp(name, "alpha") == 0) {
+        model->alpha = strtof(value, NULL);
+        if (model->alpha < 0 || model->alpha > 1) {
+            sprintf(error_string, "invalid mobility model alpha '%s'", value);
+            return FALSE;
+        }
+    }
+    else if (strcmp(name, "interval") == 0) {
+        model->interval = strtol(value, NULL, 10);
+        if (model->interval <= 0) {
+            sprintf(error_string, "invalid mobility model interval '%s'", value);
+            return FALSE;
+        }
+    }
+    else {
+        sprintf(error_string, "unexpected setting '%s.%s'", path, name);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 bool apply_mac_setting(char *path, mac_node_info_t *mac_node_info, char *name, char *value)
 {
     if (strcmp(name, "address") == 0) {
         mac_node_info->address = strdup(value);
+        mac_node_info->address_id = addr_intern(value);
+        rs_system_nodes_changed();
     }
     else {
         sprintf(error_string, "unexpected setting '%s.%s'", path, name);
@@ -1334,6 +1695,8 @@ bool apply_ip_setting(char *path, ip_node_info_t *ip_node_info, char *name, char
 {
     if (strcmp(name, "address") == 0) {
         ip_node_info->address = strdup(value);
+        ip_node_info->address_id = addr_intern(value);
+        rs_system_nodes_changed();
     }
     else {
         sprintf(error_string, "unexpected setting '%s.%s'", path, name);
@@ -1349,7 +1712,13 @@ bool apply_route_setting(char *path, ip_route_t *route, char *name, char *value)
         route->dst = strdup(value);
     }
     else if (strcmp(name, "prefix_len") == 0) {
-        route->prefix_len = strtol(value, NULL, 10);
+        int32 prefix_len = strtol(value, NULL, 10);
+        if (prefix_len < 0 || prefix_len > ADDR_MAX_BITS) {
+            sprintf(error_string, "invalid route prefix length '%s'", value);
+            return FALSE;
+        }
+
+        route->prefix_len = prefix_len;
     }
     else if (strcmp(name, "next_hop") == 0) {
         route->further_info = strdup(value); /* workaround */
@@ -1366,6 +1735,7 @@ bool apply_icmp_setting(char *path, icmp_node_info_t *icmp_node_info, char *name
 {
     if (strcmp(name, "ping_ip_address") == 0) {
         icmp_node_info->ping_ip_address = strdup(value);
+        icmp_node_info->ping_address_id = addr_intern(value);
     }
     else if (strcmp(name, "ping_interval") == 0) {
         icmp_node_info->ping_interval= strtol(value, NULL, 10);
@@ -1416,6 +1786,15 @@ bool apply_rpl_setting(char *path, rpl_node_info_t *rpl_node_info, char *name, c
     else if (strcmp(name, "min_hop_rank_inc") == 0) {
         rpl_node_info->root_info->min_hop_rank_inc = strtol(value, NULL, 10);
     }
+    else if (strcmp(name, "objective_function") == 0) {
+        int8 ocp = rpl_of_find_by_name(value);
+        if (ocp < 0) {
+            sprintf(error_string, "unknown objective function '%s'", value);
+            return FALSE;
+        }
+
+        rpl_node_info->root_info->ocp = ocp;
+    }
     else {
         sprintf(error_string, "unexpected setting '%s.%s'", path, name);
         return FALSE;
@@ -1436,3 +1815,53 @@ bool apply_measure_setting(char *path, measure_node_info_t *measure_node_info, c
 
     return TRUE;
 }
+
+bool apply_flow_setting(char *path, traffic_flow_t *flow, char *name, char *value)
+{
+    if (strcmp(name, "type") == 0) {
+        int8 type = traffic_flow_type_find_by_name(value);
+        if (type < 0) {
+            sprintf(error_string, "unknown flow type '%s'", value);
+            return FALSE;
+        }
+
+        flow->type = type;
+    }
+    else if (strcmp(name, "dst") == 0) {
+        free(flow->dst);
+        flow->dst = strdup(value);
+        flow->dst_resolved = FALSE;
+    }
+    else if (strcmp(name, "start_time") == 0) {
+        flow->start_time = strtol(value, NULL, 10);
+    }
+    else if (strcmp(name, "interval") == 0) {
+        flow->interval = strtol(value, NULL, 10);
+        if (flow->interval <= 0) {
+            sprintf(error_string, "invalid flow interval '%s'", value);
+            return FALSE;
+        }
+    }
+    else if (strcmp(name, "burst_size") == 0) {
+        flow->burst_size = strtol(value, NULL, 10);
+    }
+    else if (strcmp(name, "off_time") == 0) {
+        flow->off_time = strtol(value, NULL, 10);
+        if (flow->off_time <= 0) {
+            sprintf(error_string, "invalid flow off time '%s'", value);
+            return FALSE;
+        }
+    }
+    else if (strcmp(name, "payload_size") == 0) {
+        flow->payload_size = strtol(value, NULL, 10);
+        if (flow->payload_size > TRAFFIC_MAX_PAYLOAD_SIZE) {
+            flow->payload_size = TRAFFIC_MAX_PAYLOAD_SIZE;
+        }
+    }
+    else {
+        sprintf(error_string, "unexpected setting '%s.%s'", path, name);
+        return FALSE;
+    }
+
+    return TRUE;
+}
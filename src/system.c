@@ -50,6 +50,7 @@ static schedule_bucket_t *  bucket_create(sim_time_t time, event_schedule_t *sch
 static void                 bucket_destroy(schedule_bucket_t *bucket);
 
 static void                 update_mobilities();
+static void                 address_index_rebuild();
 
 static bool                 event_handler_node_wake(node_t *node);
 static bool                 event_handler_node_kill(node_t *node);
@@ -67,6 +68,12 @@ bool rs_system_create()
 
     rs_system->node_list = NULL;
     rs_system->node_count = 0;
+    rs_system->node_version = 0;
+
+    rs_system->mac_address_index = NULL;
+    rs_system->ip_address_index = NULL;
+    rs_system->address_index_size = 0;
+    rs_system->address_index_valid = FALSE;
 
     rs_system->auto_wake_nodes = DEFAULT_AUTO_WAKE_NODES;
     rs_system->deterministic_random = DEFAULT_DETERMINISTIC_RANDOM;
@@ -78,7 +85,23 @@ bool rs_system_create()
     rs_system->no_link_quality_thresh = DEFAULT_NO_LINK_QUALITY_THRESH;
     rs_system->transmission_time = DEFAULT_TRANSMISSION_TIME;
 
+    rs_system->propagation_model = DEFAULT_PROPAGATION_MODEL;
+    rs_system->path_loss_exponent = DEFAULT_PATH_LOSS_EXPONENT;
+    rs_system->shadowing_deviation = DEFAULT_SHADOWING_DEVIATION;
+    rs_system->asymmetry_deviation = DEFAULT_ASYMMETRY_DEVIATION;
+    rs_system->collisions = DEFAULT_COLLISIONS;
+    rs_system->link_loss = DEFAULT_LINK_LOSS;
+    rs_system->prr_steepness = DEFAULT_PRR_STEEPNESS;
+    rs_system->link_trace_file_name = NULL;
+
     rs_system->mac_pdu_timeout = DEFAULT_MAC_PDU_TIMEOUT;
+    rs_system->mac_csma = DEFAULT_MAC_CSMA;
+    rs_system->mac_backoff_slot = DEFAULT_MAC_BACKOFF_SLOT;
+    rs_system->mac_min_backoff_exponent = DEFAULT_MAC_MIN_BACKOFF_EXPONENT;
+    rs_system->mac_max_backoff_exponent = DEFAULT_MAC_MAX_BACKOFF_EXPONENT;
+    rs_system->mac_max_backoffs = DEFAULT_MAC_MAX_BACKOFFS;
+    rs_system->mac_max_retries = DEFAULT_MAC_MAX_RETRIES;
+    rs_system->mac_queue_size = DEFAULT_MAC_QUEUE_SIZE;
 
     rs_system->ip_pdu_timeout = DEFAULT_IP_PDU_TIMEOUT;
     rs_system->ip_queue_size = DEFAULT_IP_QUEUE_SIZE;
@@ -97,7 +120,10 @@ bool rs_system_create()
     rs_system->rpl_dio_redundancy_constant = DEFAULT_RPL_DIO_REDUNDANCY_CONSTANT;
     rs_system->rpl_dao_root_delay = DEFAULT_RPL_DAO_ROOT_DELAY;
     rs_system->rpl_dao_remove_timeout = DEFAULT_RPL_DAO_REMOVE_TIMEOUT;
+    rs_system->rpl_dao_max_targets = DEFAULT_RPL_DAO_MAX_TARGETS;
     rs_system->rpl_max_inc_rank = DEFAULT_RPL_MAX_RANK_INC;
+    rs_system->rpl_ocp = DEFAULT_RPL_OCP;
+    rs_system->rpl_parent_switch_threshold = DEFAULT_RPL_PARENT_SWITCH_THRESHOLD;
 
     rs_system->rpl_prefer_floating = DEFAULT_RPL_PREFER_FLOATING;
 //    rs_system->rpl_min_hop_rank_inc = DEFAULT_RPL_MIN_HOP_RANK_INC;
@@ -138,6 +164,10 @@ bool rs_system_create()
         rs_error("failed to initialize RPL layer");
         return FALSE;
     }
+    if (!traffic_init()) {
+        rs_error("failed to initialize traffic layer");
+        return FALSE;
+    }
 
     if (!measure_init()) {
         rs_error("failed to initialize measurements layer");
@@ -164,6 +194,11 @@ bool rs_system_destroy()
     if (rs_system->node_list != NULL)
         free(rs_system->node_list);
 
+    if (rs_system->mac_address_index != NULL) {
+        free(rs_system->mac_address_index);
+        free(rs_system->ip_address_index);
+    }
+
     while (rs_system->schedule_bucket_first != NULL) {
         while (rs_system->schedule_bucket_first->first != NULL) {
             event_schedule_t *temp_schedule = rs_system->schedule_bucket_first->first;
@@ -182,6 +217,10 @@ bool rs_system_destroy()
         return FALSE;
     }
 
+    if (!traffic_done()) {
+        rs_error("failed to destroy traffic layer");
+        return FALSE;
+    }
     if (!rpl_done()) {
         rs_error("failed to destroy RPL layer");
         return FALSE;
@@ -203,6 +242,9 @@ bool rs_system_destroy()
         return FALSE;
     }
 
+    if (rs_system->link_trace_file_name != NULL)
+        free(rs_system->link_trace_file_name);
+
     g_static_rec_mutex_free(&rs_system->nodes_mutex);
     g_static_rec_mutex_free(&rs_system->schedules_mutex);
     g_static_rec_mutex_free(&rs_system->events_mutex);
@@ -222,9 +264,13 @@ bool rs_system_add_node(node_t *node)
 
     rs_system->node_list = realloc(rs_system->node_list, (++rs_system->node_count) * sizeof(node_t *));
     rs_system->node_list[rs_system->node_count - 1] = node;
+    rs_system->node_version++;
+    rs_system->address_index_valid = FALSE;
 
     nodes_unlock();
 
+    phy_node_update_gains(node);
+
     return TRUE;
 }
 
@@ -265,6 +311,9 @@ bool rs_system_remove_node(node_t *node)
         rs_system->node_list = NULL;
     }
 
+    rs_system->node_version++;
+    rs_system->address_index_valid = FALSE;
+
     nodes_unlock();
 
     events_lock();
@@ -278,6 +327,8 @@ bool rs_system_remove_node(node_t *node)
 
         /* phy neighbors */
         phy_node_rem_neighbor(other_node, node);
+        phy_node_rem_neighbor_change(other_node, node);
+        phy_node_rem_gain(other_node, node);
 
         /* nullify ip route refs */
         ip_node_rem_routes(other_node, NULL, -1, node, -1);
@@ -285,7 +336,6 @@ bool rs_system_remove_node(node_t *node)
         /* ip neighbors */
         ip_neighbor_t *ip_neighbor = ip_node_find_neighbor_by_node(other_node, node);
         if (ip_neighbor != NULL) {
-            rs_system_cancel_event(other_node, ip_event_neighbor_cache_timeout_check, ip_neighbor, NULL, 0);
             event_execute(rpl_event_neighbor_detach, other_node, node, NULL);
             ip_node_rem_neighbor(other_node, ip_neighbor);
         }
@@ -348,13 +398,15 @@ node_t *rs_system_find_node_by_mac_address(char *address)
     rs_assert(rs_system != NULL);
     rs_assert(address != NULL);
 
-    int i;
+    address_t addr = addr_find(address);
+
+    if (!rs_system->address_index_valid) {
+        address_index_rebuild();
+    }
+
     node_t *node = NULL;
-    for (i = 0; i < rs_system->node_count; i++) {
-        if (!strcmp(rs_system->node_list[i]->mac_info->address, address)) {
-            node = rs_system->node_list[i];
-            break;
-        }
+    if (addr != ADDR_UNKNOWN && addr < rs_system->address_index_size) {
+        node = rs_system->mac_address_index[addr];
     }
 
     nodes_unlock();
@@ -369,13 +421,15 @@ node_t *rs_system_find_node_by_ip_address(char *address)
     rs_assert(rs_system != NULL);
     rs_assert(address != NULL);
 
-    int i;
+    address_t addr = addr_find(address);
+
+    if (!rs_system->address_index_valid) {
+        address_index_rebuild();
+    }
+
     node_t *node = NULL;
-    for (i = 0; i < rs_system->node_count; i++) {
-        if (!strcmp(rs_system->node_list[i]->ip_info->address, address)) {
-            node = rs_system->node_list[i];
-            break;
-        }
+    if (addr != ADDR_UNKNOWN && addr < rs_system->address_index_size) {
+        node = rs_system->ip_address_index[addr];
     }
 
     nodes_unlock();
@@ -383,6 +437,18 @@ node_t *rs_system_find_node_by_ip_address(char *address)
     return node;
 }
 
+void rs_system_nodes_changed()
+{
+    rs_assert(rs_system != NULL);
+
+    nodes_lock();
+
+    rs_system->node_version++;
+    rs_system->address_index_valid = FALSE;
+
+    nodes_unlock();
+}
+
 node_t **rs_system_get_node_list_copy(uint16 *node_count)
 {
     rs_assert(rs_system != NULL);
@@ -583,34 +649,45 @@ bool rs_system_send(node_t *src_node, node_t* dst_node, phy_pdu_t *message)
     rs_assert(rs_system != NULL);
     rs_assert(src_node != NULL);
 
-    if (dst_node == NULL) { /* broadcast */
-        uint16 i, sent = 0;
-        for (i = 0; i < src_node->phy_info->neighbor_count; i++) {
-            dst_node = src_node->phy_info->neighbor_list[i];
+    if (rs_system->collisions) { /* a node cannot receive while transmitting */
+        phy_node_add_reception(src_node, NULL);
+    }
 
-            if (!dst_node->alive) { /* don't send messages to dead nodes */
-                continue;
-            }
+    uint16 i, sent = 0;
+    for (i = 0; i < src_node->phy_info->neighbor_count; i++) {
+        node_t *neighbor_node = src_node->phy_info->neighbor_list[i];
 
-            if (sent > 0) {
-                rs_system_send(src_node, dst_node, phy_pdu_duplicate(message));
+        if (!neighbor_node->alive) { /* don't send messages to dead nodes */
+            continue;
+        }
+
+        if (rs_system->link_loss && (dst_node == NULL || dst_node == neighbor_node) && !phy_node_link_delivers(src_node, neighbor_node)) {
+            rs_debug(DEBUG_PHY, "node '%s': frame to '%s' lost", src_node->phy_info->name, neighbor_node->phy_info->name);
+
+            if (rs_system->collisions) { /* a lost frame still occupies the channel */
+                phy_node_add_reception(neighbor_node, NULL);
             }
-            else {
-                rs_system_send(src_node, dst_node, message);
+        }
+        else if (dst_node == NULL || dst_node == neighbor_node) {
+            /* each broadcast receiver owns its copy, whatever happens to the others */
+            phy_pdu_t *pdu = (dst_node == NULL) ? phy_pdu_duplicate(message) : message;
+
+            if (rs_system->collisions) {
+                phy_node_add_reception(neighbor_node, pdu);
             }
 
+            rs_system_schedule_event(neighbor_node, sys_event_pdu_receive, src_node, pdu, rs_system->transmission_time);
+
             sent++;
         }
-
-        if (sent == 0) { /* no one received our message */
-            message->sdu = NULL;
-            phy_pdu_destroy(message);
+        else if (rs_system->collisions) { /* overheard unicast, it only interferes */
+            phy_node_add_reception(neighbor_node, NULL);
         }
     }
-    else {
-        if (phy_node_has_neighbor(src_node, dst_node)) {
-            rs_system_schedule_event(dst_node, sys_event_pdu_receive, src_node, message, rs_system->transmission_time);
-        }
+
+    if (dst_node == NULL || sent == 0) { /* a broadcast or an unsent unicast, the MAC layer still owns the frame */
+        message->sdu = NULL;
+        phy_pdu_destroy(message);
     }
 
     return TRUE;
@@ -626,16 +703,12 @@ percent_t rs_system_get_link_quality(node_t *src_node, node_t *dst_node)
         return 1.0;
     }
 
-    coord_t distance = sqrt(
-            pow(src_node->phy_info->cx - dst_node->phy_info->cx, 2) +
-            pow(src_node->phy_info->cy - dst_node->phy_info->cy, 2));
-
-    if (distance > rs_system->no_link_dist_thresh) {
-        distance = rs_system->no_link_dist_thresh;
+    if (phy_trace_active()) {
+        return phy_trace_get_quality(src_node, dst_node);
     }
 
-    percent_t dist_factor = (percent_t) (rs_system->no_link_dist_thresh - distance) / rs_system->no_link_dist_thresh;
-    percent_t quality = src_node->phy_info->tx_power * dist_factor;
+    /* the propagation model terms are precomputed in the gain tables */
+    percent_t quality = src_node->phy_info->tx_power * phy_node_get_gain(src_node, dst_node);
 
     return quality;
 }
@@ -658,14 +731,30 @@ void rs_system_start(bool start_paused)
         rs_system->random_z = RANDOM_SEED_Z;
         rs_system->random_w = RANDOM_SEED_W;
 
+        rpl_seq_num_reset();
+
+        ip_pdu_create_count = 0;
+        ip_pdu_duplicate_count = 0;
+
+        /* the propagation params might have changed since the gains were computed */
+        phy_update_gains();
+
+        uint16 i;
+        for (i = 0; i < rs_system->node_count; i++) {
+            phy_node_seed_random(rs_system->node_list[i]);
+        }
+
+        /* replay the link trace, if any, from its beginning, before the core runs any event */
+        if (rs_system->link_trace_file_name != NULL) {
+            phy_trace_start(rs_system->link_trace_file_name);
+        }
+
         GError *error;
         rs_system->sys_thread = g_thread_create(system_core, NULL, TRUE, &error);
         if (rs_system->sys_thread == NULL) {
             rs_error("g_thread_create() failed: %s", error->message);
         }
 
-        rpl_seq_num_reset();
-
         /* wait till started */
         while (!rs_system->started) {
             usleep(SYS_CORE_SLEEP);
@@ -716,7 +805,17 @@ void rs_system_stop()
     uint16 node_count;
     node_t **node_list = rs_system_get_node_list_copy(&node_count);
 
+    /* forwarded packets should cost no IP allocations, only broadcast receivers get copies */
+    uint32 gen_count = 0, fwd_count = 0;
     uint16 i;
+    for (i = 0; i < node_count; i++) {
+        gen_count += node_list[i]->measure_info->gen_ip_packet_count;
+        fwd_count += node_list[i]->measure_info->fwd_ip_packet_count;
+    }
+
+    rs_info("IP packets: %d generated, %d forwarded, %d allocated, %d duplicated",
+            gen_count, fwd_count, ip_pdu_create_count, ip_pdu_duplicate_count);
+
     for (i = 0; i < node_count; i++) {
         node_t *node = node_list[i];
         if (node->alive && !node_kill(node)) {
@@ -743,6 +842,8 @@ void rs_system_stop()
     rs_system->schedule_count = 0;
     rs_system->now = 0;
 
+    phy_trace_stop();
+
     events_unlock();
     schedules_unlock();
 }
@@ -890,7 +991,8 @@ static void *system_core(void *data)
                         event_execute(schedule->event_id, schedule->node, schedule->data1, schedule->data2);
 						if((schedule->event_id == rpl_event_neighbor_attach) ||
 						   (schedule->event_id == rpl_event_neighbor_detach) ||
-						   (schedule->event_id == rpl_event_new_pref_parent)
+						   (schedule->event_id == rpl_event_new_pref_parent) ||
+						   (schedule->event_id == rpl_event_loop_detected)
 						) rs_system->step = FALSE;
                     }
                     else {
@@ -988,6 +1090,46 @@ static void update_mobilities()
     nodes_unlock();
 }
 
+static void address_index_rebuild()
+{
+    uint32 size = 0;
+
+    uint16 i;
+    for (i = 0; i < rs_system->node_count; i++) {
+        node_t *node = rs_system->node_list[i];
+
+        if (node->mac_info->address_id != ADDR_UNKNOWN && node->mac_info->address_id >= size) {
+            size = node->mac_info->address_id + 1;
+        }
+        if (node->ip_info->address_id != ADDR_UNKNOWN && node->ip_info->address_id >= size) {
+            size = node->ip_info->address_id + 1;
+        }
+    }
+
+    if (rs_system->mac_address_index != NULL) {
+        free(rs_system->mac_address_index);
+        free(rs_system->ip_address_index);
+    }
+
+    rs_system->mac_address_index = calloc(size > 0 ? size : 1, sizeof(node_t *));
+    rs_system->ip_address_index = calloc(size > 0 ? size : 1, sizeof(node_t *));
+    rs_system->address_index_size = size;
+
+    /* the first node wins when an address is shared, as with the former linear search */
+    for (i = rs_system->node_count; i > 0; i--) {
+        node_t *node = rs_system->node_list[i - 1];
+
+        if (node->mac_info->address_id != ADDR_UNKNOWN) {
+            rs_system->mac_address_index[node->mac_info->address_id] = node;
+        }
+        if (node->ip_info->address_id != ADDR_UNKNOWN) {
+            rs_system->ip_address_index[node->ip_info->address_id] = node;
+        }
+    }
+
+    rs_system->address_index_valid = TRUE;
+}
+
 static bool event_handler_node_wake(node_t *node)
 {
     if (!event_execute(phy_event_node_wake, node, NULL, NULL))
@@ -1000,6 +1142,8 @@ static bool event_handler_node_wake(node_t *node)
         return FALSE;
     if (!event_execute(rpl_event_node_wake, node, NULL, NULL))
         return FALSE;
+    if (!event_execute(traffic_event_node_wake, node, NULL, NULL))
+        return FALSE;
     if (!event_execute(measure_event_node_wake, node, NULL, NULL))
         return FALSE;
 
@@ -1010,6 +1154,8 @@ static bool event_handler_node_kill(node_t *node)
 {
     if (!event_execute(measure_event_node_kill, node, NULL, NULL))
         return FALSE;
+    if (!event_execute(traffic_event_node_kill, node, NULL, NULL))
+        return FALSE;
     if (!event_execute(rpl_event_node_kill, node, NULL, NULL))
         return FALSE;
     if (!event_execute(icmp_event_node_kill, node, NULL, NULL))
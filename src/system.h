@@ -26,6 +26,7 @@
 #include "base.h"
 #include "node.h"
 #include "event.h"
+#include "addr.h"
 
 #include "proto/measure.h"
 #include "proto/phy.h"
@@ -33,6 +34,7 @@
 #include "proto/ip.h"
 #include "proto/icmp.h"
 #include "proto/rpl.h"
+#include "proto/traffic.h"
 
 #define DEFAULT_NODE_NAME                       "A"
 #define DEFAULT_NODE_MAC_ADDRESS                "0001"
@@ -48,7 +50,22 @@
 #define DEFAULT_NO_LINK_QUALITY_THRESH          0.2
 #define DEFAULT_TRANSMISSION_TIME               20
 
+#define DEFAULT_PROPAGATION_MODEL               PHY_PROPAGATION_MODEL_LINEAR
+#define DEFAULT_PATH_LOSS_EXPONENT              3.0
+#define DEFAULT_SHADOWING_DEVIATION             0 /* in dB, 0 disables */
+#define DEFAULT_ASYMMETRY_DEVIATION             0 /* in dB, 0 disables */
+#define DEFAULT_COLLISIONS                      FALSE
+#define DEFAULT_LINK_LOSS                       FALSE
+#define DEFAULT_PRR_STEEPNESS                   20.0
+
 #define DEFAULT_MAC_PDU_TIMEOUT                 (2 * DEFAULT_TRANSMISSION_TIME)
+#define DEFAULT_MAC_CSMA                        FALSE
+#define DEFAULT_MAC_BACKOFF_SLOT                2
+#define DEFAULT_MAC_MIN_BACKOFF_EXPONENT        3
+#define DEFAULT_MAC_MAX_BACKOFF_EXPONENT        5
+#define DEFAULT_MAC_MAX_BACKOFFS                4
+#define DEFAULT_MAC_MAX_RETRIES                 3
+#define DEFAULT_MAC_QUEUE_SIZE                  8
 
 #define DEFAULT_IP_PDU_TIMEOUT                  (3 * DEFAULT_TRANSMISSION_TIME)
 #define DEFAULT_IP_QUEUE_SIZE                   100
@@ -69,8 +86,11 @@
 
 #define DEFAULT_RPL_DAO_ROOT_DELAY              2000
 #define DEFAULT_RPL_DAO_REMOVE_TIMEOUT          2500
+#define DEFAULT_RPL_DAO_MAX_TARGETS             16  /* targets carried by a single DAO message, 0 means no limit */
 
 #define DEFAULT_RPL_MAX_RANK_INC                4
+#define DEFAULT_RPL_OCP                         RPL_OF_OF0
+#define DEFAULT_RPL_PARENT_SWITCH_THRESHOLD     0   /* only ties are resolved in favor of the current parent */
 
 #define DEFAULT_RPL_PREFER_FLOATING             FALSE
 
@@ -161,7 +181,23 @@ typedef struct rs_system_t {
     percent_t                   no_link_quality_thresh;
     sim_time_t                  transmission_time;
 
+    uint8                       propagation_model;
+    float                       path_loss_exponent;
+    float                       shadowing_deviation;
+    float                       asymmetry_deviation;
+    bool                        collisions;
+    bool                        link_loss;
+    float                       prr_steepness;
+    char *                      link_trace_file_name;   /* replaces the propagation model when set */
+
     sim_time_t                  mac_pdu_timeout;
+    bool                        mac_csma;
+    sim_time_t                  mac_backoff_slot;
+    uint8                       mac_min_backoff_exponent;
+    uint8                       mac_max_backoff_exponent;
+    uint8                       mac_max_backoffs;
+    uint8                       mac_max_retries;
+    uint16                      mac_queue_size;
 
     sim_time_t                  ip_neighbor_timeout;
     sim_time_t                  ip_pdu_timeout;
@@ -180,7 +216,10 @@ typedef struct rs_system_t {
     uint8                       rpl_dio_redundancy_constant;
     sim_time_t                  rpl_dao_root_delay;
     sim_time_t                  rpl_dao_remove_timeout;
+    uint16                      rpl_dao_max_targets;
     uint8                       rpl_max_inc_rank;
+    uint8                       rpl_ocp;
+    uint16                      rpl_parent_switch_threshold;
 
     bool                        rpl_prefer_floating;
 
@@ -188,6 +227,14 @@ typedef struct rs_system_t {
     node_t **                   node_list;
     uint16                      node_count;
 
+    uint32                      node_version;       /* bumped whenever a node is added, removed, renamed or readdressed */
+
+        /* nodes by the id of their MAC and IP addresses, rebuilt lazily after any change */
+    node_t **                   mac_address_index;
+    node_t **                   ip_address_index;
+    uint32                      address_index_size;
+    bool                        address_index_valid;
+
     /* scheduling */
     sim_time_t                  now;
     uint32                      event_count;
@@ -230,6 +277,7 @@ int32                           rs_system_get_node_pos(node_t *node);
 node_t *                        rs_system_find_node_by_name(char *name);
 node_t *                        rs_system_find_node_by_mac_address(char *address);
 node_t *                        rs_system_find_node_by_ip_address(char *address);
+void                            rs_system_nodes_changed();
 node_t **                       rs_system_get_node_list_copy(uint16 *node_count);
 
 void                            rs_system_schedule_event(node_t *node, uint16 event_id, void *data1, void *data2, sim_time_t time);